@@ -21,6 +21,31 @@
 #endif  // QT_CORE_LIB
 
 #include <type_traits>
+#include <cstdio>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Set of paths to take from document, see from_json(data, projection).
+ * Path is JSON Pointer (RFC 6901), e.g. "/user/id" or "/items/0/price";
+ * segment "*" matches any field or array element. Empty path selects whole
+ * document. Invalid path throws std::invalid_argument.
+ */
+class mgjson_projection
+{
+public:
+    struct node;
+
+    mgjson_projection(std::initializer_list<const char*> paths);
+    explicit mgjson_projection(const std::vector<std::string>& paths);
+
+    inline const node* root() const { return root_.get(); }
+
+private:
+    std::shared_ptr<const node> root_;
+};
 
 class mgjson_private;
 class mgjson
@@ -40,6 +65,11 @@ public:
             ColonExpected           = (-7),
             InvalidName             = (-8),
             DuplicateName           = (-9),
+            FileError               = (-10),
+            DepthLimitExceeded      = (-11),
+            SizeLimitExceeded       = (-12),
+            StringLimitExceeded     = (-13),
+            CompressionError        = (-14),
         };
 
         parse_error error;
@@ -56,6 +86,17 @@ public:
         {
             return (error >= 0);
         }
+
+        /* Fills row and col of offset in data (text what was parsed). For
+         * NoError parsers leave them 0: counting rows would take one more
+         * pass over whole document.
+         */
+        void compute_position(const char* data);
+
+        inline void compute_position(const std::string& data)
+        {
+            compute_position(data.data());
+        }
     };
 
     enum json_type {
@@ -81,6 +122,13 @@ public:
         SplitSimpleArrays   = 0x0080,
         SimpleFieldsFirst   = 0x0100,
 
+        /* Form for signing and comparing documents: no whitespace, fields
+         * in order of key bytes, numbers normalized (integers exactly, other
+         * values as shortest text of the nearest double), raw JSON rewritten.
+         * Other flags are ignored.
+         */
+        Canonical           = 0x0200,
+
         MinSize             = Compact,
         MaxReadable         = (
             Indented |
@@ -95,13 +143,67 @@ public:
     };
     _mgjson_declare_flags(json_format, json_format_flags)
 
+    enum json_parse_flags {
+        ParseDefault        = 0x0000,
+        ValidateUtf8        = 0x0001,
+        PreserveNumbers     = 0x0002,
+        BuildTape           = 0x0004,
+        /* Adjacent string literals make one string value, as to_json() with
+         * SplitStrings writes multiline strings; without the flag they are
+         * an error, as JSON requires.
+         */
+        JoinStrings         = 0x0008,
+    };
+    _mgjson_declare_flags(json_parse, json_parse_flags)
+
+    enum duplicate_policy {
+        DuplicateError,         // DuplicateName error.
+        DuplicateFirstWins,     // Later values are skipped.
+        DuplicateLastWins,      // Later values replace earlier ones.
+        DuplicateKeepAll,       // All values are collected into array.
+    };
+
+    enum json_compression {
+        CompressLz4         = 1,    // LZ4 frame format.
+        CompressZstd        = 2,    // Zstandard frame format.
+    };
+
+    /* Limits for documents from untrusted sources; zero means no limit.
+     * Limits are checked while parsing, without extra passes. Parsers
+     * recurse into nested arrays and objects, so depth is limited by default
+     * (also for functions without options); other limits are off.
+     */
+    struct parse_options
+    {
+        enum {
+            DefaultMaxDepth = 512
+        };
+
+        inline parse_options() :
+            flags(ParseDefault),
+            max_depth(DefaultMaxDepth),
+            max_size(0),
+            max_string_length(0),
+            duplicates(DuplicateError)
+        {
+        }
+
+        json_parse flags;
+        size_t max_depth;           // Nesting of arrays and objects.
+        size_t max_size;            // Size of whole document, in bytes.
+        size_t max_string_length;   // Length of string value or field name, in bytes.
+        duplicate_policy duplicates;
+    };
+
 #ifdef QT_CORE_LIB
 public:
     typedef json_type Type;
     typedef json_format JsonFormat;
+    typedef json_parse ParseFlags;
 #endif
 
 private:
+    friend class mgjson_private;
     mgjson(mgjson_private *data) noexcept;
 
 public:
@@ -310,33 +412,421 @@ public:
 public:
     std::string to_json(json_format format = MaxReadable) const;
 
-    static mgjson from_json(const char *data, size_t cb_data, parse_result *result = nullptr);
-    static mgjson from_json(const char *data, parse_result *result = nullptr);
-    static inline mgjson from_json(const std::string& data, parse_result *result = nullptr)
+    /* Text is appended to out, so one buffer can be reused for many
+     * documents without new allocations.
+     */
+    void to_json(std::string& out, json_format format = MaxReadable) const;
+
+    /* Text is passed to sink in chunks of about chunk_size bytes, so whole
+     * document is never kept in memory; sink returns false to stop writing.
+     * Returns false if sink (or write to file) failed.
+     */
+    typedef std::function<bool(const char* data, size_t cb_data)> json_sink;
+    bool to_json(const json_sink& sink, json_format format = MaxReadable,
+                 size_t chunk_size = 65536) const;
+    bool to_json(FILE* file, json_format format = MaxReadable) const;
+    bool to_json_fd(int fd, json_format format = MaxReadable) const;
+
+    /* Text of to_json(format) as list of pieces, e.g. for writev(). String
+     * values (and raw JSON) of 256 bytes and longer, what need no escaping,
+     * are not copied: their segments point into this value. Other text is
+     * written into storage (its old content is dropped, capacity is
+     * reused). Segments are valid while this value and storage are alive and
+     * not changed.
+     */
+    struct json_segment
     {
-        return from_json(data.data(), data.size(), result);
+        const char* data;
+        size_t size;
+    };
+    void to_json_segments(std::vector<json_segment>& segments, std::string& storage,
+                          json_format format = MaxReadable) const;
+
+    /* Same text as to_json(format), but arrays and objects with many
+     * elements are written by `threads` threads (0 means one per CPU core),
+     * chunk by chunk.
+     */
+    std::string to_json_parallel(json_format format = MaxReadable, unsigned threads = 0) const;
+
+    /* Exact size of to_json(format) result, for reserving buffer in advance.
+     * Counted without writing text (one pass over nodes and string bytes),
+     * except of indented formats with SplitStrings or SplitSimpleArrays:
+     * these are written into sink, what costs as much as to_json().
+     */
+    size_t to_json_size(json_format format = MaxReadable) const;
+
+    /* Hash of structure: values with same to_json(Canonical) text have same
+     * hash. It is cached in nodes and dropped when node is changed, so
+     * hashing again after change costs only hashing of changed nodes and
+     * their parents. Not cryptographic.
+     */
+    unsigned long long hash() const;
+
+    /* Already serialized JSON (e.g. cached part of response) to be put into
+     * other document. Text is checked, but object or array isn't built until
+     * navigated into (by count(), at(), keys() etc.); to_json() writes the
+     * text as is until value is changed. Invalid text gives Undefined.
+     */
+    static mgjson raw_json(const char *data, size_t cb_data, parse_result *result = nullptr);
+    static inline mgjson raw_json(const std::string& data, parse_result *result = nullptr)
+    {
+        return raw_json(data.data(), data.size(), result);
+    }
+
+    /* With ValidateUtf8 flag strings are checked to be well-formed UTF-8 while
+     * parsing; invalid sequence is reported as InvalidCharacter. Building with
+     * MGJSON_STRICT_UTF8 turns this flag on for every parse.
+     *
+     * With PreserveNumbers numbers keep their text exactly as in input (so
+     * 20+ digit integers and long decimals survive round trip through
+     * to_json()); numeric values are converted from the text when asked for.
+     * Integer type means no fraction and no exponent.
+     *
+     * With BuildTape document is written while parsing into one flat buffer
+     * in image form (see to_image()) instead of tree of nodes; objects and
+     * arrays are read from it and become nodes only when changed or iterated
+     * over. Best for documents what are only read. Documents of 4 GiB tape
+     * and more fail with SizeLimitExceeded.
+     */
+    static mgjson from_json(const char *data, size_t cb_data, parse_result *result = nullptr,
+                            json_parse flags = ParseDefault);
+    static mgjson from_json(const char *data, parse_result *result = nullptr,
+                            json_parse flags = ParseDefault);
+    static inline mgjson from_json(const std::string& data, parse_result *result = nullptr,
+                                   json_parse flags = ParseDefault)
+    {
+        return from_json(data.data(), data.size(), result, flags);
+    }
+
+    static mgjson from_json(const char *data, size_t cb_data, const parse_options& options,
+                            parse_result *result = nullptr);
+    static inline mgjson from_json(const std::string& data, const parse_options& options,
+                                   parse_result *result = nullptr)
+    {
+        return from_json(data.data(), data.size(), options, result);
+    }
+
+    /* Builds only values selected by projection (and objects and arrays
+     * containing them); unselected array elements are Undefined, so indexes
+     * are kept. Other values are skimmed over without building nodes and are
+     * only checked for balanced brackets and terminated strings.
+     */
+    static mgjson from_json(const char *data, size_t cb_data, const mgjson_projection& projection,
+                            parse_result *result = nullptr, json_parse flags = ParseDefault);
+    static inline mgjson from_json(const std::string& data, const mgjson_projection& projection,
+                                   parse_result *result = nullptr, json_parse flags = ParseDefault)
+    {
+        return from_json(data.data(), data.size(), projection, result, flags);
+    }
+
+    /* Filters records of top-level array while parsing. Every element is
+     * first parsed with projection (paths are relative to the element, so
+     * only fields predicate needs are built) and passed to predicate; only
+     * accepted elements are parsed in full and included into result. If
+     * document is not an array, it is parsed as by from_json().
+     */
+    typedef std::function<bool (const mgjson& record)> record_predicate;
+
+    static mgjson from_json_filtered(const char *data, size_t cb_data,
+                                     const mgjson_projection& projection,
+                                     const record_predicate& predicate,
+                                     parse_result *result = nullptr,
+                                     json_parse flags = ParseDefault);
+    static inline mgjson from_json_filtered(const std::string& data,
+                                            const mgjson_projection& projection,
+                                            const record_predicate& predicate,
+                                            parse_result *result = nullptr,
+                                            json_parse flags = ParseDefault)
+    {
+        return from_json_filtered(data.data(), data.size(), projection, predicate, result, flags);
+    }
+
+    /* Same as from_json(), but if document is an array, its elements are
+     * parsed in parallel by `threads` workers (0 means number of CPU cores).
+     */
+    static mgjson from_json_parallel(const char *data, size_t cb_data,
+                                     parse_result *result = nullptr, unsigned threads = 0,
+                                     json_parse flags = ParseDefault);
+    static inline mgjson from_json_parallel(const std::string& data,
+                                            parse_result *result = nullptr, unsigned threads = 0,
+                                            json_parse flags = ParseDefault)
+    {
+        return from_json_parallel(data.data(), data.size(), result, threads, flags);
+    }
+
+    /* Parses file directly from its memory mapping, without reading it into
+     * memory first. Unless `threads` is 1, from_json_parallel() is used.
+     * If file can't be opened, result is FileError. Offsets of parse_result
+     * are int, so files over INT_MAX bytes are not parsed: SizeLimitExceeded.
+     */
+    static mgjson from_json_file(const char *path, parse_result *result = nullptr,
+                                 unsigned threads = 1, json_parse flags = ParseDefault);
+    static inline mgjson from_json_file(const std::string& path, parse_result *result = nullptr,
+                                        unsigned threads = 1, json_parse flags = ParseDefault)
+    {
+        return from_json_file(path.c_str(), result, threads, flags);
+    }
+
+    /* Newline-delimited JSON (JSON Lines): every non-empty line is a separate
+     * document. Lines are parsed in parallel by `threads` workers (0 means
+     * number of CPU cores). Results are in order of lines; offset and row
+     * of each parse_result are relative to the whole buffer.
+     */
+    typedef std::function<void (size_t index, const mgjson& value, const parse_result& result)>
+        json_lines_callback;
+
+    static std::vector<mgjson> from_json_lines(const char *data, size_t cb_data,
+                                               std::vector<parse_result> *results = nullptr,
+                                               unsigned threads = 0,
+                                               json_parse flags = ParseDefault);
+    static inline std::vector<mgjson> from_json_lines(const std::string& data,
+                                                      std::vector<parse_result> *results = nullptr,
+                                                      unsigned threads = 0,
+                                                      json_parse flags = ParseDefault)
+    {
+        return from_json_lines(data.data(), data.size(), results, threads, flags);
+    }
+
+    /* Callback is called from the calling thread, in order of lines. Only
+     * limited window of lines is kept in memory at once.
+     */
+    static void from_json_lines(const char *data, size_t cb_data,
+                                const json_lines_callback& callback, unsigned threads = 0,
+                                json_parse flags = ParseDefault);
+    static inline void from_json_lines(const std::string& data,
+                                       const json_lines_callback& callback, unsigned threads = 0,
+                                       json_parse flags = ParseDefault)
+    {
+        from_json_lines(data.data(), data.size(), callback, threads, flags);
+    }
+
+    /* JSON Lines file, see from_json_lines(). Result reports only whether file
+     * was opened (FileError otherwise) and is not over INT_MAX bytes (see
+     * from_json_file()); each line has its own parse_result.
+     */
+    static void from_json_lines_file(const char *path, const json_lines_callback& callback,
+                                     parse_result *result = nullptr, unsigned threads = 0,
+                                     json_parse flags = ParseDefault);
+    static inline void from_json_lines_file(const std::string& path,
+                                            const json_lines_callback& callback,
+                                            parse_result *result = nullptr, unsigned threads = 0,
+                                            json_parse flags = ParseDefault)
+    {
+        from_json_lines_file(path.c_str(), callback, result, threads, flags);
+    }
+
+    /* Checks that data is well-formed UTF-8. On failure offset of the first
+     * invalid byte is stored into error_offset.
+     */
+    static bool validate_utf8(const char *data, size_t cb_data, size_t *error_offset = nullptr);
+    static inline bool validate_utf8(const std::string& data, size_t *error_offset = nullptr)
+    {
+        return validate_utf8(data.data(), data.size(), error_offset);
     }
 
-#ifdef MGJSON_USE_MSGPACK
 public:
+    /* MessagePack. Integers take the smallest form, doubles are float 64;
+     * undefined fields are not written. Strings and binaries are read as
+     * String values, map keys have to be strings; extension types are not
+     * supported. Offset of error is in bytes, row and column are 0.
+     *
+     * msgpack(out) appends to out, so buffer can be reused, or reserved in
+     * advance with exact size given by msgpack_size().
+     */
     std::string msgpack() const;
+    void msgpack(std::string& out) const;
+    size_t msgpack_size() const;
 
     static mgjson msgunpack(const char *data, size_t cb_data, parse_result *result = nullptr);
     static inline mgjson msgunpack(const std::string& data, parse_result *result = nullptr)
     {
         return msgunpack(data.data(), data.size(), result);
     }
-#endif  // MGJSON_USE_MSGPACK
+    static mgjson msgunpack(const char *data, size_t cb_data, const parse_options& options,
+                            parse_result *result = nullptr);
+    static inline mgjson msgunpack(const std::string& data, const parse_options& options,
+                                   parse_result *result = nullptr)
+    {
+        return msgunpack(data.data(), data.size(), options, result);
+    }
+
+public:
+    /* CBOR (RFC 8949). Items are written with definite lengths, integers
+     * and floats in the smallest form what keeps the value; strings what
+     * are not valid UTF-8 are written as byte strings. Reader takes also
+     * indefinite lengths, skips tags and reads byte strings as String
+     * values. For sequence of items, MoreData result has offset of the next
+     * one.
+     */
+    std::string to_cbor() const;
+    void to_cbor(std::string& out) const;
+
+    static mgjson from_cbor(const char *data, size_t cb_data, parse_result *result = nullptr);
+    static inline mgjson from_cbor(const std::string& data, parse_result *result = nullptr)
+    {
+        return from_cbor(data.data(), data.size(), result);
+    }
+    static mgjson from_cbor(const char *data, size_t cb_data, const parse_options& options,
+                            parse_result *result = nullptr);
+    static inline mgjson from_cbor(const std::string& data, const parse_options& options,
+                                   parse_result *result = nullptr)
+    {
+        return from_cbor(data.data(), data.size(), options, result);
+    }
+
+public:
+    /* Image: compact binary form of document what is read in place, without
+     * parsing, e.g. from memory mapped file. Objects and arrays are read
+     * from image until changed or iterated over (writing them, e.g. by
+     * to_json(), doesn't count); field is found by binary search. Image is
+     * limited to 4 GiB (to_image() throws std::length_error).
+     *
+     * from_image() doesn't copy data, so it has to live as long as any value
+     * taken from document. from_image_file() maps file, what is unmapped
+     * when the last such value is destroyed.
+     */
+    std::string to_image() const;
+    void to_image(std::string& out) const;
+
+    static mgjson from_image(const char *data, size_t cb_data, parse_result *result = nullptr);
+    static mgjson from_image_file(const char *path, parse_result *result = nullptr);
+    static inline mgjson from_image_file(const std::string& path, parse_result *result = nullptr)
+    {
+        return from_image_file(path.c_str(), result);
+    }
+
+public:
+    /* BSON (bsonspec.org); value has to be an object (to_bson() throws
+     * std::invalid_argument otherwise). Integers are written as int32 or
+     * int64, strings what are not valid UTF-8 as binaries. Reader checks
+     * declared size of every document before reading it; binaries become
+     * String values, ObjectId is hexadecimal string, date-time and
+     * timestamp are integers. For sequence of documents, MoreData result has
+     * offset of the next one.
+     */
+    std::string to_bson() const;
+    void to_bson(std::string& out) const;
+
+    static mgjson from_bson(const char *data, size_t cb_data, parse_result *result = nullptr);
+    static inline mgjson from_bson(const std::string& data, parse_result *result = nullptr)
+    {
+        return from_bson(data.data(), data.size(), result);
+    }
+    static mgjson from_bson(const char *data, size_t cb_data, const parse_options& options,
+                            parse_result *result = nullptr);
+    static inline mgjson from_bson(const std::string& data, const parse_options& options,
+                                   parse_result *result = nullptr)
+    {
+        return from_bson(data.data(), data.size(), options, result);
+    }
+
+public:
+    /* Compressed JSON text. Text is compressed chunk by chunk while it is
+     * written, straight into out, so it is never kept whole. Reader finds
+     * format by magic number of frame and parses text decompressed into one
+     * buffer (mgjson_parser::parse_compressed() reuses it); max_size of
+     * options limits decompressed text. Errors of compressed data
+     * (CompressionError, EndOfData, SizeLimitExceeded) have offset in
+     * compressed data, errors of text are as of from_json(). For sequence of
+     * frames, MoreData result has offset of the next one.
+     *
+     * Formats are built in when library is built with MGJSON_USE_LZ4 or
+     * MGJSON_USE_ZSTD defined (and linked with liblz4 or libzstd); other
+     * ones give std::invalid_argument from to_compressed() and
+     * CompressionError from from_compressed(). Level 0 is default level of
+     * format.
+     */
+    static bool compression_supported(json_compression compression);
+
+    std::string to_compressed(json_compression compression, json_format format = Compact,
+                              int level = 0) const;
+    void to_compressed(std::string& out, json_compression compression,
+                       json_format format = Compact, int level = 0) const;
+
+    static mgjson from_compressed(const char *data, size_t cb_data, parse_result *result = nullptr,
+                                  json_parse flags = ParseDefault);
+    static inline mgjson from_compressed(const std::string& data, parse_result *result = nullptr,
+                                         json_parse flags = ParseDefault)
+    {
+        return from_compressed(data.data(), data.size(), result, flags);
+    }
+    static mgjson from_compressed(const char *data, size_t cb_data, const parse_options& options,
+                                  parse_result *result = nullptr);
+    static inline mgjson from_compressed(const std::string& data, const parse_options& options,
+                                         parse_result *result = nullptr)
+    {
+        return from_compressed(data.data(), data.size(), options, result);
+    }
 
 private:
     _mgjson_shared_data_ptr<mgjson_private> d;
 };
 
 _mgjson_declare_operators_for_flags(mgjson::json_format)
+_mgjson_declare_operators_for_flags(mgjson::json_parse)
 
 static_assert(sizeof(mgjson) == sizeof(void*),
               "mgjason class MUST have size as a pointer!");
 
+/* Parser what keeps its scratch buffers (array element stacks, string and
+ * field name buffers) between documents, so stream of small documents is
+ * parsed without allocations other than for resulting values. Results are
+ * the same as of mgjson::from_json() with parser options; flags passed to
+ * parse() are added to flags of options. Object is not thread safe; use one
+ * per thread.
+ */
+struct mgjson_parser_buffers;
+class mgjson_parser
+{
+public:
+    mgjson_parser();
+    explicit mgjson_parser(const mgjson::parse_options& options);
+    ~mgjson_parser();
+
+private:
+    mgjson_parser(const mgjson_parser&) = delete;
+    mgjson_parser& operator=(const mgjson_parser&) = delete;
+
+public:
+    mgjson parse(const char *data, size_t cb_data, mgjson::parse_result *result = nullptr,
+                 mgjson::json_parse flags = mgjson::ParseDefault);
+    inline mgjson parse(const std::string& data, mgjson::parse_result *result = nullptr,
+                        mgjson::json_parse flags = mgjson::ParseDefault)
+    {
+        return parse(data.data(), data.size(), result, flags);
+    }
+
+    mgjson parse(const char *data, size_t cb_data, const mgjson_projection& projection,
+                 mgjson::parse_result *result = nullptr,
+                 mgjson::json_parse flags = mgjson::ParseDefault);
+    inline mgjson parse(const std::string& data, const mgjson_projection& projection,
+                        mgjson::parse_result *result = nullptr,
+                        mgjson::json_parse flags = mgjson::ParseDefault)
+    {
+        return parse(data.data(), data.size(), projection, result, flags);
+    }
+
+    /* See mgjson::from_compressed(); buffer of decompressed text is kept
+     * too.
+     */
+    mgjson parse_compressed(const char *data, size_t cb_data, mgjson::parse_result *result = nullptr,
+                            mgjson::json_parse flags = mgjson::ParseDefault);
+    inline mgjson parse_compressed(const std::string& data, mgjson::parse_result *result = nullptr,
+                                   mgjson::json_parse flags = mgjson::ParseDefault)
+    {
+        return parse_compressed(data.data(), data.size(), result, flags);
+    }
+
+    /* Frees memory held by buffers.
+     */
+    void shrink();
+
+private:
+    mgjson::parse_options options_;
+    std::unique_ptr<mgjson_parser_buffers> buffers_;
+    std::string text_;      // Decompressed text, see parse_compressed().
+};
+
 #ifdef QT_CORE_LIB
 struct GJsonParseError : public mgjson::parse_result
 {
@@ -56,6 +56,8 @@ public:
     inline const T* data() const { return d; }
     inline const T* constData() const { return d; }
 
+    inline void swap(_mgjson_shared_data_ptr<T> &other) noexcept { T *t = d; d = other.d; other.d = t; }
+
     inline bool operator==(const _mgjson_shared_data_ptr<T> &other) const { return d == other.d; }
     inline bool operator!=(const _mgjson_shared_data_ptr<T> &other) const { return d != other.d; }
 
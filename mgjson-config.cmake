@@ -1,17 +1,38 @@
-find_package(msgpack QUIET)
-if(msgpack_FOUND)
-    set(MSGPACK_HPP_EXISTS 1)
-else()
-    include(CheckIncludeFileCXX)
-    CHECK_INCLUDE_FILE_CXX(msgpack.hpp MSGPACK_HPP_EXISTS)
-endif()
-if (MSGPACK_HPP_EXISTS)
-    add_definitions(-DMGJSON_USE_MSGPACK)
-endif()
+find_package(Threads REQUIRED)
 
 if(NOT TARGET mgjson)
     add_library(mgjson INTERFACE)
-    set_target_properties(mgjson PROPERTIES INTERFACE_SOURCES ${CMAKE_CURRENT_LIST_DIR}/src/mgjson.cpp)
+    set(_mgjson_sources
+        ${CMAKE_CURRENT_LIST_DIR}/src/mgjson.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/src/mgjson_parser.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/src/mgjson_projection.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/src/mgjson_file.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/src/mgjson_writer.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/src/mgjson_msgpack.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/src/mgjson_cbor.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/src/mgjson_bson.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/src/mgjson_compress.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/src/mgjson_image.cpp
+        )
+    set_target_properties(mgjson PROPERTIES INTERFACE_SOURCES "${_mgjson_sources}")
     set_target_properties(mgjson PROPERTIES INTERFACE_INCLUDE_DIRECTORIES ${CMAKE_CURRENT_LIST_DIR}/include)
+    set_target_properties(mgjson PROPERTIES INTERFACE_LINK_LIBRARIES Threads::Threads)
+
+    # Compressed documents (mgjson::to_compressed()): LZ4 and zstd are built
+    # in when found.
+    find_path(MGJSON_LZ4_INCLUDE_DIR lz4frame.h)
+    find_library(MGJSON_LZ4_LIBRARY lz4)
+    if(MGJSON_LZ4_INCLUDE_DIR AND MGJSON_LZ4_LIBRARY)
+        set_property(TARGET mgjson APPEND PROPERTY INTERFACE_COMPILE_DEFINITIONS MGJSON_USE_LZ4)
+        set_property(TARGET mgjson APPEND PROPERTY INTERFACE_INCLUDE_DIRECTORIES ${MGJSON_LZ4_INCLUDE_DIR})
+        set_property(TARGET mgjson APPEND PROPERTY INTERFACE_LINK_LIBRARIES ${MGJSON_LZ4_LIBRARY})
+    endif()
+    find_path(MGJSON_ZSTD_INCLUDE_DIR zstd.h)
+    find_library(MGJSON_ZSTD_LIBRARY zstd)
+    if(MGJSON_ZSTD_INCLUDE_DIR AND MGJSON_ZSTD_LIBRARY)
+        set_property(TARGET mgjson APPEND PROPERTY INTERFACE_COMPILE_DEFINITIONS MGJSON_USE_ZSTD)
+        set_property(TARGET mgjson APPEND PROPERTY INTERFACE_INCLUDE_DIRECTORIES ${MGJSON_ZSTD_INCLUDE_DIR})
+        set_property(TARGET mgjson APPEND PROPERTY INTERFACE_LINK_LIBRARIES ${MGJSON_ZSTD_LIBRARY})
+    endif()
 endif()
 
@@ -2,8 +2,32 @@ INCLUDEPATH *= $$PWD/include
 CONFIG *= c++11
 
 SOURCES *= \
-  $$PWD/src/mgjson.cpp
+  $$PWD/src/mgjson.cpp \
+  $$PWD/src/mgjson_parser.cpp \
+  $$PWD/src/mgjson_projection.cpp \
+  $$PWD/src/mgjson_file.cpp \
+  $$PWD/src/mgjson_writer.cpp \
+  $$PWD/src/mgjson_msgpack.cpp \
+  $$PWD/src/mgjson_cbor.cpp \
+  $$PWD/src/mgjson_bson.cpp \
+  $$PWD/src/mgjson_compress.cpp \
+  $$PWD/src/mgjson_image.cpp
 
 HEADERS *= \
   $$PWD/include/mgjson.h \
-  $$PWD/include/GJson.h
+  $$PWD/include/GJson.h \
+  $$PWD/src/mgjson_private.h \
+  $$PWD/src/mgjson_number.h \
+  $$PWD/src/mgjson_dtoa.h \
+  $$PWD/src/mgjson_binary.h \
+  $$PWD/src/mgjson_image.h \
+  $$PWD/src/mgjson_simd.h \
+  $$PWD/src/mgjson_parallel.h \
+  $$PWD/src/mgjson_utf8.h \
+  $$PWD/src/mgjson_projection.h \
+  $$PWD/src/mgjson_file.h
+
+# Compressed documents (mgjson::to_compressed()): add MGJSON_USE_LZ4 or
+# MGJSON_USE_ZSTD to DEFINES to build LZ4 or zstd in.
+contains(DEFINES, MGJSON_USE_LZ4): LIBS *= -llz4
+contains(DEFINES, MGJSON_USE_ZSTD): LIBS *= -lzstd
@@ -3,6 +3,8 @@
 #endif
 
 #include "mgjson.h"
+#include "mgjson_private.h"
+#include "mgjson_image.h"
 
 #include <string>
 #include <cstring>
@@ -52,230 +54,30 @@ mgjson::parse_result::error_string(parse_error err)
     case ColonExpected:         return "Colon expected.";
     case InvalidName:           return "Invalid name of object field.";
     case DuplicateName:         return "Duplicate name of object field.";
+    case FileError:             return "Unable to open or read file.";
+    case DepthLimitExceeded:    return "Nesting depth limit exceeded.";
+    case SizeLimitExceeded:     return "Document size limit exceeded.";
+    case StringLimitExceeded:   return "String length limit exceeded.";
+    case CompressionError:      return "Invalid or unsupported compressed data.";
     default:                    return "<unknown error>";
     }
 }
 
-class mgjson_private : public _mgjson_shared_data
+bool
+mgjson::validate_utf8(const char *data, size_t cb_data, size_t *error_offset)
 {
-public:
-    ~mgjson_private()
-    {
-    }
-
-    mgjson_private(const mgjson_private& other) :
-        _mgjson_shared_data(other),
-        type_(other.type_),
-        b_value_(other.b_value_),
-        i_value_(other.i_value_),
-        d_value_(other.d_value_),
-        str_value_(other.str_value_),
-        array_(other.array_),
-        map_(other.map_)
-    {
-    }
-
-    mgjson_private(mgjson::json_type type) :
-        type_(type),
-        b_value_(false),
-        i_value_(0),
-        d_value_(0.0),
-        str_value_(mgjson::Null == type ? "null" : "")
-    {
-    }
-
-    mgjson_private(bool value) :
-        type_(mgjson::Bool),
-        b_value_(value),
-        i_value_(value ? 1 : 0),
-        d_value_(value ? 1.0 : 0.0),
-        str_value_(value ? "true" : "false")
-    {
-    }
-
-    mgjson_private(unsigned long long value) :
-        type_(mgjson::Integer),
-        b_value_(!!value),
-        i_value_(value),
-        d_value_(static_cast<long double>(value)),
-#ifdef QT_CORE_LIB
-        str_value_(QByteArray::number(value))
-#else
-        str_value_(std::to_string(value))
-#endif
-    {
-    }
-
-    mgjson_private(long double value) :
-        type_(mgjson::Double),
-        b_value_(0.0L != value),
-        i_value_(static_cast<unsigned long long>(value)),
-        d_value_(value)
-    {
-        str_value_.resize(std::numeric_limits<long double>::digits10 + 10);
-#ifdef QT_CORE_LIB
-        char* buf = str_value_.data();
-#else
-        char* buf = &str_value_.front();
-#endif
-
-#ifdef _MSC_VER
-        int len = sprintf_s(buf, str_value_.size(), "%.*Lg",
-                  std::numeric_limits<long double>::digits10 + 2, value);
-#else
-        int len = sprintf(buf, "%.*Lg",
-                std::numeric_limits<long double>::digits10 + 2, value);
-#endif
-        str_value_.resize(len);
-    }
-
-    mgjson_private(const char* value) :
-        type_(mgjson::String),
-        b_value_(false),
-        i_value_(0),
-        d_value_(0.0),
-        str_value_(value)
-    {
-        _update_values_from_string();
-    }
-
-#ifdef QT_CORE_LIB
-    mgjson_private(const QByteArray& value) :
-#else
-    mgjson_private(const std::string& value) :
-#endif
-        type_(mgjson::String),
-        b_value_(false),
-        i_value_(0),
-        d_value_(0.0),
-        str_value_(value)
-    {
-        _update_values_from_string();
-    }
-
-    inline void check_key_is_empty(const char *key) const
-    {
-        if ((nullptr == key) || (0 == strlen(key))) {
-            throw std::out_of_range("mgjson::at(key) key can't be empty!");
-        }
+    if (nullptr == data) {
+        return true;
     }
-
-    inline bool switch_to_array()
-    {
-        switch(type_) {
-        case mgjson::Undefined:
-        case mgjson::Null:
-            type_ = mgjson::Array;
-        case mgjson::Array:
-            return true;
-        default:
-            return false;
-        }
+    const char* bad = mgjson_utf8::validate(data, data + cb_data);
+    if (data + cb_data == bad) {
+        return true;
     }
-
-private:
-    void _update_values_from_string()
-    {
-#ifdef MGJSON_AUTOCAST_STRING_VALUES
-#   ifdef QT_CORE_LIB
-        const char* str = str_value_.constData();
-#   else
-        const char* str = str_value_.c_str();
-#   endif
-        if (strlen(str) != static_cast<size_t>(str_value_.size())) {
-            return;     // Never cast strings with zeros
-        }
-        if ((0 == qstricmp("0", str)) || (0 == qstricmp("off", str))
-            || (0 == qstricmp("false", str))) {
-            return;
-        }
-        if ((0 == qstricmp("on", str)) || (0 == qstricmp("true", str))) {
-            b_value_ = true;
-            i_value_ = 1;
-            d_value_ = 1.0;
-            return;
-        }
-        char* endptr;
-        bool i_value_set = false;
-        unsigned long long i_val = strtoull(str, &endptr, 0);
-        if ((str + str_value_.size()) == endptr) {
-            i_value_ = i_val;
-            i_value_set = true;
-        }
-        long double d_val = strtold(str, &endptr);
-        if ((str + str_value_.size()) == endptr) {
-            d_value_ = d_val;
-            if (!i_value_set) {
-                if (0.0 > d_val) {
-                    if (static_cast<long double>(std::numeric_limits<long long>::min() > d_val)) {
-                        i_value_ = static_cast<unsigned long long>(std::numeric_limits<long long>::min());
-                    }
-                    else {
-                        i_value_ = static_cast<unsigned long long>(static_cast<long long>(d_val));
-                    }
-                }
-                else {
-                    if (static_cast<long double>(std::numeric_limits<unsigned long long>::max() < d_val)) {
-                        i_value_ = static_cast<unsigned long long>(std::numeric_limits<unsigned long long>::max());
-                    }
-                    else {
-                        i_value_ = static_cast<unsigned long long>(d_val);
-                    }
-                }
-            }
-        } else if (i_value_set) {
-            d_value_ = static_cast<long double>(i_value_);
-        }
-        b_value_ = (0 != i_value_);
-#endif
+    if (nullptr != error_offset) {
+        *error_offset = static_cast<size_t>(bad - data);
     }
-
-public:
-    struct Key {
-        explicit Key(const char* key) :
-            d(qstrdup(key))
-        {
-            assert(nullptr != key);
-        }
-
-        explicit Key(const Key& other) :
-            d(qstrdup(other.d))
-        {
-            assert(nullptr != other.d);
-        }
-
-        explicit Key(Key&& other) :
-            d(other.d)
-        {
-            assert(nullptr != other.d);
-            other.d = nullptr;
-        }
-
-        ~Key()
-        {
-            delete[] d;
-        }
-
-        bool operator <(const Key& other) const
-        {
-            return (strcmp(d, other.d) < 0);
-        }
-        char *d;
-    };
-
-public:
-    mgjson::json_type type_;
-    bool b_value_;
-    unsigned long long i_value_;
-    long double d_value_;
-#ifdef QT_CORE_LIB
-    QByteArray str_value_;
-#else
-    std::string str_value_;
-#endif
-    std::vector<mgjson> array_;
-    std::map<Key,mgjson> map_;
-};
+    return false;
+}
 
 mgjson::~mgjson() noexcept
 {
@@ -299,6 +101,7 @@ mgjson::mgjson(mgjson &&other) noexcept :
 mgjson &mgjson::operator=(const mgjson& other) noexcept
 {
   if( this != &other ) {
+    mgjson_private::replacing(*this);
     d.operator=(other.d);
   }
   return *this;
@@ -315,7 +118,7 @@ mgjson::mgjson(bool value) noexcept :
 }
 
 mgjson::mgjson(int value) noexcept :
-    d(new mgjson_private(static_cast<unsigned long long>(value)))
+    d(new mgjson_private(static_cast<long long>(value)))
 {
 }
 
@@ -325,7 +128,7 @@ mgjson::mgjson(unsigned int value) noexcept :
 }
 
 mgjson::mgjson(long value) noexcept :
-    d(new mgjson_private(static_cast<unsigned long long>(value)))
+    d(new mgjson_private(static_cast<long long>(value)))
 {
 }
 
@@ -335,7 +138,7 @@ mgjson::mgjson(unsigned long value) noexcept :
 }
 
 mgjson::mgjson(long long value) noexcept :
-    d(new mgjson_private(static_cast<unsigned long long>(value)))
+    d(new mgjson_private(static_cast<long long>(value)))
 {
 }
 
@@ -394,19 +197,19 @@ mgjson::type() const
 bool
 mgjson::to_bool() const
 {
-    return d->b_value_;
+    return d->to_bool();
 }
 
 unsigned long long
 mgjson::to_ulonglong() const
 {
-    return d->i_value_;
+    return d->to_integer();
 }
 
 long double
 mgjson::to_longdouble() const
 {
-    return d->d_value_;
+    return d->to_double();
 }
 
 const char*
@@ -461,6 +264,10 @@ size_t
 #endif
 mgjson::count() const
 {
+    if (d->in_image()) {
+        return static_cast<decltype(count())>(mgjson_image::count(*d));
+    }
+    d->expand();
     switch(d->type_) {
     case Array:
         return static_cast<decltype(count())>(d->array_.size());
@@ -474,10 +281,10 @@ mgjson::count() const
 void
 mgjson::resize(size_t new_size)
 {
-    if ((Array == d->type_) && (d->array_.size() == new_size)) {
+    mgjson_private *data = mgjson_private::writable(*this);
+    if ((Array == data->type_) && (data->array_.size() == new_size)) {
         return;
     }
-    mgjson_private *data = d.data();
     data->type_ = Array;
     data->map_.clear();
     data->array_.resize(new_size);
@@ -487,6 +294,10 @@ mgjson
 mgjson::at(size_t index) const
 {
     const mgjson_private* data = d.data();
+    if (data->in_image()) {
+        return mgjson_image::at(*data, index);
+    }
+    data->expand();
     if ((Array != data->type_) || (data->array_.size() <= index)) {
         return mgjson();
     }
@@ -496,7 +307,7 @@ mgjson::at(size_t index) const
 mgjson&
 mgjson::at(size_t index)
 {
-    mgjson_private* data = d.data();
+    mgjson_private* data = mgjson_private::writable_parent(*this);
     if (!data->switch_to_array()) {
         throw std::invalid_argument("mgjson::at(index) can't be used for json what is not an array.");
     }
@@ -512,12 +323,16 @@ mgjson
 mgjson::at(const char* key) const
 {
     const mgjson_private* data = d.data();
-
     data->check_key_is_empty(key);
 
     if (Object != data->type_) {
         return mgjson();
     }
+    if (data->in_image()) {
+        const size_t index = mgjson_image::find(*data, key);
+        return (mgjson_image::count(*data) == index) ? mgjson() : mgjson_image::value(*data, index);
+    }
+    data->expand();
 
     auto it = data->map_.find(*reinterpret_cast<const mgjson_private::Key*>(&key));
     if (data->map_.end() == it) {
@@ -530,12 +345,15 @@ bool
 mgjson::has_key(const char* key) const
 {
     const mgjson_private* data = d.data();
-
     data->check_key_is_empty(key);
 
     if (Object != data->type_) {
         return false;
     }
+    if (data->in_image()) {
+        return (mgjson_image::count(*data) != mgjson_image::find(*data, key));
+    }
+    data->expand();
 
     return (data->map_.find(*reinterpret_cast<const mgjson_private::Key*>(&key)) != data->map_.end());
 }
@@ -543,7 +361,7 @@ mgjson::has_key(const char* key) const
 mgjson&
 mgjson::at(const char* key)
 {
-    mgjson_private* data = d.data();
+    mgjson_private* data = mgjson_private::writable_parent(*this);
 
     data->check_key_is_empty(key);
 
@@ -566,6 +384,15 @@ mgjson::keys() const
 {
     const mgjson_private* data = d.data();
     QByteArrayList res;
+    if ((Object == data->type_) && data->in_image()) {
+        const size_t count = mgjson_image::count(*data);
+        res.reserve(static_cast<int>(count));
+        for (size_t i = 0; i < count; ++i) {
+            res.push_back(mgjson_image::key(*data, i));
+        }
+        return res;
+    }
+    data->expand();
     if (Object == data->type_) {
         res.reserve(static_cast<int>(data->map_.size()));
         for (const auto it : data->map_) {
@@ -580,6 +407,15 @@ mgjson::keys() const
 {
     const mgjson_private* data = d.data();
     std::vector<std::string> res;
+    if ((Object == data->type_) && data->in_image()) {
+        const size_t count = mgjson_image::count(*data);
+        res.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            res.push_back(mgjson_image::key(*data, i));
+        }
+        return res;
+    }
+    data->expand();
     if (Object == data->type_) {
         res.reserve(data->map_.size());
         for (const auto it : data->map_) {
@@ -593,7 +429,7 @@ mgjson::keys() const
 mgjson&
 mgjson::push_back(const mgjson& value)
 {
-    mgjson_private* data = d.data();
+    mgjson_private* data = mgjson_private::writable_parent(*this);
     if (!data->switch_to_array()) {
         throw std::invalid_argument("mgjson::push_back can't be used for json what is not an array.");
     }
@@ -605,7 +441,7 @@ mgjson::push_back(const mgjson& value)
 mgjson&
 mgjson::push_front(const mgjson& value)
 {
-    mgjson_private* data = d.data();
+    mgjson_private* data = mgjson_private::writable_parent(*this);
     if (!data->switch_to_array()) {
         throw std::invalid_argument("mgjson::push_front can't be used for json what is not an array.");
     }
@@ -616,7 +452,7 @@ mgjson::push_front(const mgjson& value)
 void
 mgjson::remove(size_t index)
 {
-    mgjson_private* data = d.data();
+    mgjson_private* data = mgjson_private::writable(*this);
     if ((Array != data->type_) || (data->array_.size() <= index)) {
         return;
     }
@@ -629,7 +465,7 @@ mgjson::remove(size_t index)
 void
 mgjson::remove(const char* key)
 {
-    mgjson_private* data = d.data();
+    mgjson_private* data = mgjson_private::writable(*this);
     if (Object != data->type_) {
         return;
     }
@@ -640,7 +476,7 @@ mgjson
 mgjson::take(size_t index)
 {
     mgjson result;
-    mgjson_private* data = d.data();
+    mgjson_private* data = mgjson_private::writable(*this);
     if ((Array == data->type_) && (data->array_.size() > index)) {
         /// \todo Maybe, it makes sens to change erase to memmove
         /// to prevent construction/destruction calls
@@ -654,7 +490,7 @@ mgjson
 mgjson::take(const char* key)
 {
     mgjson result;
-    mgjson_private* data = d.data();
+    mgjson_private* data = mgjson_private::writable(*this);
     if (Object == data->type_) {
         auto it = data->map_.find(*reinterpret_cast<const mgjson_private::Key*>(&key));
         if (data->map_.end() != it) {
@@ -664,3 +500,148 @@ mgjson::take(const char* key)
     }
     return result;
 }
+
+namespace
+{
+
+const unsigned long long hash_null = 1;
+const unsigned long long hash_false = 2;
+const unsigned long long hash_true = 3;
+const unsigned long long hash_number = 4;
+const unsigned long long hash_string = 5;
+const unsigned long long hash_array = 6;
+const unsigned long long hash_object = 7;
+const unsigned long long hash_key = 8;
+
+inline unsigned long long hash_add(unsigned long long h, unsigned long long value)
+{
+    h = h * 0x9E3779B97F4A7C15ULL + value;
+    // Finalizer of MurmurHash3.
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* Bytes are taken by 8 as little-endian words, so hash is the same on all
+ * platforms.
+ */
+unsigned long long hash_bytes(unsigned long long h, const char* p, size_t size)
+{
+    const size_t total = size;
+    for (; 0 != size; ) {
+        const size_t n = (8 < size) ? 8 : size;
+        unsigned long long word = 0;
+        memcpy(&word, p, n);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        word = __builtin_bswap64(word);
+#endif
+        h = hash_add(h, word);
+        p += n;
+        size -= n;
+    }
+    return hash_add(h, total);
+}
+
+}   // namespace
+
+std::atomic<unsigned long long> mgjson_private::write_generation_(0);
+
+/* Built from hashes of children, what are cached, so only changed nodes
+ * (and their parents) are hashed again. Image nodes are hashed from image,
+ * without expanding.
+ */
+unsigned long long
+mgjson_private::_hash() const
+{
+    if (in_image()) {
+        return _hash_image();
+    }
+    expand();
+    unsigned long long h = hash_null;
+    switch (type_) {
+    case mgjson::Bool:
+        h = b_value_ ? hash_true : hash_false;
+        break;
+    case mgjson::Integer:
+    case mgjson::Double:
+    {
+        char buf[number_chars_size];
+        size_t len = canonical_number(buf);
+        if (0 != len) {
+            h = hash_bytes(hash_number, buf, len);
+        }
+        break;
+    }
+    case mgjson::String:
+#ifdef QT_CORE_LIB
+        h = hash_bytes(hash_string, str_value_.constData(), static_cast<size_t>(str_value_.size()));
+#else
+        h = hash_bytes(hash_string, str_value_.data(), str_value_.size());
+#endif
+        break;
+    case mgjson::Array:
+        h = hash_array;
+        for (const mgjson& item : array_) {
+            h = hash_add(h, get(item)->hash());
+        }
+        h = hash_add(h, array_.size());
+        break;
+    case mgjson::Object:
+    {
+        // Undefined fields are not written, so are not hashed.
+        size_t count = 0;
+        h = hash_object;
+        for (const auto& item : map_) {
+            const mgjson_private* value = get(item.second);
+            if (mgjson::Undefined != value->type_) {
+                h = hash_add(h, hash_bytes(hash_key, item.first.d, strlen(item.first.d)));
+                h = hash_add(h, value->hash());
+                ++count;
+            }
+        }
+        h = hash_add(h, count);
+        break;
+    }
+    default:
+        break;
+    }
+    return (0 != h) ? h : 1;
+}
+
+unsigned long long
+mgjson_private::_hash_image() const
+{
+    const size_t count = mgjson_image::count(*this);
+    unsigned long long h;
+    if (mgjson::Array == type_) {
+        h = hash_array;
+        for (size_t i = 0; i < count; ++i) {
+            h = hash_add(h, get(mgjson_image::at(*this, i))->hash());
+        }
+        h = hash_add(h, count);
+    }
+    else {
+        size_t fields = 0;
+        h = hash_object;
+        for (size_t i = 0; i < count; ++i) {
+            const mgjson value = mgjson_image::value(*this, i);
+            if (mgjson::Undefined != get(value)->type_) {
+                const char* key = mgjson_image::key(*this, i);
+                h = hash_add(h, hash_bytes(hash_key, key, strlen(key)));
+                h = hash_add(h, get(value)->hash());
+                ++fields;
+            }
+        }
+        h = hash_add(h, fields);
+    }
+    return (0 != h) ? h : 1;
+}
+
+unsigned long long
+mgjson::hash() const
+{
+    return d->hash();
+}
@@ -0,0 +1,385 @@
+#pragma once
+#ifndef _MGJSON_BINARY_H_INCLUDED_
+#define _MGJSON_BINARY_H_INCLUDED_
+
+#include "mgjson_private.h"
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/* Common parts of binary formats (MessagePack and others): big-endian
+ * (and, for BSON, little-endian) numbers and base of decoders, what build
+ * nodes straight from input.
+ */
+namespace mgjson_binary
+{
+
+inline uint16_t load16(const char* p)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint16_t>((u[0] << 8) | u[1]);
+}
+
+inline uint32_t load32(const char* p)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return (static_cast<uint32_t>(u[0]) << 24) | (static_cast<uint32_t>(u[1]) << 16)
+            | (static_cast<uint32_t>(u[2]) << 8) | static_cast<uint32_t>(u[3]);
+}
+
+inline uint64_t load64(const char* p)
+{
+    return (static_cast<uint64_t>(load32(p)) << 32) | load32(p + 4);
+}
+
+inline char* store16(char* p, uint16_t value)
+{
+    p[0] = static_cast<char>(value >> 8);
+    p[1] = static_cast<char>(value);
+    return p + 2;
+}
+
+inline char* store32(char* p, uint32_t value)
+{
+    p[0] = static_cast<char>(value >> 24);
+    p[1] = static_cast<char>(value >> 16);
+    p[2] = static_cast<char>(value >> 8);
+    p[3] = static_cast<char>(value);
+    return p + 4;
+}
+
+inline char* store64(char* p, uint64_t value)
+{
+    store32(p, static_cast<uint32_t>(value >> 32));
+    return store32(p + 4, static_cast<uint32_t>(value));
+}
+
+inline uint32_t load32_le(const char* p)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return (static_cast<uint32_t>(u[3]) << 24) | (static_cast<uint32_t>(u[2]) << 16)
+            | (static_cast<uint32_t>(u[1]) << 8) | static_cast<uint32_t>(u[0]);
+}
+
+inline uint64_t load64_le(const char* p)
+{
+    return (static_cast<uint64_t>(load32_le(p + 4)) << 32) | load32_le(p);
+}
+
+inline char* store32_le(char* p, uint32_t value)
+{
+    p[0] = static_cast<char>(value);
+    p[1] = static_cast<char>(value >> 8);
+    p[2] = static_cast<char>(value >> 16);
+    p[3] = static_cast<char>(value >> 24);
+    return p + 4;
+}
+
+inline char* store64_le(char* p, uint64_t value)
+{
+    store32_le(p, static_cast<uint32_t>(value));
+    return store32_le(p + 4, static_cast<uint32_t>(value >> 32));
+}
+
+/* Code byte and big-endian value of size (1, 2, 4 or 8) bytes.
+ */
+inline void put(std::string& out, char code, uint64_t value, size_t size)
+{
+    char buf[9];
+    buf[0] = code;
+    switch (size) {
+    case 1:
+        buf[1] = static_cast<char>(value);
+        break;
+    case 2:
+        store16(buf + 1, static_cast<uint16_t>(value));
+        break;
+    case 4:
+        store32(buf + 1, static_cast<uint32_t>(value));
+        break;
+    default:
+        store64(buf + 1, value);
+        break;
+    }
+    out.append(buf, size + 1);
+}
+
+inline double double_from_bits(uint64_t bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline uint64_t double_bits(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline float float_from_bits(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline uint32_t float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/* Number node as binary formats store it: integer (magnitude and sign) or
+ * double.
+ */
+struct number
+{
+    explicit number(const mgjson_private& node)
+    {
+        long double d_val;
+        is_integer = node.number_value(magnitude, d_val);
+        negative = (0.0L > d_val);
+        if (is_integer && negative) {
+            magnitude = 0ULL - magnitude;
+        }
+        value = static_cast<double>(d_val);
+    }
+
+    /* Number scanned by JSON parser; integers of the same range as
+     * mgjson_private keeps.
+     */
+    explicit number(const mgjson_number::decimal& dec)
+    {
+        is_integer = mgjson_number::to_integer(dec, magnitude)
+                && (!dec.negative || (magnitude >= (1ULL << 63)) || (0 == magnitude));
+        if (is_integer) {
+            negative = dec.negative && (0 != magnitude);
+            if (negative) {
+                magnitude = 0ULL - magnitude;
+            }
+            value = negative ? -static_cast<double>(magnitude) : static_cast<double>(magnitude);
+        }
+        else {
+            value = static_cast<double>(mgjson_number::to_long_double(dec));
+            negative = (0.0 > value);
+            magnitude = 0;
+        }
+    }
+
+    bool is_integer;
+    bool negative;
+    unsigned long long magnitude;
+    double value;
+};
+
+/* Decoder keeps position and error the same way as JSON parser does and
+ * applies parse_options; derived decoder implements parse_value(). Offset
+ * of error is reported in bytes, row and column are always 0.
+ */
+class decoder
+{
+public:
+    decoder(const char* data, size_t cb_data, const mgjson::parse_options& options) :
+        begin_(data),
+        end_(data + cb_data),
+        p_(data),
+        error_(mgjson::parse_result::NoError),
+        error_pos_(data),
+        options_(options),
+        depth_(0)
+    {
+    }
+
+protected:
+    typedef mgjson::parse_result parse_result;
+
+    template <typename F>
+    mgjson parse_document(parse_result* result, F parse_root)
+    {
+        mgjson value(mgjson_private::make(nullptr));
+        if ((0 != options_.max_size) && (static_cast<size_t>(end_ - begin_) > options_.max_size)) {
+            fail(parse_result::SizeLimitExceeded, begin_ + options_.max_size);
+        }
+        else if (end_ == p_) {
+            fail(parse_result::EndOfData);
+        }
+        else if (parse_root(value)) {
+            if (end_ != p_) {
+                fail(parse_result::MoreData);
+            }
+            else {
+                error_pos_ = p_;
+            }
+        }
+
+        if (nullptr != result) {
+            result->error = error_;
+            result->offset = static_cast<int>(error_pos_ - begin_);
+            result->row = 0;
+            result->col = 0;
+        }
+        if ((0 > error_) || (nullptr == mgjson_private::get(static_cast<const mgjson&>(value)))) {
+            return mgjson(mgjson::Undefined);
+        }
+        return value;
+    }
+
+    inline bool fail(parse_result::parse_error error)
+    {
+        return fail(error, p_);
+    }
+
+    inline bool fail(parse_result::parse_error error, const char* pos)
+    {
+        error_ = error;
+        error_pos_ = pos;
+        return false;
+    }
+
+    /* Checks that size bytes remain.
+     */
+    inline bool need(uint64_t size)
+    {
+        if (static_cast<uint64_t>(end_ - p_) < size) {
+            return fail(parse_result::EndOfData);
+        }
+        return true;
+    }
+
+    inline bool enter()
+    {
+        if ((0 != options_.max_depth) && (depth_ >= options_.max_depth)) {
+            return fail(parse_result::DepthLimitExceeded);
+        }
+        ++depth_;
+        return true;
+    }
+
+    inline void leave()
+    {
+        --depth_;
+    }
+
+    /* Checks length of string at p_ (after its header at pos).
+     */
+    inline bool check_string(uint64_t size, const char* pos)
+    {
+        return need(size) && check_length(size, pos);
+    }
+
+    inline bool check_length(uint64_t size, const char* pos)
+    {
+        if ((0 != options_.max_string_length) && (size > options_.max_string_length)) {
+            return fail(parse_result::StringLimitExceeded, pos);
+        }
+        return true;
+    }
+
+    /* String of size bytes at p_ becomes value.
+     */
+    inline void take_string(mgjson& value, size_t size)
+    {
+        value = mgjson_private::make(new mgjson_private(
+                    mgjson_private::string_type(p_, static_cast<int>(size))));
+        p_ += size;
+    }
+
+    static inline mgjson make_integer(bool negative, uint64_t magnitude)
+    {
+        if (negative) {
+            return mgjson_private::make(new mgjson_private(static_cast<long long>(0ULL - magnitude)));
+        }
+        return mgjson_private::make(new mgjson_private(static_cast<unsigned long long>(magnitude)));
+    }
+
+    static inline mgjson make_double(double value)
+    {
+        return mgjson_private::make(new mgjson_private(static_cast<long double>(value)));
+    }
+
+    /* Field name of size bytes at p_ is taken into key_ (to make Key of).
+     */
+    bool take_key(size_t size, const char* pos)
+    {
+        if (!check_string(size, pos)) {
+            return false;
+        }
+        key_.assign(p_, size);
+        p_ += size;
+        return check_key(pos);
+    }
+
+    /* Names have to be non-empty and without zero bytes, as in JSON parser.
+     */
+    inline bool check_key(const char* pos)
+    {
+        if (key_.empty() || (key_.size() != strlen(key_.c_str()))) {
+            return fail(parse_result::InvalidName, pos);
+        }
+        return true;
+    }
+
+    /* Adds field (name was at pos) to object, applying duplicate policy;
+     * arrays made by DuplicateKeepAll are remembered in collected, as in
+     * JSON parser.
+     */
+    bool add_field(mgjson_private* object, mgjson_private::Key&& key, mgjson& value,
+                   const char* pos, std::vector<const mgjson_private*>& collected)
+    {
+        typedef std::map<mgjson_private::Key, mgjson> map_type;
+        map_type& map = object->map_;
+        if (map.empty() || (0 < strcmp(key.d, map.rbegin()->first.d))) {
+            map.emplace_hint(map.end(), std::piecewise_construct,
+                             std::forward_as_tuple(std::move(key)), std::forward_as_tuple(value));
+            return true;
+        }
+        auto res = map.emplace(std::piecewise_construct,
+                               std::forward_as_tuple(std::move(key)), std::forward_as_tuple(value));
+        if (res.second) {
+            return true;
+        }
+
+        mgjson& existing = res.first->second;
+        switch (options_.duplicates) {
+        case mgjson::DuplicateFirstWins:
+            return true;
+        case mgjson::DuplicateLastWins:
+            existing = value;
+            return true;
+        case mgjson::DuplicateKeepAll:
+            break;
+        default:
+            return fail(parse_result::DuplicateName, pos);
+        }
+        const mgjson_private* array = mgjson_private::get(static_cast<const mgjson&>(existing));
+        if (collected.end() == std::find(collected.begin(), collected.end(), array)) {
+            mgjson_private* values = new mgjson_private(mgjson::Array);
+            values->array_.push_back(existing);
+            existing = mgjson_private::make(values);
+            collected.push_back(values);
+        }
+        mgjson_private::get(existing)->array_.push_back(value);
+        return true;
+    }
+
+protected:
+    const char* const begin_;
+    const char* const end_;
+    const char* p_;
+    parse_result::parse_error error_;
+    const char* error_pos_;
+    const mgjson::parse_options options_;
+    size_t depth_;
+    std::string key_;
+};
+
+}   // namespace mgjson_binary
+
+#endif // _MGJSON_BINARY_H_INCLUDED_
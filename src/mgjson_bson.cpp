@@ -0,0 +1,416 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+#include "mgjson_private.h"
+#include "mgjson_image.h"
+#include "mgjson_binary.h"
+#include "mgjson_dtoa.h"
+#include "mgjson_utf8.h"
+
+#include <string>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+
+typedef mgjson::parse_result parse_result;
+
+enum bson_type {
+    BsonDouble      = 0x01,
+    BsonString      = 0x02,
+    BsonDocument    = 0x03,
+    BsonArray       = 0x04,
+    BsonBinary      = 0x05,
+    BsonUndefined   = 0x06,
+    BsonObjectId    = 0x07,
+    BsonBool        = 0x08,
+    BsonDateTime    = 0x09,
+    BsonNull        = 0x0A,
+    BsonJavaScript  = 0x0D,
+    BsonSymbol      = 0x0E,
+    BsonInt32       = 0x10,
+    BsonTimestamp   = 0x11,
+    BsonInt64       = 0x12
+};
+
+/* Root has to be an object. Arrays are documents with names "0", "1" and
+ * so on. Integers are int32 when they fit, int64 otherwise; unsigned values
+ * above int64 range are written as doubles. Strings what are not valid
+ * UTF-8 are written as binaries. Undefined fields are not written, other
+ * undefined values are nulls.
+ */
+class bson_writer
+{
+public:
+    explicit bson_writer(std::string& out) :
+        out_(out)
+    {
+    }
+
+    void write(const mgjson_private& node)
+    {
+        if (mgjson::Object != node.type_) {
+            throw std::invalid_argument("mgjson::to_bson() value has to be an object.");
+        }
+        write_document(node);
+    }
+
+private:
+    /* Size of document is written when it is complete.
+     */
+    void write_document(const mgjson_private& document)
+    {
+        std::unique_ptr<mgjson_private> copy;
+        const mgjson_private& node = mgjson_image::items(document, copy);
+        const size_t start = out_.size();
+        out_.append(4, '\0');
+        if (mgjson::Array == node.type_) {
+            char name[24];
+            for (size_t i = 0; i < node.array_.size(); ++i) {
+                char* p = mgjson_dtoa::write_uint(name, i);
+                *p++ = '\0';
+                write_element(name, static_cast<size_t>(p - name), *mgjson_private::get(node.array_[i]));
+            }
+        }
+        else {
+            for (const auto& item : node.map_) {
+                const mgjson_private& child = *mgjson_private::get(item.second);
+                if (mgjson::Undefined != child.type_) {
+                    write_element(item.first.d, strlen(item.first.d) + 1, child);
+                }
+            }
+        }
+        out_.push_back('\0');
+        const size_t size = out_.size() - start;
+        if (static_cast<size_t>(std::numeric_limits<int32_t>::max()) < size) {
+            throw std::length_error("mgjson::to_bson() document is larger than 2 GiB.");
+        }
+        mgjson_binary::store32_le(&out_[start], static_cast<uint32_t>(size));
+    }
+
+    /* Name (with its zero byte) and value; type byte is set after value is
+     * written.
+     */
+    void write_element(const char* name, size_t name_size, const mgjson_private& node)
+    {
+        const size_t type_pos = out_.size();
+        out_.push_back('\0');
+        out_.append(name, name_size);
+        out_[type_pos] = static_cast<char>(write_value(node));
+    }
+
+    bson_type write_value(const mgjson_private& node)
+    {
+        switch (node.type_) {
+        case mgjson::Bool:
+            out_.push_back(node.b_value_ ? '\1' : '\0');
+            return BsonBool;
+        case mgjson::Integer:
+        case mgjson::Double:
+            return write_number(mgjson_binary::number(node));
+        case mgjson::String:
+#ifdef QT_CORE_LIB
+            return write_string(node.str_value_.constData(), static_cast<size_t>(node.str_value_.size()));
+#else
+            return write_string(node.str_value_.data(), node.str_value_.size());
+#endif
+        case mgjson::Array:
+            write_document(node);
+            return BsonArray;
+        case mgjson::Object:
+            write_document(node);
+            return BsonDocument;
+        default:
+            return BsonNull;
+        }
+    }
+
+    bson_type write_number(const mgjson_binary::number& n)
+    {
+        char buf[8];
+        if (n.is_integer
+                && (n.negative || (static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) >= n.magnitude))) {
+            const int64_t value = n.negative ? static_cast<int64_t>(0ULL - n.magnitude)
+                                             : static_cast<int64_t>(n.magnitude);
+            if ((std::numeric_limits<int32_t>::min() <= value) && (std::numeric_limits<int32_t>::max() >= value)) {
+                out_.append(buf, mgjson_binary::store32_le(buf, static_cast<uint32_t>(value)) - buf);
+                return BsonInt32;
+            }
+            out_.append(buf, mgjson_binary::store64_le(buf, static_cast<uint64_t>(value)) - buf);
+            return BsonInt64;
+        }
+        out_.append(buf, mgjson_binary::store64_le(buf, mgjson_binary::double_bits(n.value)) - buf);
+        return BsonDouble;
+    }
+
+    bson_type write_string(const char* str, size_t size)
+    {
+        char buf[5];
+        if (str + size == mgjson_utf8::validate(str, str + size)) {
+            out_.append(buf, mgjson_binary::store32_le(buf, static_cast<uint32_t>(size + 1)) - buf);
+            out_.append(str, size);
+            out_.push_back('\0');
+            return BsonString;
+        }
+        mgjson_binary::store32_le(buf, static_cast<uint32_t>(size));
+        buf[4] = '\0';      // Generic binary subtype.
+        out_.append(buf, 5);
+        out_.append(str, size);
+        return BsonBinary;
+    }
+
+private:
+    std::string& out_;
+};
+
+/* Nodes are built straight from input. Declared size of every document is
+ * checked against data before its elements are read, and every element has
+ * to end inside its document. Strings, JavaScript code, symbols and
+ * binaries become String values, ObjectId is hexadecimal string, date-time
+ * and timestamp are integers. Other types (regular expressions, decimal128
+ * and so on) are reported as InvalidCharacter.
+ */
+class bson_decoder : public mgjson_binary::decoder
+{
+public:
+    bson_decoder(const char* data, size_t cb_data, const mgjson::parse_options& options) :
+        decoder(data, cb_data, options),
+        limit_(end_)
+    {
+    }
+
+    mgjson parse(parse_result* result)
+    {
+        return parse_document(result, [this](mgjson& value) {
+            return parse_embedded(value, false);
+        });
+    }
+
+private:
+    /* Checks that size bytes remain in current document; pos is of the
+     * length (or of the value, if it has fixed size).
+     */
+    inline bool inside(uint64_t size, const char* pos)
+    {
+        if (static_cast<uint64_t>(limit_ - p_) < size) {
+            return fail(parse_result::InvalidCharacter, pos);
+        }
+        return true;
+    }
+
+    inline bool inside(uint64_t size)
+    {
+        return inside(size, p_);
+    }
+
+    bool parse_embedded(mgjson& value, bool array)
+    {
+        const char* pos = p_;
+        if (!need(4)) {
+            return false;
+        }
+        const uint32_t size = mgjson_binary::load32_le(p_);
+        if ((5 > size) || (static_cast<uint32_t>(std::numeric_limits<int32_t>::max()) < size)) {
+            return fail(parse_result::InvalidCharacter, pos);
+        }
+        if (!need(size) || !inside(size)) {
+            return false;
+        }
+        const char* last = pos + size - 1;
+        if ('\0' != *last) {
+            return fail(parse_result::InvalidCharacter, last);
+        }
+        if (!enter()) {
+            return false;
+        }
+        p_ += 4;
+
+        const char* parent_limit = limit_;
+        limit_ = last;
+        mgjson_private* data = new mgjson_private(array ? mgjson::Array : mgjson::Object);
+        value = mgjson_private::make(data);
+        std::vector<const mgjson_private*> collected;   // See add_field().
+        while (last != p_) {
+            const char* type_pos = p_++;
+            const char* name = p_;
+            const char* name_end = static_cast<const char*>(memchr(p_, 0, static_cast<size_t>(last - p_)));
+            if (nullptr == name_end) {
+                return fail(parse_result::InvalidName, name);
+            }
+            p_ = name_end + 1;
+            if (array) {
+                data->array_.push_back(mgjson_private::make(nullptr));
+                if (!parse_value(*type_pos, type_pos, data->array_.back())) {
+                    return false;
+                }
+                continue;
+            }
+            key_.assign(name, static_cast<size_t>(name_end - name));
+            if (!check_key(name)) {
+                return false;
+            }
+            mgjson_private::Key key(key_.c_str());
+            mgjson item(mgjson_private::make(nullptr));
+            if (!parse_value(*type_pos, type_pos, item)
+                    || !add_field(data, std::move(key), item, name, collected)) {
+                return false;
+            }
+        }
+        p_ = last + 1;
+        limit_ = parent_limit;
+        leave();
+        return true;
+    }
+
+    bool parse_value(char type, const char* pos, mgjson& value)
+    {
+        switch (static_cast<unsigned char>(type)) {
+        case BsonDouble:
+            if (!inside(8)) {
+                return false;
+            }
+            value = make_double(mgjson_binary::double_from_bits(mgjson_binary::load64_le(p_)));
+            p_ += 8;
+            return true;
+        case BsonString:
+        case BsonJavaScript:
+        case BsonSymbol:
+        {
+            if (!inside(4)) {
+                return false;
+            }
+            const uint32_t size = mgjson_binary::load32_le(p_);
+            p_ += 4;
+            if (0 == size) {
+                return fail(parse_result::InvalidCharacter, p_ - 4);
+            }
+            if (!inside(size, p_ - 4)) {
+                return false;
+            }
+            if ('\0' != p_[size - 1]) {
+                return fail(parse_result::InvalidCharacter, p_ + size - 1);
+            }
+            if (!check_length(size - 1, pos)) {
+                return false;
+            }
+            take_string(value, size - 1);
+            ++p_;
+            return true;
+        }
+        case BsonDocument:
+            return parse_embedded(value, false);
+        case BsonArray:
+            return parse_embedded(value, true);
+        case BsonBinary:
+        {
+            if (!inside(5)) {
+                return false;
+            }
+            const uint32_t size = mgjson_binary::load32_le(p_);
+            p_ += 5;
+            if (!inside(size, p_ - 5)) {
+                return false;
+            }
+            if (!check_length(size, pos)) {
+                return false;
+            }
+            take_string(value, size);
+            return true;
+        }
+        case BsonUndefined:
+            value = mgjson_private::make(new mgjson_private(mgjson::Undefined));
+            return true;
+        case BsonObjectId:
+        {
+            if (!inside(12)) {
+                return false;
+            }
+            static const char digits[] = "0123456789abcdef";
+            char text[24];
+            for (size_t i = 0; i < 12; ++i) {
+                const unsigned char c = static_cast<unsigned char>(p_[i]);
+                text[2 * i] = digits[c >> 4];
+                text[2 * i + 1] = digits[c & 0x0F];
+            }
+            p_ += 12;
+            value = mgjson_private::make(new mgjson_private(
+                        mgjson_private::string_type(text, static_cast<int>(sizeof(text)))));
+            return true;
+        }
+        case BsonBool:
+            if (!inside(1)) {
+                return false;
+            }
+            if (1 < static_cast<unsigned char>(*p_)) {
+                return fail(parse_result::InvalidCharacter);
+            }
+            value = mgjson_private::make(new mgjson_private('\0' != *p_++));
+            return true;
+        case BsonNull:
+            value = mgjson_private::make(new mgjson_private(mgjson::Null));
+            return true;
+        case BsonInt32:
+            if (!inside(4)) {
+                return false;
+            }
+            value = mgjson_private::make(new mgjson_private(
+                        static_cast<long long>(static_cast<int32_t>(mgjson_binary::load32_le(p_)))));
+            p_ += 4;
+            return true;
+        case BsonDateTime:
+        case BsonInt64:
+            if (!inside(8)) {
+                return false;
+            }
+            value = mgjson_private::make(new mgjson_private(
+                        static_cast<long long>(mgjson_binary::load64_le(p_))));
+            p_ += 8;
+            return true;
+        case BsonTimestamp:
+            if (!inside(8)) {
+                return false;
+            }
+            value = make_integer(false, mgjson_binary::load64_le(p_));
+            p_ += 8;
+            return true;
+        default:
+            return fail(parse_result::InvalidCharacter, pos);
+        }
+    }
+
+private:
+    const char* limit_;     // Terminator of current document.
+};
+
+}   // namespace
+
+std::string
+mgjson::to_bson() const
+{
+    std::string result;
+    bson_writer(result).write(*d);
+    return result;
+}
+
+void
+mgjson::to_bson(std::string& out) const
+{
+    bson_writer(out).write(*d);
+}
+
+mgjson
+mgjson::from_bson(const char *data, size_t cb_data, parse_result *result)
+{
+    return bson_decoder(data, cb_data, parse_options()).parse(result);
+}
+
+mgjson
+mgjson::from_bson(const char *data, size_t cb_data, const parse_options& options,
+                  parse_result *result)
+{
+    return bson_decoder(data, cb_data, options).parse(result);
+}
@@ -0,0 +1,530 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+#include "mgjson_private.h"
+#include "mgjson_image.h"
+#include "mgjson_binary.h"
+#include "mgjson_utf8.h"
+
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+
+typedef mgjson::parse_result parse_result;
+
+enum cbor_major {
+    UnsignedInt     = 0,
+    NegativeInt     = 1,
+    ByteString      = 2,
+    TextString      = 3,
+    ArrayItems      = 4,
+    MapItems        = 5,
+    Tag             = 6,
+    Simple          = 7
+};
+
+const unsigned char cbor_false = 0xF4;
+const unsigned char cbor_true = 0xF5;
+const unsigned char cbor_null = 0xF6;
+const unsigned char cbor_undefined = 0xF7;
+const unsigned char cbor_half = 0xF9;
+const unsigned char cbor_float = 0xFA;
+const unsigned char cbor_double = 0xFB;
+const unsigned char cbor_break = 0xFF;
+const unsigned char cbor_indefinite = 31;
+
+/* Half precision form of value, if it is exact (nan becomes the canonical
+ * one).
+ */
+bool half_bits(float value, uint16_t& half)
+{
+    const uint32_t bits = mgjson_binary::float_bits(value);
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127;
+    const uint32_t mantissa = bits & 0x7FFFFF;
+    if (128 == exponent) {
+        half = static_cast<uint16_t>((0 == mantissa) ? (sign | 0x7C00) : 0x7E00);
+        return true;
+    }
+    if ((-127 == exponent) && (0 == mantissa)) {
+        half = sign;
+        return true;
+    }
+    if ((-14 <= exponent) && (15 >= exponent)) {
+        if (0 != (mantissa & 0x1FFF)) {
+            return false;
+        }
+        half = static_cast<uint16_t>(sign | ((exponent + 15) << 10) | (mantissa >> 13));
+        return true;
+    }
+    if ((-24 <= exponent) && (-14 > exponent)) {
+        // Subnormal half.
+        const uint32_t significand = 0x800000 | mantissa;
+        const int shift = 13 + (-14 - exponent);
+        if (0 != (significand & ((1U << shift) - 1))) {
+            return false;
+        }
+        half = static_cast<uint16_t>(sign | (significand >> shift));
+        return true;
+    }
+    return false;
+}
+
+double half_value(uint16_t half)
+{
+    const int exponent = (half >> 10) & 0x1F;
+    const int mantissa = half & 0x3FF;
+    double value;
+    if (0 == exponent) {
+        value = std::ldexp(static_cast<double>(mantissa), -24);
+    }
+    else if (31 != exponent) {
+        value = std::ldexp(static_cast<double>(mantissa + 1024), exponent - 25);
+    }
+    else {
+        value = (0 == mantissa) ? std::numeric_limits<double>::infinity()
+                                : std::numeric_limits<double>::quiet_NaN();
+    }
+    return (0 != (half & 0x8000)) ? -value : value;
+}
+
+/* Items are written with definite lengths; integers and floats take the
+ * smallest form what keeps the value (so 1.5 is half float). Strings what
+ * are not valid UTF-8 are written as byte strings. Undefined fields are
+ * not written, other undefined values are CBOR undefined.
+ */
+class cbor_writer
+{
+public:
+    explicit cbor_writer(std::string& out) :
+        out_(out)
+    {
+    }
+
+    void write(const mgjson_private& node)
+    {
+        switch (node.type_) {
+        case mgjson::Null:
+            out_.push_back(static_cast<char>(cbor_null));
+            break;
+        case mgjson::Bool:
+            out_.push_back(static_cast<char>(node.b_value_ ? cbor_true : cbor_false));
+            break;
+        case mgjson::Integer:
+        case mgjson::Double:
+            write_number(mgjson_binary::number(node));
+            break;
+        case mgjson::String:
+#ifdef QT_CORE_LIB
+            write_string(node.str_value_.constData(), static_cast<size_t>(node.str_value_.size()));
+#else
+            write_string(node.str_value_.data(), node.str_value_.size());
+#endif
+            break;
+        case mgjson::Array:
+        {
+            std::unique_ptr<mgjson_private> copy;
+            const mgjson_private& items = mgjson_image::items(node, copy);
+            write_head(ArrayItems, items.array_.size());
+            for (const mgjson& item : items.array_) {
+                write(*mgjson_private::get(item));
+            }
+            break;
+        }
+        case mgjson::Object:
+        {
+            std::unique_ptr<mgjson_private> copy;
+            const mgjson_private& items = mgjson_image::items(node, copy);
+            size_t count = 0;
+            for (const auto& item : items.map_) {
+                count += (mgjson::Undefined != mgjson_private::get(item.second)->type_) ? 1 : 0;
+            }
+            write_head(MapItems, count);
+            for (const auto& item : items.map_) {
+                const mgjson_private& child = *mgjson_private::get(item.second);
+                if (mgjson::Undefined != child.type_) {
+                    write_string(item.first.d, strlen(item.first.d));
+                    write(child);
+                }
+            }
+            break;
+        }
+        default:
+            out_.push_back(static_cast<char>(cbor_undefined));
+            break;
+        }
+    }
+
+private:
+    void write_head(cbor_major major, uint64_t argument)
+    {
+        const char code = static_cast<char>(major << 5);
+        if (24 > argument) {
+            out_.push_back(static_cast<char>(code | static_cast<char>(argument)));
+        }
+        else if (256 > argument) {
+            mgjson_binary::put(out_, static_cast<char>(code | 24), argument, 1);
+        }
+        else if (65536 > argument) {
+            mgjson_binary::put(out_, static_cast<char>(code | 25), argument, 2);
+        }
+        else if (4294967296ULL > argument) {
+            mgjson_binary::put(out_, static_cast<char>(code | 26), argument, 4);
+        }
+        else {
+            mgjson_binary::put(out_, static_cast<char>(code | 27), argument, 8);
+        }
+    }
+
+    void write_number(const mgjson_binary::number& n)
+    {
+        if (n.is_integer) {
+            if (n.negative) {
+                write_head(NegativeInt, n.magnitude - 1);
+            }
+            else {
+                write_head(UnsignedInt, n.magnitude);
+            }
+            return;
+        }
+
+        const float single = static_cast<float>(n.value);
+        if ((static_cast<double>(single) != n.value) && !std::isnan(n.value)) {
+            mgjson_binary::put(out_, static_cast<char>(cbor_double),
+                               mgjson_binary::double_bits(n.value), 8);
+            return;
+        }
+        uint16_t half;
+        if (half_bits(single, half)) {
+            mgjson_binary::put(out_, static_cast<char>(cbor_half), half, 2);
+        }
+        else {
+            mgjson_binary::put(out_, static_cast<char>(cbor_float), mgjson_binary::float_bits(single), 4);
+        }
+    }
+
+    void write_string(const char* str, size_t size)
+    {
+        const bool text = (str + size == mgjson_utf8::validate(str, str + size));
+        write_head(text ? TextString : ByteString, size);
+        out_.append(str, size);
+    }
+
+private:
+    std::string& out_;
+};
+
+/* Nodes are built straight from input. Text and byte strings become String
+ * values (chunks of indefinite-length strings are joined), map keys have to
+ * be strings; tags are skipped, tagged item is read as is. Simple values
+ * other than false, true, null and undefined are reported as
+ * InvalidCharacter.
+ */
+class cbor_decoder : public mgjson_binary::decoder
+{
+public:
+    cbor_decoder(const char* data, size_t cb_data, const mgjson::parse_options& options) :
+        decoder(data, cb_data, options)
+    {
+    }
+
+    mgjson parse(parse_result* result)
+    {
+        return parse_document(result, [this](mgjson& value) {
+            return parse_value(value);
+        });
+    }
+
+private:
+    /* Initial byte at p_ (after tags, head points to it): major type and
+     * argument; indefinite is set for additional information 31.
+     */
+    bool parse_head(const char*& head, unsigned& major, uint64_t& argument, bool& indefinite)
+    {
+        for (;;) {
+            if (!need(1)) {
+                return false;
+            }
+            head = p_;
+            const unsigned char code = static_cast<unsigned char>(*p_++);
+            major = code >> 5;
+            const unsigned info = code & 0x1F;
+            indefinite = (cbor_indefinite == info);
+            if (24 > info) {
+                argument = info;
+            }
+            else if (24 == info) {
+                if (!need(1)) {
+                    return false;
+                }
+                argument = static_cast<unsigned char>(*p_++);
+            }
+            else if (25 == info) {
+                if (!need(2)) {
+                    return false;
+                }
+                argument = mgjson_binary::load16(p_);
+                p_ += 2;
+            }
+            else if (26 == info) {
+                if (!need(4)) {
+                    return false;
+                }
+                argument = mgjson_binary::load32(p_);
+                p_ += 4;
+            }
+            else if (27 == info) {
+                if (!need(8)) {
+                    return false;
+                }
+                argument = mgjson_binary::load64(p_);
+                p_ += 8;
+            }
+            else if (!indefinite
+                     || (UnsignedInt == major) || (NegativeInt == major) || (Tag == major)) {
+                return fail(parse_result::InvalidCharacter, head);
+            }
+            if (Tag != major) {
+                return true;
+            }
+        }
+    }
+
+    bool parse_value(mgjson& value)
+    {
+        const char* pos;
+        unsigned major;
+        uint64_t argument = 0;
+        bool indefinite;
+        if (!parse_head(pos, major, argument, indefinite)) {
+            return false;
+        }
+
+        switch (major) {
+        case UnsignedInt:
+            value = make_integer(false, argument);
+            return true;
+        case NegativeInt:
+            if (static_cast<uint64_t>(std::numeric_limits<long long>::max()) < argument) {
+                value = mgjson_private::make(new mgjson_private(-1.0L - static_cast<long double>(argument)));
+            }
+            else {
+                value = make_integer(true, argument + 1);
+            }
+            return true;
+        case ByteString:
+        case TextString:
+            if (!indefinite) {
+                if (!check_string(argument, pos)) {
+                    return false;
+                }
+                take_string(value, static_cast<size_t>(argument));
+                return true;
+            }
+            if (!parse_chunks(major, text_, pos)) {
+                return false;
+            }
+            value = mgjson_private::make(new mgjson_private(
+                        mgjson_private::string_type(text_.data(), static_cast<int>(text_.size()))));
+            return true;
+        case ArrayItems:
+            return parse_array(value, argument, indefinite);
+        case MapItems:
+            return parse_map(value, argument, indefinite);
+        default:
+            return parse_simple(value, pos, argument);
+        }
+    }
+
+    bool parse_simple(mgjson& value, const char* pos, uint64_t argument)
+    {
+        switch (static_cast<unsigned char>(*pos)) {
+        case cbor_false:
+        case cbor_true:
+            value = mgjson_private::make(new mgjson_private(cbor_true == static_cast<unsigned char>(*pos)));
+            return true;
+        case cbor_null:
+            value = mgjson_private::make(new mgjson_private(mgjson::Null));
+            return true;
+        case cbor_undefined:
+            value = mgjson_private::make(new mgjson_private(mgjson::Undefined));
+            return true;
+        case cbor_half:
+            value = make_double(half_value(static_cast<uint16_t>(argument)));
+            return true;
+        case cbor_float:
+            value = make_double(mgjson_binary::float_from_bits(static_cast<uint32_t>(argument)));
+            return true;
+        case cbor_double:
+            value = make_double(mgjson_binary::double_from_bits(argument));
+            return true;
+        default:
+            return fail(parse_result::InvalidCharacter, pos);
+        }
+    }
+
+    /* Break code at p_ ends indefinite-length item.
+     */
+    inline bool at_break()
+    {
+        if ((end_ != p_) && (cbor_break == static_cast<unsigned char>(*p_))) {
+            ++p_;
+            return true;
+        }
+        return false;
+    }
+
+    /* Chunks of indefinite-length string (of major type) joined into text;
+     * every chunk is definite-length string of the same type.
+     */
+    bool parse_chunks(unsigned major, std::string& text, const char* pos)
+    {
+        text.clear();
+        for (;;) {
+            if (!need(1)) {
+                return false;
+            }
+            if (at_break()) {
+                return true;
+            }
+            const char* chunk_pos;
+            unsigned chunk_major;
+            uint64_t size = 0;
+            bool indefinite;
+            if (!parse_head(chunk_pos, chunk_major, size, indefinite)) {
+                return false;
+            }
+            if ((chunk_major != major) || indefinite) {
+                return fail(parse_result::InvalidCharacter, chunk_pos);
+            }
+            if (!need(size) || !check_length(text.size() + size, pos)) {
+                return false;
+            }
+            text.append(p_, static_cast<size_t>(size));
+            p_ += size;
+        }
+    }
+
+    /* Definite count is checked against size of data (every item takes at
+     * least one byte) before anything is allocated.
+     */
+    bool parse_array(mgjson& value, uint64_t count, bool indefinite)
+    {
+        if ((!indefinite && !need(count)) || !enter()) {
+            return false;
+        }
+        mgjson_private* data = new mgjson_private(mgjson::Array);
+        value = mgjson_private::make(data);
+        if (!indefinite) {
+            data->array_.assign(static_cast<size_t>(count), mgjson_private::make(nullptr));
+            for (mgjson& item : data->array_) {
+                if (!parse_value(item)) {
+                    return false;
+                }
+            }
+        }
+        else {
+            for (;;) {
+                if (!need(1)) {
+                    return false;
+                }
+                if (at_break()) {
+                    break;
+                }
+                data->array_.push_back(mgjson_private::make(nullptr));
+                if (!parse_value(data->array_.back())) {
+                    return false;
+                }
+            }
+        }
+        leave();
+        return true;
+    }
+
+    bool parse_map(mgjson& value, uint64_t count, bool indefinite)
+    {
+        if ((!indefinite && !need(2 * count)) || !enter()) {
+            return false;
+        }
+        mgjson_private* data = new mgjson_private(mgjson::Object);
+        value = mgjson_private::make(data);
+        std::vector<const mgjson_private*> collected;   // See add_field().
+        for (uint64_t i = 0; indefinite || (i < count); ++i) {
+            if (indefinite) {
+                if (!need(1)) {
+                    return false;
+                }
+                if (at_break()) {
+                    break;
+                }
+            }
+            const char* key_pos = p_;
+            if (!parse_key()) {
+                return false;
+            }
+            mgjson_private::Key key(key_.c_str());
+            mgjson item(mgjson_private::make(nullptr));
+            if (!parse_value(item) || !add_field(data, std::move(key), item, key_pos, collected)) {
+                return false;
+            }
+        }
+        leave();
+        return true;
+    }
+
+    bool parse_key()
+    {
+        const char* pos;
+        unsigned major;
+        uint64_t size = 0;
+        bool indefinite;
+        if (!parse_head(pos, major, size, indefinite)) {
+            return false;
+        }
+        if ((TextString != major) && (ByteString != major)) {
+            return fail(parse_result::InvalidName, pos);
+        }
+        if (!indefinite) {
+            return take_key(static_cast<size_t>(size), pos);
+        }
+        return parse_chunks(major, key_, pos) && check_key(pos);
+    }
+
+private:
+    std::string text_;      // Indefinite-length string being joined.
+};
+
+}   // namespace
+
+std::string
+mgjson::to_cbor() const
+{
+    std::string result;
+    cbor_writer(result).write(*d);
+    return result;
+}
+
+void
+mgjson::to_cbor(std::string& out) const
+{
+    cbor_writer(out).write(*d);
+}
+
+mgjson
+mgjson::from_cbor(const char *data, size_t cb_data, parse_result *result)
+{
+    return cbor_decoder(data, cb_data, parse_options()).parse(result);
+}
+
+mgjson
+mgjson::from_cbor(const char *data, size_t cb_data, const parse_options& options,
+                  parse_result *result)
+{
+    return cbor_decoder(data, cb_data, options).parse(result);
+}
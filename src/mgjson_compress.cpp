@@ -0,0 +1,464 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+#include "mgjson_binary.h"
+
+#include <string>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef MGJSON_USE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef MGJSON_USE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace
+{
+
+typedef mgjson::parse_result parse_result;
+
+/* Compressed data is written straight into the end of out; if compression
+ * fails, out is left as it was.
+ */
+class compressed_output
+{
+protected:
+    explicit compressed_output(std::string& out) :
+        out_(out),
+        start_(out.size()),
+        size_(out.size())
+    {
+    }
+
+    /* Space for size bytes after written data.
+     */
+    char* room(size_t size)
+    {
+        if (out_.size() < size_ + size) {
+            out_.resize(std::max(size_ + size, out_.size() + out_.size() / 2));
+        }
+        return &out_[size_];
+    }
+
+    inline void add(size_t size)
+    {
+        size_ += size;
+    }
+
+public:
+    void finish(bool ok)
+    {
+        out_.resize(ok ? size_ : start_);
+    }
+
+private:
+    std::string& out_;
+    const size_t start_;
+    size_t size_;
+};
+
+#ifdef MGJSON_USE_LZ4
+class lz4_compressor : public compressed_output
+{
+public:
+    lz4_compressor(std::string& out, int level) :
+        compressed_output(out),
+        ctx_(nullptr)
+    {
+        memset(&prefs_, 0, sizeof(prefs_));
+        prefs_.compressionLevel = level;
+        if (LZ4F_isError(LZ4F_createCompressionContext(&ctx_, LZ4F_VERSION))) {
+            throw std::bad_alloc();
+        }
+    }
+
+    ~lz4_compressor()
+    {
+        LZ4F_freeCompressionContext(ctx_);
+    }
+
+    bool begin()
+    {
+        return put(LZ4F_compressBegin(ctx_, room(LZ4F_HEADER_SIZE_MAX), LZ4F_HEADER_SIZE_MAX, &prefs_));
+    }
+
+    bool update(const char* data, size_t size)
+    {
+        const size_t bound = LZ4F_compressBound(size, &prefs_);
+        return put(LZ4F_compressUpdate(ctx_, room(bound), bound, data, size, nullptr));
+    }
+
+    bool end()
+    {
+        const size_t bound = LZ4F_compressBound(0, &prefs_);
+        return put(LZ4F_compressEnd(ctx_, room(bound), bound, nullptr));
+    }
+
+private:
+    inline bool put(size_t size)
+    {
+        if (LZ4F_isError(size)) {
+            return false;
+        }
+        add(size);
+        return true;
+    }
+
+private:
+    LZ4F_cctx* ctx_;
+    LZ4F_preferences_t prefs_;
+};
+#endif
+
+#ifdef MGJSON_USE_ZSTD
+class zstd_compressor : public compressed_output
+{
+public:
+    zstd_compressor(std::string& out, int level) :
+        compressed_output(out),
+        ctx_(ZSTD_createCCtx())
+    {
+        if (nullptr == ctx_) {
+            throw std::bad_alloc();
+        }
+        if (0 != level) {
+            ZSTD_CCtx_setParameter(ctx_, ZSTD_c_compressionLevel, level);
+        }
+    }
+
+    ~zstd_compressor()
+    {
+        ZSTD_freeCCtx(ctx_);
+    }
+
+    inline bool begin()
+    {
+        return true;
+    }
+
+    bool update(const char* data, size_t size)
+    {
+        ZSTD_inBuffer in = {data, size, 0};
+        return stream(in, ZSTD_e_continue);
+    }
+
+    bool end()
+    {
+        ZSTD_inBuffer in = {nullptr, 0, 0};
+        return stream(in, ZSTD_e_end);
+    }
+
+private:
+    /* Until input is taken (or, at the end, frame is flushed).
+     */
+    bool stream(ZSTD_inBuffer& in, ZSTD_EndDirective directive)
+    {
+        const size_t chunk = ZSTD_CStreamOutSize();
+        for (;;) {
+            ZSTD_outBuffer out = {room(chunk), chunk, 0};
+            const size_t remaining = ZSTD_compressStream2(ctx_, &out, &in, directive);
+            add(out.pos);
+            if (ZSTD_isError(remaining)) {
+                return false;
+            }
+            if ((ZSTD_e_end == directive) ? (0 == remaining) : (in.pos == in.size)) {
+                return true;
+            }
+        }
+    }
+
+private:
+    ZSTD_CCtx* const ctx_;
+};
+#endif
+
+template <class C>
+void compress(const mgjson& json, C&& compressor, mgjson::json_format format)
+{
+    const bool ok = compressor.begin()
+            && json.to_json([&compressor](const char* data, size_t size) {
+                                return compressor.update(data, size);
+                            }, format)
+            && compressor.end();
+    compressor.finish(ok);
+    if (!ok) {
+        throw std::runtime_error("mgjson::to_compressed() compression failed.");
+    }
+}
+
+/* Decompressed text is written straight into text, what grows as needed
+ * (text of mgjson_parser is reused so); its first size is guessed from
+ * size of compressed data. Text longer than max_size (if it is not 0) is
+ * not decompressed further.
+ */
+class text_buffer
+{
+public:
+    text_buffer(std::string& text, size_t cb_data, size_t max_size) :
+        text_(text),
+        size_(0),
+        max_size_(max_size)
+    {
+        size_t initial = std::max<size_t>(4 * cb_data, 4096);
+        if (0 != max_size_) {
+            initial = std::min(initial, max_size_ + 1);
+        }
+        if (text_.size() < initial) {
+            text_.resize(initial);
+        }
+    }
+
+    ~text_buffer()
+    {
+        text_.resize(size_);
+    }
+
+    /* Makes free space; false if text is over limit.
+     */
+    bool reserve()
+    {
+        if (over_limit()) {
+            return false;
+        }
+        if (text_.size() == size_) {
+            size_t size = 2 * text_.size();
+            if (0 != max_size_) {
+                size = std::min(size, max_size_ + 1);
+            }
+            text_.resize(size);
+        }
+        return true;
+    }
+
+    inline char* free()
+    {
+        return &text_[size_];
+    }
+
+    inline size_t free_size() const
+    {
+        return text_.size() - size_;
+    }
+
+    inline void add(size_t size)
+    {
+        size_ += size;
+    }
+
+    inline bool over_limit() const
+    {
+        return (0 != max_size_) && (size_ > max_size_);
+    }
+
+private:
+    std::string& text_;
+    size_t size_;
+    const size_t max_size_;
+};
+
+#ifdef MGJSON_USE_LZ4
+parse_result::parse_error lz4_decompress(const char* data, size_t cb_data, text_buffer& text,
+                                         size_t& used)
+{
+    LZ4F_dctx* ctx;
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION))) {
+        throw std::bad_alloc();
+    }
+    std::unique_ptr<LZ4F_dctx, LZ4F_errorCode_t (*)(LZ4F_dctx*)> guard(ctx, LZ4F_freeDecompressionContext);
+    for (;;) {
+        if (!text.reserve()) {
+            return parse_result::SizeLimitExceeded;
+        }
+        const size_t free_size = text.free_size();
+        size_t dst_size = free_size;
+        size_t src_size = cb_data - used;
+        const size_t hint = LZ4F_decompress(ctx, text.free(), &dst_size, data + used, &src_size, nullptr);
+        used += src_size;
+        text.add(dst_size);
+        if (LZ4F_isError(hint)) {
+            return parse_result::CompressionError;
+        }
+        if (0 == hint) {
+            return text.over_limit() ? parse_result::SizeLimitExceeded : parse_result::NoError;
+        }
+        if ((cb_data == used) && (dst_size < free_size)) {
+            return parse_result::EndOfData;
+        }
+    }
+}
+#endif
+
+#ifdef MGJSON_USE_ZSTD
+parse_result::parse_error zstd_decompress(const char* data, size_t cb_data, text_buffer& text,
+                                          size_t& used)
+{
+    ZSTD_DCtx* ctx = ZSTD_createDCtx();
+    if (nullptr == ctx) {
+        throw std::bad_alloc();
+    }
+    std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> guard(ctx, ZSTD_freeDCtx);
+    ZSTD_inBuffer in = {data, cb_data, 0};
+    for (;;) {
+        if (!text.reserve()) {
+            return parse_result::SizeLimitExceeded;
+        }
+        ZSTD_outBuffer out = {text.free(), text.free_size(), 0};
+        const size_t hint = ZSTD_decompressStream(ctx, &out, &in);
+        used = in.pos;
+        text.add(out.pos);
+        if (ZSTD_isError(hint)) {
+            return parse_result::CompressionError;
+        }
+        if (0 == hint) {
+            return text.over_limit() ? parse_result::SizeLimitExceeded : parse_result::NoError;
+        }
+        if ((in.size == in.pos) && (out.size > out.pos)) {
+            return parse_result::EndOfData;
+        }
+    }
+}
+#endif
+
+/* Decompresses frame at data into text; used is size of frame (or offset
+ * of error).
+ */
+parse_result::parse_error decompress(const char* data, size_t cb_data, size_t max_size,
+                                     std::string& text, size_t& used)
+{
+    used = 0;
+    if (4 > cb_data) {
+        return parse_result::EndOfData;
+    }
+    text_buffer buffer(text, cb_data, max_size);
+    const uint32_t magic = mgjson_binary::load32_le(data);    // Little-endian in both formats.
+#ifdef MGJSON_USE_LZ4
+    if (0x184D2204 == magic) {
+        return lz4_decompress(data, cb_data, buffer, used);
+    }
+#endif
+#ifdef MGJSON_USE_ZSTD
+    if (0xFD2FB528 == magic) {
+        return zstd_decompress(data, cb_data, buffer, used);
+    }
+#endif
+    (void) magic;
+    return parse_result::CompressionError;
+}
+
+/* Text is parsed by parse_text(text, result).
+ */
+template <typename F>
+mgjson parse_compressed(const char* data, size_t cb_data, size_t max_size, std::string& text,
+                        parse_result* result, F parse_text)
+{
+    parse_result local_result;
+    if (nullptr == result) {
+        result = &local_result;
+    }
+    size_t used;
+    const parse_result::parse_error error = decompress(data, cb_data, max_size, text, used);
+    if (parse_result::NoError != error) {
+        result->error = error;
+        result->offset = static_cast<int>(used);
+        result->row = 0;
+        result->col = 0;
+        return mgjson(mgjson::Undefined);
+    }
+
+    mgjson value = parse_text(text, result);
+    if ((parse_result::NoError == result->error) && (cb_data != used)) {
+        result->error = parse_result::MoreData;
+        result->offset = static_cast<int>(used);
+        result->row = 0;
+        result->col = 0;
+    }
+    return value;
+}
+
+}   // namespace
+
+bool
+mgjson::compression_supported(json_compression compression)
+{
+    switch (compression) {
+#ifdef MGJSON_USE_LZ4
+    case CompressLz4:
+        return true;
+#endif
+#ifdef MGJSON_USE_ZSTD
+    case CompressZstd:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+std::string
+mgjson::to_compressed(json_compression compression, json_format format, int level) const
+{
+    std::string result;
+    to_compressed(result, compression, format, level);
+    return result;
+}
+
+void
+mgjson::to_compressed(std::string& out, json_compression compression, json_format format,
+                      int level) const
+{
+    (void) out;
+    (void) format;
+    (void) level;
+    switch (compression) {
+#ifdef MGJSON_USE_LZ4
+    case CompressLz4:
+        compress(*this, lz4_compressor(out, level), format);
+        return;
+#endif
+#ifdef MGJSON_USE_ZSTD
+    case CompressZstd:
+        compress(*this, zstd_compressor(out, level), format);
+        return;
+#endif
+    default:
+        throw std::invalid_argument("mgjson::to_compressed() compression is not supported.");
+    }
+}
+
+mgjson
+mgjson::from_compressed(const char *data, size_t cb_data, parse_result *result, json_parse flags)
+{
+    std::string buffer;
+    return parse_compressed(data, cb_data, 0, buffer, result,
+                            [flags](const std::string& text, parse_result* res) {
+        return from_json(text.data(), text.size(), res, flags);
+    });
+}
+
+mgjson
+mgjson::from_compressed(const char *data, size_t cb_data, const parse_options& options,
+                        parse_result *result)
+{
+    std::string buffer;
+    return parse_compressed(data, cb_data, options.max_size, buffer, result,
+                            [&options](const std::string& text, parse_result* res) {
+        return from_json(text.data(), text.size(), options, res);
+    });
+}
+
+mgjson
+mgjson_parser::parse_compressed(const char *data, size_t cb_data, mgjson::parse_result *result,
+                                mgjson::json_parse flags)
+{
+    return ::parse_compressed(data, cb_data, options_.max_size, text_, result,
+                              [this, flags](const std::string& text, mgjson::parse_result* res) {
+        return parse(text.data(), text.size(), res, flags);
+    });
+}
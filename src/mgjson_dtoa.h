@@ -0,0 +1,338 @@
+#pragma once
+#ifndef _MGJSON_DTOA_H_INCLUDED_
+#define _MGJSON_DTOA_H_INCLUDED_
+
+#include <cstdint>
+#include <cstring>
+
+/* Shortest decimal text of double what reads back as the same double
+ * (Grisu2, see Loitsch, "Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers"). Grisu2 is always exact, and gives the
+ * shortest digits in the most cases. Integral values below 2^53 take
+ * integer path.
+ *
+ * Layout follows JavaScript: plain notation for decimal exponents from -6
+ * to 21, scientific ("1.5e+300", "1e-7") otherwise.
+ */
+namespace mgjson_dtoa
+{
+
+/* Number f * 2^e with 64-bit significand.
+ */
+struct diyfp
+{
+    inline diyfp(uint64_t f_, int e_) : f(f_), e(e_) {}
+
+    uint64_t f;
+    int e;
+};
+
+inline diyfp sub(const diyfp& x, const diyfp& y)
+{
+    return diyfp(x.f - y.f, x.e);
+}
+
+/* Upper 64 bits of 128-bit product, rounded.
+ */
+inline diyfp mul(const diyfp& x, const diyfp& y)
+{
+    const uint64_t x_lo = x.f & 0xFFFFFFFFULL;
+    const uint64_t x_hi = x.f >> 32;
+    const uint64_t y_lo = y.f & 0xFFFFFFFFULL;
+    const uint64_t y_hi = y.f >> 32;
+    const uint64_t p0 = x_lo * y_lo;
+    const uint64_t p1 = x_lo * y_hi;
+    const uint64_t p2 = x_hi * y_lo;
+    const uint64_t p3 = x_hi * y_hi;
+    uint64_t mid = (p0 >> 32) + (p1 & 0xFFFFFFFFULL) + (p2 & 0xFFFFFFFFULL);
+    mid += 1ULL << 31;
+    return diyfp(p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32), x.e + y.e + 64);
+}
+
+inline diyfp normalize(diyfp x)
+{
+    while (0 == (x.f >> 63)) {
+        x.f <<= 1;
+        --x.e;
+    }
+    return x;
+}
+
+/* Value v and middles between v and its neighbours, m_minus and m_plus;
+ * m_minus has exponent of m_plus.
+ */
+inline void boundaries(double value, diyfp& v, diyfp& m_minus, diyfp& m_plus)
+{
+    const uint64_t hidden_bit = 1ULL << 52;
+    const int bias = 1023 + 52;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint64_t e = (bits >> 52) & 0x7FF;
+    const uint64_t f = bits & (hidden_bit - 1);
+    const diyfp w = (0 == e)
+            ? diyfp(f, 1 - bias)
+            : diyfp(f + hidden_bit, static_cast<int>(e) - bias);
+    // Lower neighbour is closer at powers of two (except the smallest one).
+    const bool lower_closer = (0 == f) && (1 < e);
+    m_plus = normalize(diyfp(2 * w.f + 1, w.e - 1));
+    const diyfp lower = lower_closer ? diyfp(4 * w.f - 1, w.e - 2) : diyfp(2 * w.f - 1, w.e - 1);
+    m_minus = diyfp(lower.f << (lower.e - m_plus.e), m_plus.e);
+    v = normalize(w);
+}
+
+struct cached_power
+{
+    uint64_t f;
+    int e;
+    int k;
+};
+
+/* Power c = 10^-k with c * 2^e in range [2^-60, 2^-32], what puts the
+ * product into 64 bits with integer part fitting into 32.
+ */
+inline cached_power cached_power_for(int e)
+{
+    static const cached_power powers[] = {
+        {0xAB70FE17C79AC6CAULL, -1060, -300},
+        {0xFF77B1FCBEBCDC4FULL, -1034, -292},
+        {0xBE5691EF416BD60CULL, -1007, -284},
+        {0x8DD01FAD907FFC3CULL,  -980, -276},
+        {0xD3515C2831559A83ULL,  -954, -268},
+        {0x9D71AC8FADA6C9B5ULL,  -927, -260},
+        {0xEA9C227723EE8BCBULL,  -901, -252},
+        {0xAECC49914078536DULL,  -874, -244},
+        {0x823C12795DB6CE57ULL,  -847, -236},
+        {0xC21094364DFB5637ULL,  -821, -228},
+        {0x9096EA6F3848984FULL,  -794, -220},
+        {0xD77485CB25823AC7ULL,  -768, -212},
+        {0xA086CFCD97BF97F4ULL,  -741, -204},
+        {0xEF340A98172AACE5ULL,  -715, -196},
+        {0xB23867FB2A35B28EULL,  -688, -188},
+        {0x84C8D4DFD2C63F3BULL,  -661, -180},
+        {0xC5DD44271AD3CDBAULL,  -635, -172},
+        {0x936B9FCEBB25C996ULL,  -608, -164},
+        {0xDBAC6C247D62A584ULL,  -582, -156},
+        {0xA3AB66580D5FDAF6ULL,  -555, -148},
+        {0xF3E2F893DEC3F126ULL,  -529, -140},
+        {0xB5B5ADA8AAFF80B8ULL,  -502, -132},
+        {0x87625F056C7C4A8BULL,  -475, -124},
+        {0xC9BCFF6034C13053ULL,  -449, -116},
+        {0x964E858C91BA2655ULL,  -422, -108},
+        {0xDFF9772470297EBDULL,  -396, -100},
+        {0xA6DFBD9FB8E5B88FULL,  -369,  -92},
+        {0xF8A95FCF88747D94ULL,  -343,  -84},
+        {0xB94470938FA89BCFULL,  -316,  -76},
+        {0x8A08F0F8BF0F156BULL,  -289,  -68},
+        {0xCDB02555653131B6ULL,  -263,  -60},
+        {0x993FE2C6D07B7FACULL,  -236,  -52},
+        {0xE45C10C42A2B3B06ULL,  -210,  -44},
+        {0xAA242499697392D3ULL,  -183,  -36},
+        {0xFD87B5F28300CA0EULL,  -157,  -28},
+        {0xBCE5086492111AEBULL,  -130,  -20},
+        {0x8CBCCC096F5088CCULL,  -103,  -12},
+        {0xD1B71758E219652CULL,   -77,   -4},
+        {0x9C40000000000000ULL,   -50,    4},
+        {0xE8D4A51000000000ULL,   -24,   12},
+        {0xAD78EBC5AC620000ULL,     3,   20},
+        {0x813F3978F8940984ULL,    30,   28},
+        {0xC097CE7BC90715B3ULL,    56,   36},
+        {0x8F7E32CE7BEA5C70ULL,    83,   44},
+        {0xD5D238A4ABE98068ULL,   109,   52},
+        {0x9F4F2726179A2245ULL,   136,   60},
+        {0xED63A231D4C4FB27ULL,   162,   68},
+        {0xB0DE65388CC8ADA8ULL,   189,   76},
+        {0x83C7088E1AAB65DBULL,   216,   84},
+        {0xC45D1DF942711D9AULL,   242,   92},
+        {0x924D692CA61BE758ULL,   269,  100},
+        {0xDA01EE641A708DEAULL,   295,  108},
+        {0xA26DA3999AEF774AULL,   322,  116},
+        {0xF209787BB47D6B85ULL,   348,  124},
+        {0xB454E4A179DD1877ULL,   375,  132},
+        {0x865B86925B9BC5C2ULL,   402,  140},
+        {0xC83553C5C8965D3DULL,   428,  148},
+        {0x952AB45CFA97A0B3ULL,   455,  156},
+        {0xDE469FBD99A05FE3ULL,   481,  164},
+        {0xA59BC234DB398C25ULL,   508,  172},
+        {0xF6C69A72A3989F5CULL,   534,  180},
+        {0xB7DCBF5354E9BECEULL,   561,  188},
+        {0x88FCF317F22241E2ULL,   588,  196},
+        {0xCC20CE9BD35C78A5ULL,   614,  204},
+        {0x98165AF37B2153DFULL,   641,  212},
+        {0xE2A0B5DC971F303AULL,   667,  220},
+        {0xA8D9D1535CE3B396ULL,   694,  228},
+        {0xFB9B7CD9A4A7443CULL,   720,  236},
+        {0xBB764C4CA7A44410ULL,   747,  244},
+        {0x8BAB8EEFB6409C1AULL,   774,  252},
+        {0xD01FEF10A657842CULL,   800,  260},
+        {0x9B10A4E5E9913129ULL,   827,  268},
+        {0xE7109BFBA19C0C9DULL,   853,  276},
+        {0xAC2820D9623BF429ULL,   880,  284},
+        {0x80444B5E7AA7CF85ULL,   907,  292},
+        {0xBF21E44003ACDD2DULL,   933,  300},
+        {0x8E679C2F5E44FF8FULL,   960,  308},
+        {0xD433179D9C8CB841ULL,   986,  316},
+        {0x9E19DB92B4E31BA9ULL,  1013,  324},
+    };
+    const int min_k = -300;
+    const int step = 8;
+    const int f = -60 - e - 1;
+    const int k = (f * 78913) / (1 << 18) + ((0 < f) ? 1 : 0);   // ceil(f * log10(2))
+    return powers[(k - min_k + step - 1) / step];
+}
+
+inline int largest_pow10(uint32_t n, uint32_t& pow10)
+{
+    static const uint32_t powers[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+    };
+    int digits = 10;
+    while ((1 < digits) && (n < powers[digits - 1])) {
+        --digits;
+    }
+    pow10 = powers[digits - 1];
+    return digits;
+}
+
+/* Moves last digit down while result is still inside (M_minus, M_plus)
+ * and closer to w.
+ */
+inline void round_weed(char* buf, int len, uint64_t dist, uint64_t delta, uint64_t rest,
+                       uint64_t ten_k)
+{
+    while ((rest < dist) && (delta - rest >= ten_k)
+           && ((rest + ten_k < dist) || (dist - rest > rest + ten_k - dist))) {
+        --buf[len - 1];
+        rest += ten_k;
+    }
+}
+
+inline void digit_gen(char* buf, int& len, int& exponent, diyfp m_minus, diyfp w, diyfp m_plus)
+{
+    uint64_t delta = sub(m_plus, m_minus).f;
+    uint64_t dist = sub(m_plus, w).f;
+    const int shift = -m_plus.e;
+    const uint64_t one = 1ULL << shift;
+
+    uint32_t p1 = static_cast<uint32_t>(m_plus.f >> shift);
+    uint64_t p2 = m_plus.f & (one - 1);
+
+    uint32_t pow10;
+    int n = largest_pow10(p1, pow10);
+    while (0 < n) {
+        buf[len++] = static_cast<char>('0' + p1 / pow10);
+        p1 %= pow10;
+        --n;
+        const uint64_t rest = (static_cast<uint64_t>(p1) << shift) + p2;
+        if (rest <= delta) {
+            exponent += n;
+            round_weed(buf, len, dist, delta, rest, static_cast<uint64_t>(pow10) << shift);
+            return;
+        }
+        pow10 /= 10;
+    }
+
+    int m = 0;
+    for (;;) {
+        p2 *= 10;
+        buf[len++] = static_cast<char>('0' + (p2 >> shift));
+        p2 &= one - 1;
+        ++m;
+        delta *= 10;
+        dist *= 10;
+        if (p2 <= delta) {
+            break;
+        }
+    }
+    exponent -= m;
+    round_weed(buf, len, dist, delta, p2, one);
+}
+
+/* Digits of positive finite value: value = digits * 10^exponent.
+ */
+inline int grisu2(char* buf, int& exponent, double value)
+{
+    diyfp v(0, 0), m_minus(0, 0), m_plus(0, 0);
+    boundaries(value, v, m_minus, m_plus);
+    const cached_power c = cached_power_for(m_plus.e);
+    const diyfp c_k(c.f, c.e);
+    const diyfp w = mul(v, c_k);
+    const diyfp w_minus = mul(m_minus, c_k);
+    const diyfp w_plus = mul(m_plus, c_k);
+    // Products may be off by one ulp; the range is narrowed to stay inside.
+    int len = 0;
+    exponent = -c.k;
+    digit_gen(buf, len, exponent, diyfp(w_minus.f + 1, w_minus.e), w,
+              diyfp(w_plus.f - 1, w_plus.e));
+    return len;
+}
+
+inline char* write_uint(char* p, unsigned long long value)
+{
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (0 != value);
+    while (0 < n) {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+/* Writes finite value at p (up to 25 chars), returns end of text.
+ */
+inline char* to_chars(char* p, double value)
+{
+    if (value < 0 || ((0 == value) && (1.0 / value < 0))) {
+        *p++ = '-';
+        value = -value;
+    }
+    if ((value < 9007199254740992.0) && (static_cast<double>(static_cast<unsigned long long>(value)) == value)) {
+        return write_uint(p, static_cast<unsigned long long>(value));
+    }
+
+    char digits[18];
+    int exponent;
+    const int len = grisu2(digits, exponent, value);
+    const int point = len + exponent;   // Position of decimal point.
+    if ((len <= point) && (21 >= point)) {
+        memcpy(p, digits, static_cast<size_t>(len));
+        memset(p + len, '0', static_cast<size_t>(point - len));
+        return p + point;
+    }
+    if ((0 < point) && (21 >= point)) {
+        memcpy(p, digits, static_cast<size_t>(point));
+        p[point] = '.';
+        memcpy(p + point + 1, digits + point, static_cast<size_t>(len - point));
+        return p + len + 1;
+    }
+    if ((-6 < point) && (0 >= point)) {
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', static_cast<size_t>(-point));
+        p += -point;
+        memcpy(p, digits, static_cast<size_t>(len));
+        return p + len;
+    }
+    *p++ = digits[0];
+    if (1 < len) {
+        *p++ = '.';
+        memcpy(p, digits + 1, static_cast<size_t>(len - 1));
+        p += len - 1;
+    }
+    *p++ = 'e';
+    int e = point - 1;
+    if (0 > e) {
+        *p++ = '-';
+        e = -e;
+    }
+    else {
+        *p++ = '+';
+    }
+    return write_uint(p, static_cast<unsigned long long>(e));
+}
+
+}   // namespace mgjson_dtoa
+
+#endif // _MGJSON_DTOA_H_INCLUDED_
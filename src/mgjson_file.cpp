@@ -0,0 +1,244 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+#include "mgjson_file.h"
+
+#include <cstdio>
+#include <cerrno>
+#include <climits>
+
+#ifdef _WIN32
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#   include <io.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#   define MGJSON_HAS_MMAP
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+mgjson_mapped_file::mgjson_mapped_file(const char* path, bool sequential) :
+    is_open_(false),
+    data_(""),
+    size_(0),
+    file_(INVALID_HANDLE_VALUE),
+    mapping_(nullptr),
+    mapped_(false)
+{
+    file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        sequential ? (FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN)
+                                   : FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (INVALID_HANDLE_VALUE == file_) {
+        return;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)) {
+        return;
+    }
+    is_open_ = true;
+    if (0 == size.QuadPart) {
+        return;
+    }
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (nullptr == mapping_) {
+        is_open_ = false;
+        return;
+    }
+    const void* view = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (nullptr == view) {
+        is_open_ = false;
+        return;
+    }
+    data_ = static_cast<const char*>(view);
+    size_ = static_cast<size_t>(size.QuadPart);
+    mapped_ = true;
+}
+
+mgjson_mapped_file::~mgjson_mapped_file()
+{
+    if (mapped_) {
+        UnmapViewOfFile(data_);
+    }
+    if (nullptr != mapping_) {
+        CloseHandle(mapping_);
+    }
+    if (INVALID_HANDLE_VALUE != file_) {
+        CloseHandle(file_);
+    }
+}
+
+#elif defined(MGJSON_HAS_MMAP)
+
+mgjson_mapped_file::mgjson_mapped_file(const char* path, bool sequential) :
+    is_open_(false),
+    data_(""),
+    size_(0),
+    mapped_(false)
+{
+    int fd = open(path, O_RDONLY);
+    if (0 > fd) {
+        return;
+    }
+    struct stat st;
+    if ((0 != fstat(fd, &st)) || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return;
+    }
+    is_open_ = true;
+    if (0 < st.st_size) {
+        void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED == view) {
+            is_open_ = false;
+        }
+        else {
+            data_ = static_cast<const char*>(view);
+            size_ = static_cast<size_t>(st.st_size);
+            mapped_ = true;
+#   ifdef MADV_SEQUENTIAL
+            if (sequential) {
+                madvise(view, size_, MADV_SEQUENTIAL);
+            }
+#   endif
+#   ifdef MADV_HUGEPAGE
+            madvise(view, size_, MADV_HUGEPAGE);
+#   endif
+        }
+    }
+    close(fd);
+}
+
+mgjson_mapped_file::~mgjson_mapped_file()
+{
+    if (mapped_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+#else
+
+mgjson_mapped_file::mgjson_mapped_file(const char* path, bool sequential) :
+    is_open_(false),
+    data_(""),
+    size_(0),
+    mapped_(false)
+{
+    (void)sequential;
+    FILE* f = fopen(path, "rb");
+    if (nullptr == f) {
+        return;
+    }
+    if ((0 == fseek(f, 0, SEEK_END)) && (0 <= ftell(f))) {
+        size_t size = static_cast<size_t>(ftell(f));
+        char* buf = new char[size + 1];
+        fseek(f, 0, SEEK_SET);
+        if (fread(buf, 1, size, f) == size) {
+            data_ = buf;
+            size_ = size;
+            mapped_ = true;
+            is_open_ = true;
+        }
+        else {
+            delete[] buf;
+        }
+    }
+    fclose(f);
+}
+
+mgjson_mapped_file::~mgjson_mapped_file()
+{
+    if (mapped_) {
+        delete[] data_;
+    }
+}
+
+#endif
+
+namespace
+{
+
+/* Error of file as whole: FileError if it can't be opened, SizeLimitExceeded
+ * if offsets in it don't fit parse_result, NoError otherwise.
+ */
+mgjson::parse_result::parse_error file_error(const mgjson_mapped_file& file,
+                                             mgjson::parse_result* result)
+{
+    mgjson::parse_result::parse_error error = mgjson::parse_result::NoError;
+    if (!file.is_open()) {
+        error = mgjson::parse_result::FileError;
+    }
+    else if (static_cast<size_t>(INT_MAX) < file.size()) {
+        error = mgjson::parse_result::SizeLimitExceeded;
+    }
+    if (nullptr != result) {
+        result->error = error;
+        result->offset = 0;
+        result->row = 0;
+        result->col = 0;
+    }
+    return error;
+}
+
+} // namespace
+
+mgjson
+mgjson::from_json_file(const char *path, parse_result *result, unsigned threads,
+                       json_parse flags)
+{
+    mgjson_mapped_file file(path);
+    if (parse_result::NoError != file_error(file, result)) {
+        return mgjson(Undefined);
+    }
+    if (1 == threads) {
+        return from_json(file.data(), file.size(), result, flags);
+    }
+    return from_json_parallel(file.data(), file.size(), result, threads, flags);
+}
+
+void
+mgjson::from_json_lines_file(const char *path, const json_lines_callback& callback,
+                             parse_result *result, unsigned threads, json_parse flags)
+{
+    mgjson_mapped_file file(path);
+    if (parse_result::NoError == file_error(file, result)) {
+        from_json_lines(file.data(), file.size(), callback, threads, flags);
+    }
+}
+
+bool
+mgjson::to_json(FILE* file, json_format format) const
+{
+    return to_json([file](const char* data, size_t cb_data) {
+        return (fwrite(data, 1, cb_data, file) == cb_data);
+    }, format);
+}
+
+bool
+mgjson::to_json_fd(int fd, json_format format) const
+{
+    return to_json([fd](const char* data, size_t cb_data) {
+        while (0 != cb_data) {
+#ifdef _WIN32
+            int written = _write(fd, data, static_cast<unsigned>(cb_data));
+#else
+            ssize_t written = write(fd, data, cb_data);
+#endif
+            if (0 > written) {
+                if (EINTR == errno) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            cb_data -= static_cast<size_t>(written);
+        }
+        return true;
+    }, format);
+}
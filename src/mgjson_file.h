@@ -0,0 +1,37 @@
+#pragma once
+#ifndef _MGJSON_FILE_H_INCLUDED_
+#define _MGJSON_FILE_H_INCLUDED_
+
+#include <cstddef>
+
+/* Read-only view of whole file. File is memory mapped (with sequential
+ * access hints, unless sequential is false), so its content is never copied
+ * into heap; on platforms without mmap() it is read into buffer.
+ */
+class mgjson_mapped_file
+{
+public:
+    explicit mgjson_mapped_file(const char* path, bool sequential = true);
+    ~mgjson_mapped_file();
+
+private:
+    mgjson_mapped_file(const mgjson_mapped_file&) = delete;
+    mgjson_mapped_file& operator=(const mgjson_mapped_file&) = delete;
+
+public:
+    inline bool is_open() const { return is_open_; }
+    inline const char* data() const { return data_; }
+    inline size_t size() const { return size_; }
+
+private:
+    bool is_open_;
+    const char* data_;
+    size_t size_;
+#ifdef _WIN32
+    void* file_;
+    void* mapping_;
+#endif
+    bool mapped_;
+};
+
+#endif // _MGJSON_FILE_H_INCLUDED_
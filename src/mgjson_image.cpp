@@ -0,0 +1,505 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+#include "mgjson_private.h"
+#include "mgjson_image.h"
+#include "mgjson_binary.h"
+#include "mgjson_file.h"
+
+#include <string>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+
+typedef mgjson::parse_result parse_result;
+
+/* Items are written before their container (see mgjson_image), so tables
+ * are filled from refs_, what keeps references of items per level.
+ */
+class image_writer
+{
+public:
+    explicit image_writer(std::string& out) :
+        builder_(out),
+        depth_(0)
+    {
+    }
+
+    void write(const mgjson_private& root)
+    {
+        builder_.finish(write_value(root));
+    }
+
+private:
+    uint32_t write_value(const mgjson_private& node)
+    {
+        switch (node.type_) {
+        case mgjson::Null:
+            return mgjson_image::NullRef;
+        case mgjson::Bool:
+            return node.b_value_ ? mgjson_image::TrueRef : mgjson_image::FalseRef;
+        case mgjson::Integer:
+        case mgjson::Double:
+            if (node.raw_number_) {
+                return builder_.string((mgjson::Integer == node.type_) ? mgjson_image::TagRawInteger
+                                                                       : mgjson_image::TagRawDouble,
+                                       node.str_value_.data(), static_cast<size_t>(node.str_value_.size()));
+            }
+            return builder_.number(mgjson_binary::number(node));
+        case mgjson::String:
+            return builder_.string(mgjson_image::TagString, node.str_value_.data(),
+                                   static_cast<size_t>(node.str_value_.size()));
+        case mgjson::Array:
+        {
+            std::unique_ptr<mgjson_private> copy;
+            const mgjson_private& items = mgjson_image::items(node, copy);
+            enter();
+            for (const mgjson& value : items.array_) {
+                const uint32_t ref = write_value(*mgjson_private::get(value));
+                refs_[depth_ - 1].push_back(ref);
+            }
+            return leave(mgjson_image::TagArray, 4);
+        }
+        case mgjson::Object:
+        {
+            std::unique_ptr<mgjson_private> copy;
+            const mgjson_private& items = mgjson_image::items(node, copy);
+            enter();
+            for (const auto& field : items.map_) {
+                const uint32_t key = builder_.key(field.first.d, strlen(field.first.d));
+                const uint32_t ref = write_value(*mgjson_private::get(field.second));
+                refs_[depth_ - 1].push_back(key);
+                refs_[depth_ - 1].push_back(ref);
+            }
+            return leave(mgjson_image::TagObject, 8);
+        }
+        default:
+            return mgjson_image::UndefinedRef;
+        }
+    }
+
+    /* References of items of container being written are kept by level
+     * (refs_ grows while items are written, so it is indexed each time);
+     * vectors are reused.
+     */
+    void enter()
+    {
+        if (refs_.size() == depth_) {
+            refs_.emplace_back();
+        }
+        refs_[depth_++].clear();
+    }
+
+    uint32_t leave(mgjson_image::tag tag, size_t item_size)
+    {
+        const std::vector<uint32_t>& refs = refs_[--depth_];
+        uint32_t ref;
+        size_t item = builder_.container(tag, refs.size() * 4 / item_size, item_size, ref);
+        for (uint32_t item_ref : refs) {
+            builder_.set(item, item_ref);
+            item += 4;
+        }
+        return ref;
+    }
+
+private:
+    mgjson_image_builder builder_;
+    std::vector<std::vector<uint32_t>> refs_;
+    size_t depth_;
+};
+
+}   // namespace
+
+mgjson_image_builder::mgjson_image_builder(std::string& out) :
+    out_(out),
+    base_(out.size())
+{
+    out_.append(mgjson_image::header_size + mgjson_image::shared_size, '\0');
+    char* header = &out_[base_];
+    memcpy(header, "MGJI", 4);
+    mgjson_binary::store32(header + 4, mgjson_image::version);
+    mgjson_binary::store32(header + mgjson_image::NullRef, mgjson_image::TagNull);
+    mgjson_binary::store32(header + mgjson_image::FalseRef, mgjson_image::TagFalse);
+    mgjson_binary::store32(header + mgjson_image::TrueRef, mgjson_image::TagTrue);
+    mgjson_binary::store32(header + mgjson_image::UndefinedRef, mgjson_image::TagUndefined);
+}
+
+void
+mgjson_image_builder::finish(uint32_t root)
+{
+    char* header = &out_[base_];
+    mgjson_binary::store32(header + 8, static_cast<uint32_t>(out_.size() - base_));
+    mgjson_binary::store32(header + 12, root);
+}
+
+uint32_t
+mgjson_image_builder::number(const mgjson_binary::number& value)
+{
+    const size_t pos = reserve(12);
+    char* p = &out_[base_ + pos];
+    if (value.is_integer) {
+        mgjson_binary::store32(p, value.negative ? mgjson_image::TagNegative : mgjson_image::TagUnsigned);
+        mgjson_binary::store64(p + 4, value.negative ? (0ULL - value.magnitude) : value.magnitude);
+    }
+    else {
+        mgjson_binary::store32(p, mgjson_image::TagDouble);
+        mgjson_binary::store64(p + 4, mgjson_binary::double_bits(value.value));
+    }
+    return static_cast<uint32_t>(pos);
+}
+
+uint32_t
+mgjson_image_builder::string(mgjson_image::tag tag, const char* str, size_t size)
+{
+    const size_t pos = reserve(static_cast<uint64_t>(size) + 9);
+    char* p = &out_[base_ + pos];
+    mgjson_binary::store32(p, tag);
+    mgjson_binary::store32(p + 4, static_cast<uint32_t>(size));
+    memcpy(p + 8, str, size);
+    return static_cast<uint32_t>(pos);
+}
+
+uint32_t
+mgjson_image_builder::key(const char* key, size_t size)
+{
+    auto res = keys_.emplace(std::piecewise_construct, std::forward_as_tuple(key, size),
+                             std::forward_as_tuple(0));
+    if (res.second) {
+        res.first->second = string(mgjson_image::TagString, key, size);
+    }
+    return res.first->second;
+}
+
+size_t
+mgjson_image_builder::container(mgjson_image::tag tag, size_t count, size_t item_size, uint32_t& ref)
+{
+    const size_t pos = reserve(8 + static_cast<uint64_t>(count) * item_size);
+    mgjson_binary::store32(&out_[base_ + pos], tag);
+    mgjson_binary::store32(&out_[base_ + pos + 4], static_cast<uint32_t>(count));
+    ref = static_cast<uint32_t>(pos);
+    return pos + 8;
+}
+
+/* Zeroed space for record of size bytes at multiple of 4; returns its
+ * offset in image.
+ */
+size_t
+mgjson_image_builder::reserve(uint64_t size)
+{
+    const size_t pos = (out_.size() - base_ + 3) & ~static_cast<size_t>(3);
+    if (static_cast<uint64_t>(pos) + size > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("mgjson image can't be larger than 4 GiB.");
+    }
+    out_.resize(base_ + pos + static_cast<size_t>(size), '\0');
+    return pos;
+}
+
+const char*
+mgjson_image::record(uint32_t ref, uint64_t size) const
+{
+    if ((0 != (ref & 3)) || (size_ < size) || (size_ - size < ref)) {
+        return nullptr;
+    }
+    return data_ + ref;
+}
+
+const char*
+mgjson_image::table(const mgjson_private& node, size_t& count, size_t item_size) const
+{
+    count = 0;
+    const char* p = record(node.image_ref_, 8);
+    if (nullptr == p) {
+        return nullptr;
+    }
+    const uint32_t items = mgjson_binary::load32(p + 4);
+    if (nullptr == record(node.image_ref_, 8 + static_cast<uint64_t>(items) * item_size)) {
+        return nullptr;
+    }
+    count = items;
+    return p + 8;
+}
+
+const char*
+mgjson_image::string(uint32_t ref, size_t& size) const
+{
+    const char* p = record(ref, 8);
+    if (nullptr == p) {
+        return nullptr;
+    }
+    const uint32_t length = mgjson_binary::load32(p + 4);
+    if ((nullptr == record(ref, 9 + static_cast<uint64_t>(length))) || ('\0' != p[8 + length])) {
+        return nullptr;
+    }
+    size = length;
+    return p + 8;
+}
+
+mgjson
+mgjson_image::make(const std::shared_ptr<const mgjson_image>& image, uint32_t ref, uint32_t parent)
+{
+    const char* p = image->record(ref, 4);
+    if (nullptr == p) {
+        return mgjson(mgjson::Undefined);
+    }
+    const uint32_t tag = mgjson_binary::load32(p);
+    switch (tag) {
+    case TagNull:
+        return mgjson(mgjson::Null);
+    case TagFalse:
+        return mgjson(false);
+    case TagTrue:
+        return mgjson(true);
+    case TagUnsigned:
+    case TagNegative:
+    case TagDouble:
+    {
+        if (nullptr == image->record(ref, 12)) {
+            break;
+        }
+        const uint64_t value = mgjson_binary::load64(p + 4);
+        if (TagUnsigned == tag) {
+            return mgjson_private::make(new mgjson_private(static_cast<unsigned long long>(value)));
+        }
+        if (TagNegative == tag) {
+            return mgjson_private::make(new mgjson_private(static_cast<long long>(value)));
+        }
+        return mgjson_private::make(new mgjson_private(
+                    static_cast<long double>(mgjson_binary::double_from_bits(value))));
+    }
+    case TagString:
+    case TagRawInteger:
+    case TagRawDouble:
+    {
+        size_t size;
+        const char* str = image->string(ref, size);
+        if (nullptr == str) {
+            break;
+        }
+        if (TagString == tag) {
+            return mgjson_private::make(new mgjson_private(
+                        mgjson_private::string_type(str, static_cast<int>(size))));
+        }
+        mgjson_number::decimal value;
+        if ((mgjson_number::Ok != mgjson_number::scan(str, str + size, value)) || (str + size != value.end)) {
+            break;
+        }
+        return mgjson_private::make(new mgjson_private(value, true));
+    }
+    case TagArray:
+    case TagObject:
+    {
+        const mgjson::json_type type = (TagArray == tag) ? mgjson::Array : mgjson::Object;
+        if (ref >= parent) {
+            break;
+        }
+        const char* header = image->record(ref, 8);
+        if ((nullptr == header) || (0 == mgjson_binary::load32(header + 4))) {
+            return mgjson(type);
+        }
+        return mgjson_private::make(new mgjson_private(type, image, ref));
+    }
+    default:
+        break;
+    }
+    return mgjson(mgjson::Undefined);
+}
+
+mgjson
+mgjson_image::open(const std::shared_ptr<const mgjson_image>& image, parse_result* result)
+{
+    parse_result::parse_error error = parse_result::NoError;
+    size_t offset = 0;
+    const char* header = image->record(0, header_size + shared_size);
+    if (nullptr == header) {
+        error = parse_result::EndOfData;
+        offset = image->size_;
+    }
+    else if (0 != memcmp(header, "MGJI", 4)) {
+        error = parse_result::InvalidCharacter;
+    }
+    else if (version != mgjson_binary::load32(header + 4)) {
+        error = parse_result::InvalidCharacter;
+        offset = 4;
+    }
+    else {
+        offset = mgjson_binary::load32(header + 8);
+        if (image->size_ < offset) {
+            error = parse_result::EndOfData;
+            offset = image->size_;
+        }
+        else if (nullptr == image->record(mgjson_binary::load32(header + 12), 4)) {
+            error = parse_result::InvalidCharacter;
+            offset = 12;
+        }
+        else if (image->size_ > offset) {
+            error = parse_result::MoreData;
+        }
+    }
+
+    if (nullptr != result) {
+        result->error = error;
+        result->offset = static_cast<int>(offset);
+        result->row = 0;
+        result->col = 0;
+    }
+    if (0 > error) {
+        return mgjson(mgjson::Undefined);
+    }
+    return make(image, mgjson_binary::load32(header + 12), std::numeric_limits<uint32_t>::max());
+}
+
+size_t
+mgjson_image::count(const mgjson_private& node)
+{
+    size_t count;
+    node.image_->table(node, count, (mgjson::Array == node.type_) ? 4 : 8);
+    return count;
+}
+
+mgjson
+mgjson_image::at(const mgjson_private& node, size_t index)
+{
+    if (mgjson::Array != node.type_) {
+        return mgjson();
+    }
+    size_t count;
+    const char* table = node.image_->table(node, count, 4);
+    if (count <= index) {
+        return mgjson();
+    }
+    return make(node.image_, mgjson_binary::load32(table + 4 * index), node.image_ref_);
+}
+
+const char*
+mgjson_image::key(const mgjson_private& node, size_t index)
+{
+    size_t count;
+    const char* table = node.image_->table(node, count, 8);
+    if (count <= index) {
+        return "";
+    }
+    const uint32_t ref = mgjson_binary::load32(table + 8 * index);
+    size_t size;
+    const char* str = node.image_->string(ref, size);
+    return (nullptr == str) ? "" : str;
+}
+
+size_t
+mgjson_image::find(const mgjson_private& node, const char* key)
+{
+    const size_t count = mgjson_image::count(node);
+    size_t begin = 0;
+    size_t end = count;
+    while (begin < end) {
+        const size_t middle = begin + (end - begin) / 2;
+        const int cmp = strcmp(mgjson_image::key(node, middle), key);
+        if (0 == cmp) {
+            return middle;
+        }
+        if (0 > cmp) {
+            begin = middle + 1;
+        }
+        else {
+            end = middle;
+        }
+    }
+    return count;
+}
+
+mgjson
+mgjson_image::value(const mgjson_private& node, size_t index)
+{
+    size_t count;
+    const char* table = node.image_->table(node, count, 8);
+    if (count <= index) {
+        return mgjson();
+    }
+    return make(node.image_, mgjson_binary::load32(table + 8 * index + 4), node.image_ref_);
+}
+
+void
+mgjson_image::expand(mgjson_private& node)
+{
+    if (mgjson::Array == node.type_) {
+        size_t count;
+        const char* table = node.image_->table(node, count, 4);
+        node.array_.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            node.array_.push_back(make(node.image_, mgjson_binary::load32(table + 4 * i), node.image_ref_));
+        }
+        return;
+    }
+
+    // Fields are sorted already, so each one is put at the end of map.
+    size_t count;
+    const char* table = node.image_->table(node, count, 8);
+    for (size_t i = 0; i < count; ++i) {
+        node.map_.emplace_hint(node.map_.end(), std::piecewise_construct,
+                               std::forward_as_tuple(key(node, i)),
+                               std::forward_as_tuple(make(node.image_,
+                                                          mgjson_binary::load32(table + 8 * i + 4),
+                                                          node.image_ref_)));
+    }
+}
+
+const mgjson_private&
+mgjson_image::items(const mgjson_private& node, std::unique_ptr<mgjson_private>& copy)
+{
+    if (!node.in_image()) {
+        node.expand();
+        return node;
+    }
+    copy.reset(new mgjson_private(node.type_));
+    copy->image_ = node.image_;
+    copy->image_ref_ = node.image_ref_;
+    expand(*copy);
+    return *copy;
+}
+
+std::string
+mgjson::to_image() const
+{
+    std::string result;
+    image_writer(result).write(*d);
+    return result;
+}
+
+void
+mgjson::to_image(std::string& out) const
+{
+    image_writer(out).write(*d);
+}
+
+mgjson
+mgjson::from_image(const char *data, size_t cb_data, parse_result *result)
+{
+    if (nullptr == data) {
+        data = "";
+        cb_data = 0;
+    }
+    return mgjson_image::open(std::make_shared<const mgjson_image>(data, cb_data, nullptr), result);
+}
+
+mgjson
+mgjson::from_image_file(const char *path, parse_result *result)
+{
+    std::shared_ptr<mgjson_mapped_file> file = std::make_shared<mgjson_mapped_file>(path, false);
+    if (!file->is_open()) {
+        if (nullptr != result) {
+            result->error = parse_result::FileError;
+            result->offset = 0;
+            result->row = 0;
+            result->col = 0;
+        }
+        return mgjson(Undefined);
+    }
+    return mgjson_image::open(std::make_shared<const mgjson_image>(file->data(), file->size(), file),
+                              result);
+}
@@ -0,0 +1,153 @@
+#pragma once
+#ifndef _MGJSON_IMAGE_H_INCLUDED_
+#define _MGJSON_IMAGE_H_INCLUDED_
+
+#include "mgjson_private.h"
+#include "mgjson_binary.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/* Image of document (see mgjson::to_image()), what is read in place. All
+ * numbers are big-endian 32-bit words, records start at multiples of 4;
+ * references are offsets of records from start of image:
+ *
+ *   header:   "MGJI", version, size of image, reference to root;
+ *   scalars:  tag word (null, false, true and undefined are shared records
+ *             right after header), then 64-bit value for numbers;
+ *   strings:  tag word, length, bytes and zero byte (so is C string);
+ *             numbers kept as text (PreserveNumbers) are stored the same;
+ *   arrays:   tag word, count, references to elements;
+ *   objects:  tag word, count, pairs of references to name and value,
+ *             sorted by name (as map of node is), so field is found by
+ *             binary search. Names are strings, each one is stored once.
+ *
+ * Items are written before their containers, so arrays and objects are
+ * referenced only from records after them and image has no cycles; item
+ * what is container not before its parent is read as Undefined.
+ *
+ * Container nodes made from image keep reference to their record and are
+ * read from image (see mgjson_private::in_image()) until expanded; image
+ * data is kept alive by owner. Records are checked against size of image,
+ * so broken image gives Undefined values but is never read out of bounds.
+ */
+class mgjson_image
+{
+public:
+    enum tag {
+        TagNull         = 0,
+        TagFalse        = 1,
+        TagTrue         = 2,
+        TagUndefined    = 3,
+        TagUnsigned     = 4,
+        TagNegative     = 5,
+        TagDouble       = 6,
+        TagString       = 7,
+        TagRawInteger   = 8,
+        TagRawDouble    = 9,
+        TagArray        = 10,
+        TagObject       = 11,
+    };
+
+    /* Shared records of scalars without value.
+     */
+    enum {
+        NullRef         = 16,
+        FalseRef        = 20,
+        TrueRef         = 24,
+        UndefinedRef    = 28,
+    };
+
+    static const uint32_t version = 1;
+    static const size_t header_size = 16;
+    static const size_t shared_size = 16;
+
+    mgjson_image(const char* data, size_t size, const std::shared_ptr<const void>& owner) :
+        data_(data),
+        size_(size),
+        owner_(owner)
+    {
+    }
+
+    /* Root of image; header is checked here, records on access.
+     */
+    static mgjson open(const std::shared_ptr<const mgjson_image>& image, mgjson::parse_result* result);
+
+    /* Reading of container node what is in image.
+     */
+    static size_t count(const mgjson_private& node);
+    static mgjson at(const mgjson_private& node, size_t index);
+    static const char* key(const mgjson_private& node, size_t index);
+    static size_t find(const mgjson_private& node, const char* key);    // count() if not found.
+    static mgjson value(const mgjson_private& node, size_t index);
+
+    /* Fills array_ or map_ of node; see mgjson_private::_expand().
+     */
+    static void expand(mgjson_private& node);
+
+    /* Node to read items of container from in const traversal (writers):
+     * image node is not expanded, items of its record are made into copy
+     * (one level only, released by caller after the container is written);
+     * other nodes are expanded (raw JSON) and read themselves.
+     */
+    static const mgjson_private& items(const mgjson_private& node, std::unique_ptr<mgjson_private>& copy);
+
+private:
+    const char* record(uint32_t ref, uint64_t size) const;
+    const char* table(const mgjson_private& node, size_t& count, size_t item_size) const;
+    const char* string(uint32_t ref, size_t& size) const;
+    static mgjson make(const std::shared_ptr<const mgjson_image>& image, uint32_t ref, uint32_t parent);
+
+private:
+    const char* const data_;
+    const size_t size_;
+    const std::shared_ptr<const void> owner_;
+};
+
+/* Writes records of image to the end of out; to_image() and parser with
+ * BuildTape use it. Containers are written by container() and then their
+ * tables are filled by set(), so items can be written before or after
+ * them. Names are stored once.
+ */
+class mgjson_image_builder
+{
+public:
+    explicit mgjson_image_builder(std::string& out);
+
+    /* Completes header; root is reference to root value.
+     */
+    void finish(uint32_t root);
+
+    uint32_t number(const mgjson_binary::number& value);
+    uint32_t string(mgjson_image::tag tag, const char* str, size_t size);
+    uint32_t key(const char* key, size_t size);
+
+    /* Container record with table of count items of item_size bytes;
+     * returns offset of the first item.
+     */
+    size_t container(mgjson_image::tag tag, size_t count, size_t item_size, uint32_t& ref);
+
+    inline void set(size_t pos, uint32_t ref)
+    {
+        mgjson_binary::store32(&out_[base_ + pos], ref);
+    }
+
+    /* Text of string record.
+     */
+    inline const char* text(uint32_t ref) const
+    {
+        return out_.data() + base_ + ref + 8;
+    }
+
+private:
+    size_t reserve(uint64_t size);
+
+private:
+    std::string& out_;
+    const size_t base_;
+    std::unordered_map<std::string, uint32_t> keys_;
+};
+
+#endif // _MGJSON_IMAGE_H_INCLUDED_
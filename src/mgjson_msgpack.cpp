@@ -0,0 +1,469 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+#include "mgjson_private.h"
+#include "mgjson_image.h"
+#include "mgjson_binary.h"
+
+#include <string>
+#include <cstring>
+
+namespace
+{
+
+typedef mgjson::parse_result parse_result;
+
+/* Integers take the smallest form, doubles are always float 64; undefined
+ * fields are not written (and undefined elements are nil), as in
+ * to_json(). Output is appended to out; size_of() counts its exact size
+ * without writing.
+ */
+class msgpack_writer
+{
+public:
+    explicit msgpack_writer(std::string& out) :
+        out_(out)
+    {
+    }
+
+    static size_t size_of(const mgjson_private& node)
+    {
+        switch (node.type_) {
+        case mgjson::Integer:
+        case mgjson::Double:
+            return number_size(mgjson_binary::number(node));
+        case mgjson::String:
+            return string_size(static_cast<size_t>(node.str_value_.size()));
+        case mgjson::Array:
+        {
+            std::unique_ptr<mgjson_private> copy;
+            const mgjson_private& items = mgjson_image::items(node, copy);
+            size_t size = container_size(items.array_.size());
+            for (const mgjson& item : items.array_) {
+                size += size_of(*mgjson_private::get(item));
+            }
+            return size;
+        }
+        case mgjson::Object:
+        {
+            std::unique_ptr<mgjson_private> copy;
+            const mgjson_private& items = mgjson_image::items(node, copy);
+            size_t count = 0;
+            size_t size = 0;
+            for (const auto& item : items.map_) {
+                const mgjson_private& child = *mgjson_private::get(item.second);
+                if (mgjson::Undefined != child.type_) {
+                    ++count;
+                    size += string_size(strlen(item.first.d)) + size_of(child);
+                }
+            }
+            return container_size(count) + size;
+        }
+        default:
+            return 1;
+        }
+    }
+
+    void write(const mgjson_private& node)
+    {
+        switch (node.type_) {
+        case mgjson::Bool:
+            out_.push_back(node.b_value_ ? '\xC3' : '\xC2');
+            break;
+        case mgjson::Integer:
+        case mgjson::Double:
+            write_number(mgjson_binary::number(node));
+            break;
+        case mgjson::String:
+#ifdef QT_CORE_LIB
+            write_string(node.str_value_.constData(), static_cast<size_t>(node.str_value_.size()));
+#else
+            write_string(node.str_value_.data(), node.str_value_.size());
+#endif
+            break;
+        case mgjson::Array:
+        {
+            std::unique_ptr<mgjson_private> copy;
+            const mgjson_private& items = mgjson_image::items(node, copy);
+            write_header(items.array_.size(), '\x90', '\xDC');
+            for (const mgjson& item : items.array_) {
+                write(*mgjson_private::get(item));
+            }
+            break;
+        }
+        case mgjson::Object:
+        {
+            std::unique_ptr<mgjson_private> copy;
+            const mgjson_private& items = mgjson_image::items(node, copy);
+            size_t count = 0;
+            for (const auto& item : items.map_) {
+                count += (mgjson::Undefined != mgjson_private::get(item.second)->type_) ? 1 : 0;
+            }
+            write_header(count, '\x80', '\xDE');
+            for (const auto& item : items.map_) {
+                const mgjson_private& child = *mgjson_private::get(item.second);
+                if (mgjson::Undefined != child.type_) {
+                    write_string(item.first.d, strlen(item.first.d));
+                    write(child);
+                }
+            }
+            break;
+        }
+        default:
+            out_.push_back('\xC0');
+            break;
+        }
+    }
+
+private:
+    static size_t number_size(const mgjson_binary::number& n)
+    {
+        if (!n.is_integer) {
+            return 9;
+        }
+        const unsigned long long m = n.magnitude;
+        if (n.negative) {
+            return (32 >= m) ? 1 : (128 >= m) ? 2 : (32768 >= m) ? 3 : (2147483648ULL >= m) ? 5 : 9;
+        }
+        return (128 > m) ? 1 : (256 > m) ? 2 : (65536 > m) ? 3 : (4294967296ULL > m) ? 5 : 9;
+    }
+
+    static inline size_t string_size(size_t size)
+    {
+        return size + ((32 > size) ? 1 : (256 > size) ? 2 : (65536 > size) ? 3 : 5);
+    }
+
+    static inline size_t container_size(size_t count)
+    {
+        return (16 > count) ? 1 : (65536 > count) ? 3 : 5;
+    }
+
+    void write_number(const mgjson_binary::number& n)
+    {
+        if (!n.is_integer) {
+            mgjson_binary::put(out_, '\xCB', mgjson_binary::double_bits(n.value), 8);
+            return;
+        }
+        const unsigned long long m = n.magnitude;
+        if (n.negative) {
+            const uint64_t v = static_cast<uint64_t>(0ULL - m);
+            if (32 >= m) {
+                out_.push_back(static_cast<char>(v));
+            }
+            else if (128 >= m) {
+                mgjson_binary::put(out_, '\xD0', v, 1);
+            }
+            else if (32768 >= m) {
+                mgjson_binary::put(out_, '\xD1', v, 2);
+            }
+            else if (2147483648ULL >= m) {
+                mgjson_binary::put(out_, '\xD2', v, 4);
+            }
+            else {
+                mgjson_binary::put(out_, '\xD3', v, 8);
+            }
+        }
+        else if (128 > m) {
+            out_.push_back(static_cast<char>(m));
+        }
+        else if (256 > m) {
+            mgjson_binary::put(out_, '\xCC', m, 1);
+        }
+        else if (65536 > m) {
+            mgjson_binary::put(out_, '\xCD', m, 2);
+        }
+        else if (4294967296ULL > m) {
+            mgjson_binary::put(out_, '\xCE', m, 4);
+        }
+        else {
+            mgjson_binary::put(out_, '\xCF', m, 8);
+        }
+    }
+
+    void write_string(const char* str, size_t size)
+    {
+        if (32 > size) {
+            out_.push_back(static_cast<char>(0xA0 | size));
+        }
+        else if (256 > size) {
+            mgjson_binary::put(out_, '\xD9', size, 1);
+        }
+        else if (65536 > size) {
+            mgjson_binary::put(out_, '\xDA', size, 2);
+        }
+        else {
+            mgjson_binary::put(out_, '\xDB', size, 4);
+        }
+        out_.append(str, size);
+    }
+
+    /* Header of array or map: fix form, 16 or 32 bit count.
+     */
+    void write_header(size_t count, char fix, char code16)
+    {
+        if (16 > count) {
+            out_.push_back(static_cast<char>(fix | static_cast<char>(count)));
+        }
+        else if (65536 > count) {
+            mgjson_binary::put(out_, code16, count, 2);
+        }
+        else {
+            mgjson_binary::put(out_, static_cast<char>(code16 + 1), count, 4);
+        }
+    }
+
+private:
+    std::string& out_;
+};
+
+/* Nodes are built straight from input. Strings and binaries both become
+ * String values; map keys have to be strings. Extension types are not
+ * supported and are reported as InvalidCharacter.
+ */
+class msgpack_decoder : public mgjson_binary::decoder
+{
+public:
+    msgpack_decoder(const char* data, size_t cb_data, const mgjson::parse_options& options) :
+        decoder(data, cb_data, options)
+    {
+    }
+
+    mgjson parse(parse_result* result)
+    {
+        return parse_document(result, [this](mgjson& value) {
+            return parse_value(value);
+        });
+    }
+
+private:
+    bool parse_value(mgjson& value)
+    {
+        if (!need(1)) {
+            return false;
+        }
+        const char* pos = p_;
+        const unsigned char code = static_cast<unsigned char>(*p_++);
+        if (0x80 > code) {
+            value = make_integer(false, code);
+            return true;
+        }
+        if (0xE0 <= code) {
+            value = make_integer(true, 0x100 - code);
+            return true;
+        }
+        switch (code & 0xF0) {
+        case 0x80:
+            return parse_map(value, code & 0x0F);
+        case 0x90:
+            return parse_array(value, code & 0x0F);
+        case 0xA0:
+        case 0xB0:
+            return parse_string(value, code & 0x1F, pos);
+        default:
+            break;
+        }
+
+        switch (code) {
+        case 0xC0:
+            value = mgjson_private::make(new mgjson_private(mgjson::Null));
+            return true;
+        case 0xC2:
+        case 0xC3:
+            value = mgjson_private::make(new mgjson_private(0xC3 == code));
+            return true;
+        case 0xC4:
+        case 0xD9:
+            return need(1) && parse_string(value, static_cast<unsigned char>(*p_++), pos);
+        case 0xC5:
+        case 0xDA:
+            return need(2) && parse_string(value, load16(), pos);
+        case 0xC6:
+        case 0xDB:
+            return need(4) && parse_string(value, load32(), pos);
+        case 0xCA:
+            if (!need(4)) {
+                return false;
+            }
+            value = make_double(mgjson_binary::float_from_bits(load32()));
+            return true;
+        case 0xCB:
+            if (!need(8)) {
+                return false;
+            }
+            value = make_double(mgjson_binary::double_from_bits(load64()));
+            return true;
+        case 0xCC:
+            return need(1) && make_unsigned(value, static_cast<unsigned char>(*p_++));
+        case 0xCD:
+            return need(2) && make_unsigned(value, load16());
+        case 0xCE:
+            return need(4) && make_unsigned(value, load32());
+        case 0xCF:
+            return need(8) && make_unsigned(value, load64());
+        case 0xD0:
+            return need(1) && make_signed(value, static_cast<signed char>(*p_++));
+        case 0xD1:
+            return need(2) && make_signed(value, static_cast<int16_t>(load16()));
+        case 0xD2:
+            return need(4) && make_signed(value, static_cast<int32_t>(load32()));
+        case 0xD3:
+            return need(8) && make_signed(value, static_cast<int64_t>(load64()));
+        case 0xDC:
+            return need(2) && parse_array(value, load16());
+        case 0xDD:
+            return need(4) && parse_array(value, load32());
+        case 0xDE:
+            return need(2) && parse_map(value, load16());
+        case 0xDF:
+            return need(4) && parse_map(value, load32());
+        default:
+            return fail(parse_result::InvalidCharacter, pos);
+        }
+    }
+
+    inline uint16_t load16()
+    {
+        p_ += 2;
+        return mgjson_binary::load16(p_ - 2);
+    }
+
+    inline uint32_t load32()
+    {
+        p_ += 4;
+        return mgjson_binary::load32(p_ - 4);
+    }
+
+    inline uint64_t load64()
+    {
+        p_ += 8;
+        return mgjson_binary::load64(p_ - 8);
+    }
+
+    static inline bool make_unsigned(mgjson& value, uint64_t number)
+    {
+        value = make_integer(false, number);
+        return true;
+    }
+
+    static inline bool make_signed(mgjson& value, int64_t number)
+    {
+        value = (0 > number)
+                ? make_integer(true, 0ULL - static_cast<uint64_t>(number))
+                : make_integer(false, static_cast<uint64_t>(number));
+        return true;
+    }
+
+    bool parse_string(mgjson& value, uint32_t size, const char* pos)
+    {
+        if (!check_string(size, pos)) {
+            return false;
+        }
+        take_string(value, size);
+        return true;
+    }
+
+    /* Every element takes at least one byte, so count is checked against
+     * size of data before anything is allocated.
+     */
+    bool parse_array(mgjson& value, uint32_t count)
+    {
+        if (!need(count) || !enter()) {
+            return false;
+        }
+        mgjson_private* data = new mgjson_private(mgjson::Array);
+        value = mgjson_private::make(data);
+        data->array_.assign(count, mgjson_private::make(nullptr));
+        for (mgjson& item : data->array_) {
+            if (!parse_value(item)) {
+                return false;
+            }
+        }
+        leave();
+        return true;
+    }
+
+    bool parse_map(mgjson& value, uint32_t count)
+    {
+        if (!need(2 * static_cast<uint64_t>(count)) || !enter()) {
+            return false;
+        }
+        mgjson_private* data = new mgjson_private(mgjson::Object);
+        value = mgjson_private::make(data);
+        std::vector<const mgjson_private*> collected;   // See add_field().
+        for (uint32_t i = 0; i < count; ++i) {
+            const char* key_pos = p_;
+            if (!parse_key()) {
+                return false;
+            }
+            mgjson_private::Key key(key_.c_str());
+            mgjson item(mgjson_private::make(nullptr));
+            if (!parse_value(item) || !add_field(data, std::move(key), item, key_pos, collected)) {
+                return false;
+            }
+        }
+        leave();
+        return true;
+    }
+
+    bool parse_key()
+    {
+        if (!need(1)) {
+            return false;
+        }
+        const char* pos = p_;
+        const unsigned char code = static_cast<unsigned char>(*p_++);
+        if (0xA0 == (code & 0xE0)) {
+            return take_key(code & 0x1F, pos);
+        }
+        switch (code) {
+        case 0xC4:
+        case 0xD9:
+            return need(1) && take_key(static_cast<unsigned char>(*p_++), pos);
+        case 0xC5:
+        case 0xDA:
+            return need(2) && take_key(load16(), pos);
+        case 0xC6:
+        case 0xDB:
+            return need(4) && take_key(load32(), pos);
+        default:
+            return fail(parse_result::InvalidName, pos);
+        }
+    }
+};
+
+}   // namespace
+
+size_t
+mgjson::msgpack_size() const
+{
+    return msgpack_writer::size_of(*d);
+}
+
+std::string
+mgjson::msgpack() const
+{
+    std::string result;
+    msgpack_writer(result).write(*d);
+    return result;
+}
+
+void
+mgjson::msgpack(std::string& out) const
+{
+    msgpack_writer(out).write(*d);
+}
+
+mgjson
+mgjson::msgunpack(const char *data, size_t cb_data, parse_result *result)
+{
+    return msgpack_decoder(data, cb_data, parse_options()).parse(result);
+}
+
+mgjson
+mgjson::msgunpack(const char *data, size_t cb_data, const parse_options& options,
+                  parse_result *result)
+{
+    return msgpack_decoder(data, cb_data, options).parse(result);
+}
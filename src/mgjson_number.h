@@ -0,0 +1,319 @@
+#pragma once
+#ifndef _MGJSON_NUMBER_H_INCLUDED_
+#define _MGJSON_NUMBER_H_INCLUDED_
+
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <clocale>
+#include <limits>
+
+#ifdef _MSC_VER
+#   include <locale.h>
+#elif defined(__APPLE__)
+#   include <xlocale.h>
+#endif
+
+/* Number parsing engine used by both JSON parser and autocasting of string values.
+ *
+ * Digits are loaded eight at a time (SWAR), integers up to unsigned long long
+ * range are produced exactly and floating point values are converted with exact
+ * Clinger's fast path when the decimal mantissa and the power of ten are both
+ * exactly representable in long double. Rest (rare) cases are handled by
+ * strtold() using "C" locale, so result never depends on current locale.
+ */
+namespace mgjson_number
+{
+
+struct decimal
+{
+    const char* begin;              // Start of lexeme (including sign).
+    const char* end;                // End of lexeme.
+    unsigned long long mantissa;    // First 19 significant digits.
+    int exponent;                   // Decimal exponent to apply to mantissa.
+    int int_digits;                 // Digits in integer part.
+    bool negative;
+    bool is_integer;                // Neither fraction nor exponent present.
+    bool truncated;                 // Mantissa holds not all significant digits.
+};
+
+enum scan_result {
+    Ok              = 0,
+    DigitExpected   = 1,    // Sign, dot or exponent without digits after it.
+    LeadingZero     = 2,    // Integer part has leading zero(s).
+};
+
+static const int max_mantissa_digits = 19;
+
+inline bool is_digit(char c)
+{
+    return (static_cast<unsigned char>(c - '0') < 10);
+}
+
+inline uint64_t load_eight(const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+inline bool is_eight_digits(uint64_t v)
+{
+    return (((v & 0xF0F0F0F0F0F0F0F0ULL)
+             | (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4))
+            == 0x3333333333333333ULL);
+}
+
+inline uint32_t parse_eight_digits(uint64_t v)
+{
+    const uint64_t mask = 0x000000FF000000FFULL;
+    const uint64_t mul1 = 0x000F424000000064ULL;   // 100 + (1000000 << 32)
+    const uint64_t mul2 = 0x0000271000000001ULL;   // 1 + (10000 << 32)
+    v -= 0x3030303030303030ULL;
+    v = (v * 10) + (v >> 8);
+    v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+    return static_cast<uint32_t>(v);
+}
+
+/* Reads run of digits starting at p, accumulating into value (with wrapping).
+ * Returns pointer to first non-digit character.
+ */
+inline const char* read_digits(const char* p, const char* end, unsigned long long& value)
+{
+    while (((end - p) >= 8) && is_eight_digits(load_eight(p))) {
+        value = (value * 100000000ULL) + parse_eight_digits(load_eight(p));
+        p += 8;
+    }
+    while ((p < end) && is_digit(*p)) {
+        value = (value * 10) + static_cast<unsigned>(*p - '0');
+        ++p;
+    }
+    return p;
+}
+
+/* Scans number lexeme by JSON grammar: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+ * When allow_leading_dot is set, integer part may be omitted (".5", "-.5").
+ * On success, d.end points right after the lexeme.
+ */
+inline scan_result scan(const char* p, const char* end, decimal& d, bool allow_leading_dot = false)
+{
+    d.begin = p;
+    d.mantissa = 0;
+    d.exponent = 0;
+    d.negative = false;
+    d.is_integer = true;
+    d.truncated = false;
+
+    if ((p < end) && ('-' == *p)) {
+        d.negative = true;
+        ++p;
+    }
+
+    const char* int_begin = p;
+    unsigned long long value = 0;
+    p = read_digits(p, end, value);
+    d.int_digits = static_cast<int>(p - int_begin);
+    if (0 == d.int_digits) {
+        if (!allow_leading_dot || (p >= end) || ('.' != *p)) {
+            d.end = p;
+            return DigitExpected;
+        }
+    }
+    else if (('0' == *int_begin) && (1 < d.int_digits)) {
+        d.end = int_begin + 1;
+        return LeadingZero;
+    }
+
+    const char* frac_begin = p;
+    const char* frac_end = p;
+    if ((p < end) && ('.' == *p)) {
+        d.is_integer = false;
+        frac_begin = ++p;
+        p = read_digits(p, end, value);
+        frac_end = p;
+        if (frac_begin == frac_end) {
+            d.end = p;
+            return DigitExpected;
+        }
+    }
+
+    int digits = d.int_digits + static_cast<int>(frac_end - frac_begin);
+    long long exponent = -static_cast<long long>(frac_end - frac_begin);
+
+    if ((p < end) && (('e' == *p) || ('E' == *p))) {
+        d.is_integer = false;
+        ++p;
+        bool exp_negative = false;
+        if ((p < end) && (('-' == *p) || ('+' == *p))) {
+            exp_negative = ('-' == *p);
+            ++p;
+        }
+        if ((p >= end) || !is_digit(*p)) {
+            d.end = p;
+            return DigitExpected;
+        }
+        long long exp_value = 0;
+        for (; (p < end) && is_digit(*p); ++p) {
+            if (exp_value < 0x10000000) {
+                exp_value = (exp_value * 10) + (*p - '0');
+            }
+        }
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+    d.end = p;
+
+    if (max_mantissa_digits < digits) {
+        // Leading zeros ("0.000123") are not significant and don't affect mantissa.
+        for (const char* s = int_begin; (s < frac_end) && (('0' == *s) || ('.' == *s)); ++s) {
+            if ('0' == *s) {
+                --digits;
+            }
+        }
+        d.truncated = (max_mantissa_digits < digits);
+    }
+
+    if (exponent < -0x10000000) {
+        exponent = -0x10000000;
+    }
+    else if (exponent > 0x10000000) {
+        exponent = 0x10000000;
+    }
+    d.mantissa = value;
+    d.exponent = static_cast<int>(exponent);
+    return Ok;
+}
+
+/* Returns integer part of decimal if it's integer and fits into unsigned long long
+ * (negative values are stored in two's complement form, same as strtoull() does).
+ */
+inline bool to_integer(const decimal& d, unsigned long long& result)
+{
+    if (!d.is_integer || (20 < d.int_digits)) {
+        return false;
+    }
+    unsigned long long value = d.mantissa;
+    if (20 == d.int_digits) {
+        // Mantissa is wrapped, so recalculate with overflow check.
+        const char* p = d.begin + (d.negative ? 1 : 0);
+        value = 0;
+        for (int i = 0; i < 19; ++i) {
+            value = (value * 10) + static_cast<unsigned>(p[i] - '0');
+        }
+        const unsigned long long max = std::numeric_limits<unsigned long long>::max();
+        unsigned last = static_cast<unsigned>(p[19] - '0');
+        if ((value > (max / 10)) || ((value * 10) > (max - last))) {
+            return false;
+        }
+        value = (value * 10) + last;
+    }
+    result = d.negative ? (0ULL - value) : value;
+    return true;
+}
+
+inline long double exact_pow10(int e)
+{
+    static const long double table[] = {
+        1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L,
+        1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L,
+        1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L, 1e28L, 1e29L,
+        1e30L, 1e31L, 1e32L, 1e33L, 1e34L, 1e35L, 1e36L, 1e37L, 1e38L, 1e39L,
+        1e40L, 1e41L, 1e42L, 1e43L, 1e44L, 1e45L, 1e46L, 1e47L, 1e48L,
+    };
+    return table[e];
+}
+
+/* Largest e for which 10^e = 2^e * 5^e is exactly representable in long double,
+ * i.e. 5^e fits in its mantissa.
+ */
+inline constexpr int max_exact_pow10()
+{
+    return (64 == std::numeric_limits<long double>::digits) ? 27
+         : (113 == std::numeric_limits<long double>::digits) ? 48
+         : (53 == std::numeric_limits<long double>::digits) ? 22
+         : 0;
+}
+
+inline constexpr unsigned long long max_exact_mantissa()
+{
+    return (std::numeric_limits<long double>::digits >= 64)
+            ? std::numeric_limits<unsigned long long>::max()
+            : (1ULL << (std::numeric_limits<long double>::digits & 63));
+}
+
+#ifdef _MSC_VER
+typedef _locale_t c_locale_t;
+#elif defined(__GLIBC__) || defined(__APPLE__)
+typedef locale_t c_locale_t;
+#endif
+
+inline long double strtold_c(const char* str, char** endptr)
+{
+#ifdef _MSC_VER
+    static const c_locale_t c_locale = _create_locale(LC_NUMERIC, "C");
+    return _strtold_l(str, endptr, c_locale);
+#elif defined(__GLIBC__) || defined(__APPLE__)
+    static const c_locale_t c_locale = newlocale(LC_NUMERIC_MASK, "C", nullptr);
+    return strtold_l(str, endptr, c_locale);
+#else
+    return strtold(str, endptr);
+#endif
+}
+
+/* Converts scanned decimal to long double with correct rounding.
+ */
+inline long double to_long_double(const decimal& d)
+{
+    if (!d.truncated && (d.mantissa <= max_exact_mantissa())) {
+        long double value = static_cast<long double>(d.mantissa);
+        const int max_pow = max_exact_pow10();
+        bool done = false;
+        if ((0 == d.mantissa) || (0 == d.exponent)) {
+            done = true;
+        }
+        else if ((0 > d.exponent) && (-max_pow <= d.exponent)) {
+            value /= exact_pow10(-d.exponent);
+            done = true;
+        }
+        else if ((0 < d.exponent) && (max_pow >= d.exponent)) {
+            value *= exact_pow10(d.exponent);
+            done = true;
+        }
+        else if ((0 < d.exponent) && ((max_pow + max_mantissa_digits) >= d.exponent)) {
+            // "Disguised" fast path: small mantissa may absorb extra powers exactly.
+            unsigned long long m = d.mantissa;
+            int e = d.exponent;
+            while ((max_pow < e) && (m <= (max_exact_mantissa() / 10))) {
+                m *= 10;
+                --e;
+            }
+            if (max_pow >= e) {
+                value = static_cast<long double>(m) * exact_pow10(e);
+                done = true;
+            }
+        }
+        if (done) {
+            return d.negative ? -value : value;
+        }
+    }
+
+    char buf[128];
+    size_t len = static_cast<size_t>(d.end - d.begin);
+    if (len < sizeof(buf)) {
+        memcpy(buf, d.begin, len);
+        buf[len] = 0;
+        return strtold_c(buf, nullptr);
+    }
+    char* heap_buf = new char[len + 1];
+    memcpy(heap_buf, d.begin, len);
+    heap_buf[len] = 0;
+    long double value = strtold_c(heap_buf, nullptr);
+    delete[] heap_buf;
+    return value;
+}
+
+}   // namespace mgjson_number
+
+#endif // _MGJSON_NUMBER_H_INCLUDED_
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef _MGJSON_PARALLEL_H_INCLUDED_
+#define _MGJSON_PARALLEL_H_INCLUDED_
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace mgjson_parallel
+{
+
+inline unsigned threads_count(unsigned requested)
+{
+    if (0 != requested) {
+        return requested;
+    }
+    unsigned hw = std::thread::hardware_concurrency();
+    return (0 == hw) ? 1 : hw;
+}
+
+/* Calls fn(begin, end) for consecutive ranges of [0, count) of at most
+ * grain items each. Ranges are taken by workers from shared counter, so
+ * uneven ranges are balanced automatically. Calling thread is one of the
+ * workers; all work is done when function returns.
+ */
+template <typename F>
+void for_each_range(size_t count, size_t grain, unsigned threads, F fn)
+{
+    if (0 == grain) {
+        grain = 1;
+    }
+    size_t ranges = (count + grain - 1) / grain;
+    threads = static_cast<unsigned>(std::min<size_t>(threads_count(threads), ranges));
+    if (1 >= threads) {
+        if (0 != count) {
+            fn(static_cast<size_t>(0), count);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (;;) {
+            size_t begin = next.fetch_add(grain);
+            if (begin >= count) {
+                return;
+            }
+            fn(begin, std::min(begin + grain, count));
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : pool) {
+        t.join();
+    }
+}
+
+}   // namespace mgjson_parallel
+
+#endif // _MGJSON_PARALLEL_H_INCLUDED_
@@ -0,0 +1,1798 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+#include "mgjson_private.h"
+#include "mgjson_simd.h"
+#include "mgjson_parallel.h"
+#include "mgjson_utf8.h"
+#include "mgjson_projection.h"
+#include "mgjson_image.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <limits>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <cassert>
+
+/* Scratch buffers of parser. Kept by mgjson_parser between documents, so
+ * after few documents parsing needs no allocations except for nodes.
+ */
+struct mgjson_parser_buffers
+{
+    mgjson_private::string_type name;           // Name of object field.
+    mgjson_private::string_type text;           // String value.
+    std::vector<std::vector<mgjson>> items;     // Array elements, per nesting level.
+
+    // The same for BuildTape: references to records of elements and fields.
+    struct tape_field
+    {
+        uint32_t key;
+        uint32_t value;
+    };
+    std::vector<std::vector<uint32_t>> tape_items;
+    std::vector<std::vector<tape_field>> tape_fields;
+
+    inline void clear_items()
+    {
+        for (std::vector<mgjson>& level : items) {
+            level.clear();
+        }
+    }
+};
+
+namespace
+{
+
+typedef mgjson::parse_result parse_result;
+
+/* Fills offset, row and column of pos. Parser tracks only pointers, so rows
+ * are counted here, by newlines before pos, 64 bytes at a time.
+ */
+void set_position(parse_result& result, const char* begin, const char* pos)
+{
+    int row = 1;
+    const char* line_start = begin;
+    const char* p = begin;
+    for (; static_cast<size_t>(pos - p) >= mgjson_simd::block_size; p += mgjson_simd::block_size) {
+        uint64_t mask = mgjson_simd::eq_mask(p, '\n');
+        if (0 != mask) {
+            row += static_cast<int>(mgjson_simd::count_ones(mask));
+            line_start = p + (64 - mgjson_simd::count_leading_zeros(mask));
+        }
+    }
+    for (; pos != p; ++p) {
+        if ('\n' == *p) {
+            ++row;
+            line_start = p + 1;
+        }
+    }
+    result.offset = static_cast<int>(pos - begin);
+    result.row = row;
+    result.col = static_cast<int>(pos - line_start) + 1;
+}
+
+/* Position of parsed document: only offset of its end, see
+ * parse_result::compute_position().
+ */
+inline void set_end(parse_result& result, const char* begin, const char* end)
+{
+    result.offset = static_cast<int>(end - begin);
+    result.row = 0;
+    result.col = 0;
+}
+
+/* Returns pointer past bracket closing the one at open, or nullptr if
+ * data ends before. Brackets inside strings are masked out 64 bytes at a
+ * time, the same way as in array_scanner; kinds of brackets aren't matched.
+ */
+const char* find_closing_bracket(const char* open, const char* end)
+{
+    mgjson_simd::escape_scanner escapes;
+    uint64_t in_string = 0;
+    size_t depth = 0;
+    char tail[mgjson_simd::block_size];
+    for (const char* p = open; end != p; p += mgjson_simd::block_size) {
+        size_t avail = static_cast<size_t>(end - p);
+        const char* data = p;
+        if (mgjson_simd::block_size > avail) {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, p, avail);
+            data = tail;
+        }
+        mgjson_simd::block b(data);
+        uint64_t quotes = b.eq('"') & ~escapes.next(b.eq('\\'));
+        uint64_t strings = mgjson_simd::prefix_xor(quotes) ^ in_string;
+        in_string = (0 != (strings >> 63)) ? ~0ULL : 0;
+
+        uint64_t opens = (b.eq('[') | b.eq('{')) & ~strings;
+        uint64_t closes = (b.eq(']') | b.eq('}')) & ~strings;
+        if (0 == closes) {
+            depth += mgjson_simd::count_ones(opens);
+        }
+        else {
+            for (uint64_t all = opens | closes; 0 != all; all = mgjson_simd::clear_lowest_bit(all)) {
+                unsigned i = mgjson_simd::count_trailing_zeros(all);
+                if (0 != ((opens >> i) & 1)) {
+                    ++depth;
+                }
+                else if (0 == --depth) {
+                    return p + i + 1;
+                }
+            }
+        }
+        if (mgjson_simd::block_size >= avail) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+class json_parser
+{
+public:
+    json_parser(const char *data, size_t cb_data, const mgjson::parse_options& options,
+                mgjson_parser_buffers* buffers = nullptr) :
+        begin_(data),
+        end_(data + cb_data),
+        p_(data),
+        error_(parse_result::NoError),
+        error_pos_(data),
+        options_(options),
+        validate_utf8_(validate_utf8(options.flags)),
+        preserve_numbers_(0 != (options.flags & mgjson::PreserveNumbers)),
+        join_strings_(0 != (options.flags & mgjson::JoinStrings)),
+        depth_(0),
+        buffers_((nullptr == buffers) ? &local_buffers_ : buffers),
+        name_(buffers_->name),
+        tape_(nullptr)
+    {
+    }
+
+    json_parser(const char *data, size_t cb_data, mgjson::json_parse flags,
+                mgjson_parser_buffers* buffers = nullptr) :
+        json_parser(data, cb_data, options_with(flags), buffers)
+    {
+    }
+
+public:
+    mgjson parse(parse_result *result)
+    {
+        if (0 != (options_.flags & mgjson::BuildTape)) {
+            return parse_tape(result);
+        }
+        return parse_document(result, [this](mgjson& value) {
+            return parse_value(value);
+        });
+    }
+
+    /* Same as parse(), but only values selected by projection are built.
+     */
+    mgjson parse(parse_result *result, const mgjson_projection& projection)
+    {
+        return parse_document(result, [&](mgjson& value) {
+            return parse_selected(value, projection.root());
+        });
+    }
+
+    /* Elements of top-level array are first parsed with projection; only
+     * those accepted by predicate are parsed again in full. Other documents
+     * are parsed as by parse().
+     */
+    mgjson parse(parse_result *result, const mgjson_projection& projection,
+                 const mgjson::record_predicate& predicate)
+    {
+        return parse_document(result, [&](mgjson& value) {
+            if ('[' != *p_) {
+                return parse_value(value);
+            }
+            return parse_filtered_array(value, projection.root(), predicate);
+        });
+    }
+
+    /* Checks document without building it; value_begin and value_end get
+     * bounds of value without surrounding spaces. Unlike parse(), data after
+     * value is an error. Duplicate field names are not checked.
+     */
+    bool check(parse_result *result, const char*& value_begin, const char*& value_end)
+    {
+        parse_document(result, [&](mgjson&) {
+            value_begin = p_;
+            bool ok = check_value();
+            value_end = p_;
+            return ok;
+        });
+        return (parse_result::NoError == error_);
+    }
+
+    /* Value is parsed as if it were inside containers of depth (elements of
+     * top-level array by from_json_parallel()), so max_depth is the same.
+     */
+    inline void set_depth(size_t depth)
+    {
+        depth_ = depth;
+    }
+
+    inline parse_result::parse_error error() const
+    {
+        return error_;
+    }
+
+private:
+    template <typename F>
+    mgjson parse_document(parse_result *result, F parse_root)
+    {
+        mgjson value(mgjson_private::make(nullptr));
+        skip_ws();
+        if ((0 != options_.max_size) && (static_cast<size_t>(end_ - begin_) > options_.max_size)) {
+            fail(parse_result::SizeLimitExceeded, begin_ + options_.max_size);
+        }
+        else if (end_ == p_) {
+            fail(parse_result::EndOfData);
+        }
+        else if (parse_root(value)) {
+            skip_ws();
+            if (end_ != p_) {
+                fail(parse_result::MoreData);
+            }
+            else {
+                error_pos_ = p_;
+            }
+        }
+
+        if (nullptr != result) {
+            result->error = error_;
+            if (parse_result::NoError == error_) {
+                set_end(*result, begin_, error_pos_);
+            }
+            else {
+                set_position(*result, begin_, error_pos_);
+            }
+        }
+
+        if (0 > error_) {
+            buffers_->clear_items();    // Don't keep parts of failed document.
+            return mgjson(mgjson::Undefined);
+        }
+        if (nullptr == mgjson_private::get(static_cast<const mgjson&>(value))) {
+            return mgjson(mgjson::Undefined);
+        }
+        return value;
+    }
+
+    static inline mgjson::parse_options options_with(mgjson::json_parse flags)
+    {
+        mgjson::parse_options options;
+        options.flags = flags;
+        return options;
+    }
+
+    static inline bool validate_utf8(mgjson::json_parse flags)
+    {
+#ifdef MGJSON_STRICT_UTF8
+        (void) flags;
+        return true;
+#else
+        return (0 != (flags & mgjson::ValidateUtf8));
+#endif
+    }
+
+    inline bool fail(parse_result::parse_error error)
+    {
+        return fail(error, p_);
+    }
+
+    inline bool fail(parse_result::parse_error error, const char* pos)
+    {
+        error_ = error;
+        error_pos_ = pos;
+        return false;
+    }
+
+    inline void skip_ws()
+    {
+        while (end_ != p_) {
+            switch (*p_) {
+            case '\n':
+            case ' ':
+            case '\t':
+            case '\r':
+                ++p_;
+                break;
+            default:
+                return;
+            }
+        }
+    }
+
+    bool parse_value(mgjson& value)
+    {
+        switch (*p_) {
+        case '{':
+            return parse_object(value);
+        case '[':
+            return parse_array(value);
+        case '"':
+            {
+                if (!parse_text()) {
+                    return false;
+                }
+                // Copy of exact size; scratch buffer keeps its capacity.
+                const mgjson_private::string_type& text = buffers_->text;
+                value = mgjson_private::make(new mgjson_private(
+                            mgjson_private::string_type(text.data(), text.size())));
+                return true;
+            }
+        case 't':
+            if (!parse_literal("true", 4)) {
+                return false;
+            }
+            value = mgjson_private::make(new mgjson_private(true));
+            return true;
+        case 'f':
+            if (!parse_literal("false", 5)) {
+                return false;
+            }
+            value = mgjson_private::make(new mgjson_private(false));
+            return true;
+        case 'n':
+            if (!parse_literal("null", 4)) {
+                return false;
+            }
+            value = mgjson_private::make(new mgjson_private(mgjson::Null));
+            return true;
+        default:
+            if (('-' == *p_) || mgjson_number::is_digit(*p_)) {
+                return parse_number(value);
+            }
+            return fail(parse_result::InvalidCharacter);
+        }
+    }
+
+    /* String value into buffers_->text. Adjacent literals are joined with
+     * JoinStrings: to_json() with SplitStrings writes multiline strings so.
+     */
+    bool parse_text()
+    {
+        mgjson_private::string_type& text = buffers_->text;
+        text.clear();
+        if (!parse_string(text)) {
+            return false;
+        }
+        while (next_literal()) {
+            if (!parse_string(text)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* Next literal of string value (after spaces) with JoinStrings.
+     */
+    inline bool next_literal()
+    {
+        if (!join_strings_) {
+            return false;
+        }
+        skip_ws();
+        return (end_ != p_) && ('"' == *p_);
+    }
+
+    bool parse_literal(const char* literal, size_t len)
+    {
+        for (size_t i = 0; i < len; ++i, ++p_) {
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            if (literal[i] != *p_) {
+                return fail(parse_result::InvalidCharacter);
+            }
+        }
+        return true;
+    }
+
+    bool scan_number(mgjson_number::decimal& dec)
+    {
+        switch (mgjson_number::scan(p_, end_, dec)) {
+        case mgjson_number::Ok:
+            p_ = dec.end;
+            return true;
+        case mgjson_number::DigitExpected:
+            return fail((end_ == dec.end) ? parse_result::EndOfData : parse_result::IntExpected,
+                        dec.end);
+        default:
+            return fail(parse_result::InvalidNumber, dec.end);
+        }
+    }
+
+    bool parse_number(mgjson& value)
+    {
+        mgjson_number::decimal dec;
+        if (!scan_number(dec)) {
+            return false;
+        }
+        value = mgjson_private::make(new mgjson_private(dec, preserve_numbers_));
+        return true;
+    }
+
+    /* Opening bracket of array or object; checks depth limit.
+     */
+    inline bool enter()
+    {
+        if ((0 != options_.max_depth) && (depth_ >= options_.max_depth)) {
+            return fail(parse_result::DepthLimitExceeded);
+        }
+        ++depth_;
+        ++p_;
+        skip_ws();
+        return true;
+    }
+
+    /* Elements are collected in scratch vector of current nesting level
+     * (elements of these vectors don't move when deeper levels are added) and
+     * moved into array of exact size at the end.
+     */
+    bool parse_array(mgjson& value)
+    {
+        if (!enter()) {
+            return false;
+        }
+        mgjson_private* data = new mgjson_private(mgjson::Array);
+        value = mgjson_private::make(data);
+        if ((end_ != p_) && (']' == *p_)) {
+            ++p_;
+            --depth_;
+            return true;
+        }
+
+        std::vector<std::vector<mgjson>>& items = buffers_->items;
+        const size_t level = depth_ - 1;
+        if (items.size() <= level) {
+            items.resize(level + 1);
+        }
+        items[level].clear();
+
+        for (;;) {
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            items[level].push_back(mgjson_private::make(nullptr));
+            if (!parse_value(items[level].back())) {
+                return false;
+            }
+            skip_ws();
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            if (']' == *p_) {
+                ++p_;
+                --depth_;
+                std::vector<mgjson>& elements = items[level];
+                data->array_.assign(elements.size(), mgjson_private::make(nullptr));
+                for (size_t i = 0; i < elements.size(); ++i) {
+                    mgjson_private::swap(data->array_[i], elements[i]);
+                }
+                elements.clear();
+                return true;
+            }
+            if (',' != *p_) {
+                return fail(parse_result::SquareBracketExpected);
+            }
+            ++p_;
+            skip_ws();
+        }
+    }
+
+    /* Object with fields selected by projection node n; nullptr means all
+     * fields.
+     */
+    bool parse_object(mgjson& value, const mgjson_projection::node* n = nullptr)
+    {
+        if (!enter()) {
+            return false;
+        }
+        mgjson_private* data = new mgjson_private(mgjson::Object);
+        value = mgjson_private::make(data);
+        if ((end_ != p_) && ('}' == *p_)) {
+            ++p_;
+            --depth_;
+            return true;
+        }
+
+        std::vector<const mgjson_private*> collected;   // See parse_duplicate().
+        for (;;) {
+            const char* name_pos = p_;
+            if (!parse_field_name()) {
+                return false;
+            }
+            const mgjson_projection::node* child = (nullptr == n)
+                    ? nullptr : n->find(key_data(), static_cast<size_t>(name_.size()));
+            if ((nullptr != n) && (nullptr == child)) {
+                if (!skip_value()) {
+                    return false;
+                }
+            }
+            else if (!parse_field_value(data, name_pos, child, collected)) {
+                return false;
+            }
+
+            skip_ws();
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            if ('}' == *p_) {
+                ++p_;
+                --depth_;
+                return true;
+            }
+            if (',' != *p_) {
+                return fail(parse_result::CurlyBracketExpected);
+            }
+            ++p_;
+            skip_ws();
+        }
+    }
+
+    /* Field name (into name_) and colon.
+     */
+    bool parse_field_name()
+    {
+        if (end_ == p_) {
+            return fail(parse_result::EndOfData);
+        }
+        if ('"' != *p_) {
+            return fail(parse_result::InvalidName);
+        }
+        const char* name_pos = p_;
+        name_.clear();
+        if (!parse_string(name_)) {
+            return false;
+        }
+        if ((0 == name_.size())
+            || (strlen(key_data()) != static_cast<size_t>(name_.size()))) {
+            return fail(parse_result::InvalidName, name_pos);
+        }
+
+        skip_ws();
+        if (end_ == p_) {
+            return fail(parse_result::EndOfData);
+        }
+        if (':' != *p_) {
+            return fail(parse_result::ColonExpected);
+        }
+        ++p_;
+        skip_ws();
+        if (end_ == p_) {
+            return fail(parse_result::EndOfData);
+        }
+        return true;
+    }
+
+    /* Value of field name_, selected by projection node n. Duplicate names
+     * are found by the map insertion itself; when names go in sorted order
+     * (as to_json() writes them), field is appended without tree lookup.
+     */
+    bool parse_field_value(mgjson_private* data, const char* name_pos,
+                           const mgjson_projection::node* n,
+                           std::vector<const mgjson_private*>& collected)
+    {
+        typedef std::map<mgjson_private::Key, mgjson> map_type;
+        map_type& map = data->map_;
+        map_type::iterator it;
+        if (map.empty() || (0 < strcmp(key_data(), map.rbegin()->first.d))) {
+            it = map.emplace_hint(map.end(), std::piecewise_construct,
+                                  std::forward_as_tuple(key_data()),
+                                  std::forward_as_tuple(mgjson_private::make(nullptr)));
+        }
+        else {
+            auto res = map.emplace(std::piecewise_construct,
+                                   std::forward_as_tuple(key_data()),
+                                   std::forward_as_tuple(mgjson_private::make(nullptr)));
+            if (!res.second) {
+                return parse_duplicate(res.first->second, name_pos, n, collected);
+            }
+            it = res.first;
+        }
+        if (!parse_selected(it->second, n)) {
+            return false;
+        }
+        if (nullptr == mgjson_private::get(static_cast<const mgjson&>(it->second))) {
+            map.erase(it);
+        }
+        return true;
+    }
+
+    /* Repeated field. With DuplicateKeepAll the first repeat replaces value
+     * with array of values; such arrays are remembered in collected, so
+     * array values of not repeated fields are never appended to.
+     */
+    bool parse_duplicate(mgjson& existing, const char* name_pos, const mgjson_projection::node* n,
+                         std::vector<const mgjson_private*>& collected)
+    {
+        switch (options_.duplicates) {
+        case mgjson::DuplicateFirstWins:
+            return skip_value();
+        case mgjson::DuplicateLastWins:
+        case mgjson::DuplicateKeepAll:
+            break;
+        default:
+            return fail(parse_result::DuplicateName, name_pos);
+        }
+
+        mgjson value(mgjson_private::make(nullptr));
+        if (!parse_selected(value, n)) {
+            return false;
+        }
+        if (nullptr == mgjson_private::get(static_cast<const mgjson&>(value))) {
+            return true;
+        }
+        if (mgjson::DuplicateLastWins == options_.duplicates) {
+            existing = value;
+            return true;
+        }
+
+        const mgjson_private* array = mgjson_private::get(static_cast<const mgjson&>(existing));
+        if (collected.end() == std::find(collected.begin(), collected.end(), array)) {
+            mgjson_private* values = new mgjson_private(mgjson::Array);
+            values->array_.push_back(existing);
+            existing = mgjson_private::make(values);
+            collected.push_back(values);
+        }
+        mgjson_private::get(existing)->array_.push_back(value);
+        return true;
+    }
+
+    /* Value at projection node n (nullptr means whole value is selected).
+     * Unselected value is skipped and leaves value untouched.
+     */
+    bool parse_selected(mgjson& value, const mgjson_projection::node* n)
+    {
+        if ((nullptr == n) || n->whole) {
+            return parse_value(value);
+        }
+        switch (*p_) {
+        case '{':
+            return parse_object(value, n);
+        case '[':
+            return parse_selected_array(value, n);
+        default:
+            return skip_value();
+        }
+    }
+
+    bool parse_selected_array(mgjson& value, const mgjson_projection::node* n)
+    {
+        if (!enter()) {
+            return false;
+        }
+        mgjson_private* data = new mgjson_private(mgjson::Array);
+        value = mgjson_private::make(data);
+        mgjson undefined(mgjson::Undefined);
+        if ((end_ != p_) && (']' == *p_)) {
+            ++p_;
+            --depth_;
+            return true;
+        }
+
+        for (size_t index = 0; ; ++index) {
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            const mgjson_projection::node* child = n->find(index);
+            if (nullptr == child) {
+                data->array_.push_back(undefined);
+                if (!skip_value()) {
+                    return false;
+                }
+            }
+            else {
+                data->array_.push_back(mgjson_private::make(nullptr));
+                if (!parse_selected(data->array_.back(), child)) {
+                    return false;
+                }
+                if (nullptr == mgjson_private::get(static_cast<const mgjson&>(data->array_.back()))) {
+                    data->array_.back() = undefined;
+                }
+            }
+            skip_ws();
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            if (']' == *p_) {
+                ++p_;
+                --depth_;
+                return true;
+            }
+            if (',' != *p_) {
+                return fail(parse_result::SquareBracketExpected);
+            }
+            ++p_;
+            skip_ws();
+        }
+    }
+
+    bool parse_filtered_array(mgjson& value, const mgjson_projection::node* n,
+                              const mgjson::record_predicate& predicate)
+    {
+        if (!enter()) {
+            return false;
+        }
+        mgjson_private* data = new mgjson_private(mgjson::Array);
+        value = mgjson_private::make(data);
+        if ((end_ != p_) && (']' == *p_)) {
+            ++p_;
+            --depth_;
+            return true;
+        }
+
+        for (;;) {
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            const char* element = p_;
+            mgjson probe(mgjson_private::make(nullptr));
+            if (!parse_selected(probe, n)) {
+                return false;
+            }
+            if (nullptr == mgjson_private::get(static_cast<const mgjson&>(probe))) {
+                probe = mgjson(mgjson::Undefined);
+            }
+            if (predicate(probe)) {
+                p_ = element;
+                data->array_.push_back(mgjson_private::make(nullptr));
+                if (!parse_value(data->array_.back())) {
+                    return false;
+                }
+            }
+
+            skip_ws();
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            if (']' == *p_) {
+                ++p_;
+                --depth_;
+                return true;
+            }
+            if (',' != *p_) {
+                return fail(parse_result::SquareBracketExpected);
+            }
+            ++p_;
+            skip_ws();
+        }
+    }
+
+    /* Document as tape (BuildTape): records of image are written while
+     * parsing, objects and arrays after their items, so no nodes are made.
+     */
+    mgjson parse_tape(parse_result *result)
+    {
+        std::shared_ptr<std::string> tape = std::make_shared<std::string>();
+        mgjson_image_builder builder(*tape);
+        tape_ = &builder;
+        return parse_document(result, [&](mgjson& value) {
+            uint32_t root;
+            try {
+                if (!tape_value(root)) {
+                    return false;
+                }
+            }
+            catch (const std::length_error&) {
+                return fail(parse_result::SizeLimitExceeded);
+            }
+            builder.finish(root);
+            tape->shrink_to_fit();
+            value = mgjson_image::open(std::make_shared<const mgjson_image>(tape->data(), tape->size(), tape),
+                                       nullptr);
+            return true;
+        });
+    }
+
+    bool tape_value(uint32_t& ref)
+    {
+        switch (*p_) {
+        case '{':
+            return tape_object(ref);
+        case '[':
+            return tape_array(ref);
+        case '"':
+            if (!parse_text()) {
+                return false;
+            }
+            ref = tape_->string(mgjson_image::TagString, buffers_->text.data(),
+                                static_cast<size_t>(buffers_->text.size()));
+            return true;
+        case 't':
+            ref = mgjson_image::TrueRef;
+            return parse_literal("true", 4);
+        case 'f':
+            ref = mgjson_image::FalseRef;
+            return parse_literal("false", 5);
+        case 'n':
+            ref = mgjson_image::NullRef;
+            return parse_literal("null", 4);
+        default:
+            if (('-' == *p_) || mgjson_number::is_digit(*p_)) {
+                mgjson_number::decimal dec;
+                if (!scan_number(dec)) {
+                    return false;
+                }
+                if (preserve_numbers_) {
+                    ref = tape_->string(dec.is_integer ? mgjson_image::TagRawInteger : mgjson_image::TagRawDouble,
+                                        dec.begin, static_cast<size_t>(dec.end - dec.begin));
+                }
+                else {
+                    ref = tape_->number(mgjson_binary::number(dec));
+                }
+                return true;
+            }
+            return fail(parse_result::InvalidCharacter);
+        }
+    }
+
+    /* Scratch vector of current nesting level, as in parse_array().
+     */
+    template <typename T>
+    inline std::vector<T>& tape_level(std::vector<std::vector<T>>& levels)
+    {
+        const size_t level = depth_ - 1;
+        if (levels.size() <= level) {
+            levels.resize(level + 1);
+        }
+        levels[level].clear();
+        return levels[level];
+    }
+
+    bool tape_array(uint32_t& ref)
+    {
+        if (!enter()) {
+            return false;
+        }
+        const size_t level = depth_ - 1;
+        tape_level(buffers_->tape_items);
+        if ((end_ == p_) || (']' != *p_)) {
+            for (;;) {
+                if (end_ == p_) {
+                    return fail(parse_result::EndOfData);
+                }
+                uint32_t item;
+                if (!tape_value(item)) {
+                    return false;
+                }
+                buffers_->tape_items[level].push_back(item);
+                skip_ws();
+                if (end_ == p_) {
+                    return fail(parse_result::EndOfData);
+                }
+                if (']' == *p_) {
+                    break;
+                }
+                if (',' != *p_) {
+                    return fail(parse_result::SquareBracketExpected);
+                }
+                ++p_;
+                skip_ws();
+            }
+        }
+        ++p_;
+        --depth_;
+
+        std::vector<uint32_t>& items = buffers_->tape_items[level];
+        size_t pos = tape_->container(mgjson_image::TagArray, items.size(), 4, ref);
+        for (uint32_t item : items) {
+            tape_->set(pos, item);
+            pos += 4;
+        }
+        items.clear();
+        return true;
+    }
+
+    bool tape_object(uint32_t& ref)
+    {
+        if (!enter()) {
+            return false;
+        }
+        const size_t level = depth_ - 1;
+        tape_level(buffers_->tape_fields);
+        if ((end_ == p_) || ('}' != *p_)) {
+            for (;;) {
+                const char* name_pos = p_;
+                if (!parse_field_name()) {
+                    return false;
+                }
+                const uint32_t key = tape_->key(key_data(), static_cast<size_t>(name_.size()));
+                if (!tape_unique(buffers_->tape_fields[level], key, name_pos)) {
+                    return false;
+                }
+                uint32_t value;
+                if (!tape_value(value)) {
+                    return false;
+                }
+                buffers_->tape_fields[level].push_back({key, value});
+                skip_ws();
+                if (end_ == p_) {
+                    return fail(parse_result::EndOfData);
+                }
+                if ('}' == *p_) {
+                    break;
+                }
+                if (',' != *p_) {
+                    return fail(parse_result::CurlyBracketExpected);
+                }
+                ++p_;
+                skip_ws();
+            }
+        }
+        ++p_;
+        --depth_;
+        return tape_fields(buffers_->tape_fields[level], ref);
+    }
+
+    /* Repeated name is an error (unless duplicate policy resolves it) before
+     * its value is parsed, as in parse_object(). Keys are shared by equal
+     * names, so references are compared.
+     */
+    bool tape_unique(const std::vector<mgjson_parser_buffers::tape_field>& fields, uint32_t key,
+                     const char* name_pos)
+    {
+        switch (options_.duplicates) {
+        case mgjson::DuplicateFirstWins:
+        case mgjson::DuplicateLastWins:
+        case mgjson::DuplicateKeepAll:
+            return true;
+        default:
+            break;
+        }
+        for (const mgjson_parser_buffers::tape_field& field : fields) {
+            if (field.key == key) {
+                return fail(parse_result::DuplicateName, name_pos);
+            }
+        }
+        return true;
+    }
+
+    /* Object record of fields. Fields are sorted by name (to_json() writes
+     * them sorted already, so usually only checked), repeated names are
+     * resolved by duplicate policy as in parse_duplicate() (tape_unique()
+     * has failed already if the policy does not allow them).
+     */
+    bool tape_fields(std::vector<mgjson_parser_buffers::tape_field>& fields, uint32_t& ref)
+    {
+        typedef mgjson_parser_buffers::tape_field tape_field;
+        auto less = [this](const tape_field& a, const tape_field& b) {
+            return (a.key != b.key) && (0 > strcmp(tape_->text(a.key), tape_->text(b.key)));
+        };
+        if (!std::is_sorted(fields.begin(), fields.end(), less)) {
+            std::stable_sort(fields.begin(), fields.end(), less);
+        }
+
+        size_t count = 0;
+        for (size_t i = 0; i < fields.size();) {
+            size_t next = i + 1;
+            while ((fields.size() != next) && (fields[next].key == fields[i].key)) {
+                ++next;
+            }
+            tape_field field = fields[i];
+            if (1 < next - i) {
+                switch (options_.duplicates) {
+                case mgjson::DuplicateFirstWins:
+                    break;
+                case mgjson::DuplicateLastWins:
+                    field.value = fields[next - 1].value;
+                    break;
+                case mgjson::DuplicateKeepAll:
+                {
+                    size_t pos = tape_->container(mgjson_image::TagArray, next - i, 4, field.value);
+                    for (size_t j = i; j < next; ++j, pos += 4) {
+                        tape_->set(pos, fields[j].value);
+                    }
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+            fields[count++] = field;
+            i = next;
+        }
+        size_t pos = tape_->container(mgjson_image::TagObject, count, 8, ref);
+        for (size_t i = 0; i < count; ++i, pos += 8) {
+            tape_->set(pos, fields[i].key);
+            tape_->set(pos + 4, fields[i].value);
+        }
+        fields.clear();
+        return true;
+    }
+
+    /* Same checks as in parse_value(), but nothing is built.
+     */
+    bool check_value()
+    {
+        switch (*p_) {
+        case '{':
+            return check_object();
+        case '[':
+            return check_array();
+        case '"':
+            {
+                mgjson_private::string_type& text = buffers_->text;
+                text.clear();
+                if (!parse_string(text)) {
+                    return false;
+                }
+                while (next_literal()) {
+                    if (!parse_string(text)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        default:
+            return skip_value();
+        }
+    }
+
+    bool check_array()
+    {
+        if (!enter()) {
+            return false;
+        }
+        if ((end_ != p_) && (']' == *p_)) {
+            ++p_;
+            --depth_;
+            return true;
+        }
+
+        for (;;) {
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            if (!check_value()) {
+                return false;
+            }
+            skip_ws();
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            if (']' == *p_) {
+                ++p_;
+                --depth_;
+                return true;
+            }
+            if (',' != *p_) {
+                return fail(parse_result::SquareBracketExpected);
+            }
+            ++p_;
+            skip_ws();
+        }
+    }
+
+    bool check_object()
+    {
+        if (!enter()) {
+            return false;
+        }
+        if ((end_ != p_) && ('}' == *p_)) {
+            ++p_;
+            --depth_;
+            return true;
+        }
+
+        for (;;) {
+            if (!parse_field_name() || !check_value()) {
+                return false;
+            }
+            skip_ws();
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            if ('}' == *p_) {
+                ++p_;
+                --depth_;
+                return true;
+            }
+            if (',' != *p_) {
+                return fail(parse_result::CurlyBracketExpected);
+            }
+            ++p_;
+            skip_ws();
+        }
+    }
+
+    /* Moves over value without building it. Compound values are only checked
+     * for balanced brackets.
+     */
+    bool skip_value()
+    {
+        switch (*p_) {
+        case '{':
+        case '[':
+            {
+                const char* close = find_closing_bracket(p_, end_);
+                if (nullptr == close) {
+                    return fail(parse_result::EndOfData, end_);
+                }
+                p_ = close;
+                return true;
+            }
+        case '"':
+            if (!skip_string()) {
+                return false;
+            }
+            while (next_literal()) {
+                if (!skip_string()) {
+                    return false;
+                }
+            }
+            return true;
+        case 't':
+            return parse_literal("true", 4);
+        case 'f':
+            return parse_literal("false", 5);
+        case 'n':
+            return parse_literal("null", 4);
+        default:
+            if (('-' == *p_) || mgjson_number::is_digit(*p_)) {
+                mgjson_number::decimal dec;
+                return scan_number(dec);
+            }
+            return fail(parse_result::InvalidCharacter);
+        }
+    }
+
+    bool skip_string()
+    {
+        ++p_;
+        for (;;) {
+            p_ = mgjson_simd::find_string_special(p_, end_, false);
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            if ('"' == *p_) {
+                ++p_;
+                return true;
+            }
+            if ('\\' != *p_) {
+                return fail(parse_result::InvalidCharacter);
+            }
+            if (2 > (end_ - p_)) {
+                return fail(parse_result::EndOfData, end_);
+            }
+            p_ += 2;
+        }
+    }
+
+    inline const char* key_data() const
+    {
+#ifdef QT_CORE_LIB
+        return name_.constData();
+#else
+        return name_.c_str();
+#endif
+    }
+
+    static inline int hex_value(char c)
+    {
+        if (('0' <= c) && ('9' >= c)) {
+            return c - '0';
+        }
+        if (('a' <= c) && ('f' >= c)) {
+            return c - 'a' + 10;
+        }
+        if (('A' <= c) && ('F' >= c)) {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    bool parse_hex4(unsigned& code)
+    {
+        code = 0;
+        for (int i = 0; i < 4; ++i, ++p_) {
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            int v = hex_value(*p_);
+            if (0 > v) {
+                return fail(parse_result::InvalidCharacter);
+            }
+            code = (code << 4) | static_cast<unsigned>(v);
+        }
+        return true;
+    }
+
+    static void append_utf8(mgjson_private::string_type& str, unsigned code)
+    {
+        if (0x80 > code) {
+            str.push_back(static_cast<char>(code));
+        }
+        else if (0x800 > code) {
+            str.push_back(static_cast<char>(0xC0 | (code >> 6)));
+            str.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        else if (0x10000 > code) {
+            str.push_back(static_cast<char>(0xE0 | (code >> 12)));
+            str.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            str.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        else {
+            str.push_back(static_cast<char>(0xF0 | (code >> 18)));
+            str.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+            str.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            str.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+    }
+
+    bool parse_escape(mgjson_private::string_type& str)
+    {
+        ++p_;
+        if (end_ == p_) {
+            return fail(parse_result::EndOfData);
+        }
+        char c = *p_;
+        switch (c) {
+        case '"':
+        case '\\':
+        case '/':
+            break;
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'n': c = '\n'; break;
+        case 'r': c = '\r'; break;
+        case 't': c = '\t'; break;
+        case 'u':
+            {
+                const char* escape_pos = p_ - 1;
+                ++p_;
+                unsigned code;
+                if (!parse_hex4(code)) {
+                    return false;
+                }
+                if ((0xDC00 <= code) && (0xDFFF >= code)) {
+                    return fail(parse_result::InvalidCharacter, escape_pos);
+                }
+                if ((0xD800 <= code) && (0xDBFF >= code)) {
+                    if ((2 > (end_ - p_)) || ('\\' != p_[0]) || ('u' != p_[1])) {
+                        return fail(parse_result::InvalidCharacter, escape_pos);
+                    }
+                    p_ += 2;
+                    unsigned low;
+                    if (!parse_hex4(low)) {
+                        return false;
+                    }
+                    if ((0xDC00 > low) || (0xDFFF < low)) {
+                        return fail(parse_result::InvalidCharacter, escape_pos);
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                append_utf8(str, code);
+                return true;
+            }
+        default:
+            return fail(parse_result::InvalidCharacter);
+        }
+        str.push_back(c);
+        ++p_;
+        return true;
+    }
+
+    bool parse_string(mgjson_private::string_type& str)
+    {
+        const char* start = p_;
+        ++p_;
+        for (;;) {
+            const char* run = p_;
+            for (;;) {
+                p_ = mgjson_simd::find_string_special(p_, end_, validate_utf8_);
+                if ((end_ == p_) || (0 == (0x80 & *p_))) {
+                    break;
+                }
+                do {
+                    size_t len = mgjson_utf8::sequence_length(p_, end_);
+                    if (0 == len) {
+                        return fail(parse_result::InvalidCharacter);
+                    }
+                    p_ += len;
+                } while ((end_ != p_) && (0 != (0x80 & *p_)));
+            }
+            if (run != p_) {
+                str.append(run, static_cast<int>(p_ - run));
+            }
+            if (end_ == p_) {
+                return fail(parse_result::EndOfData);
+            }
+            if ('"' == *p_) {
+                ++p_;
+                if ((0 != options_.max_string_length)
+                    && (static_cast<size_t>(str.size()) > options_.max_string_length)) {
+                    return fail(parse_result::StringLimitExceeded, start);
+                }
+                return true;
+            }
+            if ('\\' != *p_) {
+                return fail(parse_result::InvalidCharacter);
+            }
+            if (!parse_escape(str)) {
+                return false;
+            }
+        }
+    }
+
+private:
+    const char* const begin_;
+    const char* const end_;
+    const char* p_;
+    parse_result::parse_error error_;
+    const char* error_pos_;
+    const mgjson::parse_options options_;
+    const bool validate_utf8_;
+    const bool preserve_numbers_;
+    const bool join_strings_;
+    size_t depth_;
+    mgjson_parser_buffers local_buffers_;
+    mgjson_parser_buffers* const buffers_;
+    mgjson_private::string_type& name_;
+    mgjson_image_builder* tape_;
+};
+
+struct json_line
+{
+    const char* begin;
+    const char* end;
+    int row;
+};
+
+class json_line_splitter
+{
+public:
+    json_line_splitter(const char *data, size_t cb_data) :
+        p_(data),
+        line_(data),
+        end_(data + cb_data),
+        row_(1)
+    {
+    }
+
+    /* Collects next lines (at least max_lines, when available); empty lines
+     * are skipped. Returns false when there are no more lines.
+     */
+    bool next(std::vector<json_line>& lines, size_t max_lines)
+    {
+        lines.clear();
+        while ((end_ != p_) && (lines.size() < max_lines)) {
+            if (static_cast<size_t>(end_ - p_) >= mgjson_simd::block_size) {
+                for (uint64_t mask = mgjson_simd::eq_mask(p_, '\n'); 0 != mask;
+                     mask = mgjson_simd::clear_lowest_bit(mask)) {
+                    add_line(lines, p_ + mgjson_simd::count_trailing_zeros(mask));
+                }
+                p_ += mgjson_simd::block_size;
+            }
+            else {
+                for (; end_ != p_; ++p_) {
+                    if ('\n' == *p_) {
+                        add_line(lines, p_);
+                    }
+                }
+            }
+        }
+        if ((end_ == p_) && (end_ != line_)) {
+            add_line(lines, end_);
+        }
+        return !lines.empty();
+    }
+
+private:
+    inline void add_line(std::vector<json_line>& lines, const char* eol)
+    {
+        const char* end = eol;
+        if ((line_ != end) && ('\r' == end[-1])) {
+            --end;
+        }
+        if (line_ != end) {
+            lines.push_back(json_line{line_, end, row_});
+        }
+        line_ = (end_ == eol) ? end_ : (eol + 1);
+        ++row_;
+    }
+
+private:
+    const char* p_;
+    const char* line_;
+    const char* const end_;
+    int row_;
+};
+
+void parse_json_lines(const char *data, const std::vector<json_line>& lines,
+                      mgjson* values, parse_result* results, unsigned threads,
+                      mgjson::json_parse flags)
+{
+    mgjson_parallel::for_each_range(lines.size(), 256, threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const json_line& line = lines[i];
+            parse_result& res = results[i];
+            values[i] = json_parser(line.begin, static_cast<size_t>(line.end - line.begin), flags)
+                    .parse(&res);
+            res.offset += static_cast<int>(line.begin - data);
+            res.row = line.row;
+        }
+    });
+}
+
+/* Structural pre-scan of top-level array: finds commas separating its
+ * elements and closing bracket, skipping strings. Returns false if document
+ * doesn't look like single array; such documents are left to sequential
+ * parser, which also reports all errors.
+ */
+class array_scanner
+{
+public:
+    array_scanner(const char *data, size_t cb_data) :
+        begin_(data),
+        end_(data + cb_data),
+        close_(nullptr),
+        depth_(0),
+        in_string_(0)
+    {
+    }
+
+    bool scan(const char* open)
+    {
+        assert('[' == *open);
+        const char* p = open;
+        for (; static_cast<size_t>(end_ - p) >= mgjson_simd::block_size; p += mgjson_simd::block_size) {
+            if (!scan_block(mgjson_simd::block(p), p)) {
+                return false;
+            }
+        }
+        if (end_ != p) {
+            char tail[mgjson_simd::block_size];
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, p, static_cast<size_t>(end_ - p));
+            if (!scan_block(mgjson_simd::block(tail), p)) {
+                return false;
+            }
+        }
+        return (nullptr != close_) && (0 == in_string_);
+    }
+
+private:
+    bool scan_block(const mgjson_simd::block& b, const char* p)
+    {
+        uint64_t quotes = b.eq('"') & ~escapes_.next(b.eq('\\'));
+        uint64_t strings = mgjson_simd::prefix_xor(quotes) ^ in_string_;
+        in_string_ = (0 != (strings >> 63)) ? ~0ULL : 0;
+
+        uint64_t structurals = (b.eq('[') | b.eq(']') | b.eq('{') | b.eq('}') | b.eq(','))
+                & ~strings;
+        for (; 0 != structurals; structurals = mgjson_simd::clear_lowest_bit(structurals)) {
+            const char* s = p + mgjson_simd::count_trailing_zeros(structurals);
+            if (nullptr != close_) {
+                return false;   // Something after the end of array.
+            }
+            switch (*s) {
+            case '[':
+            case '{':
+                ++depth_;
+                break;
+            case ']':
+            case '}':
+                if (0 == --depth_) {
+                    close_ = s;
+                }
+                else if (0 > depth_) {
+                    return false;
+                }
+                break;
+            default:
+                if (1 == depth_) {
+                    separators_.push_back(s);
+                }
+                break;
+            }
+        }
+        return true;
+    }
+
+public:
+    const char* const begin_;
+    const char* const end_;
+    std::vector<const char*> separators_;
+    const char* close_;
+    int depth_;
+    uint64_t in_string_;
+    mgjson_simd::escape_scanner escapes_;
+};
+
+}   // namespace
+
+mgjson
+mgjson::from_json(const char *data, size_t cb_data, parse_result *result, json_parse flags)
+{
+    if (nullptr == data) {
+        cb_data = 0;
+        data = "";
+    }
+    return json_parser(data, cb_data, flags).parse(result);
+}
+
+mgjson
+mgjson::from_json(const char *data, size_t cb_data, const parse_options& options,
+                  parse_result *result)
+{
+    if (nullptr == data) {
+        cb_data = 0;
+        data = "";
+    }
+    return json_parser(data, cb_data, options).parse(result);
+}
+
+mgjson
+mgjson::from_json(const char *data, size_t cb_data, const mgjson_projection& projection,
+                  parse_result *result, json_parse flags)
+{
+    if (nullptr == data) {
+        cb_data = 0;
+        data = "";
+    }
+    return json_parser(data, cb_data, flags).parse(result, projection);
+}
+
+mgjson
+mgjson::from_json_filtered(const char *data, size_t cb_data, const mgjson_projection& projection,
+                           const record_predicate& predicate, parse_result *result,
+                           json_parse flags)
+{
+    if (nullptr == data) {
+        cb_data = 0;
+        data = "";
+    }
+    return json_parser(data, cb_data, flags).parse(result, projection, predicate);
+}
+
+mgjson
+mgjson::raw_json(const char *data, size_t cb_data, parse_result *result)
+{
+    if (nullptr == data) {
+        cb_data = 0;
+        data = "";
+    }
+    const char* value_begin = data;
+    const char* value_end = data;
+    if (!json_parser(data, cb_data, ParseDefault).check(result, value_begin, value_end)) {
+        return mgjson(Undefined);
+    }
+    size_t size = static_cast<size_t>(value_end - value_begin);
+    switch (*value_begin) {
+    case '{':
+        return mgjson_private::make(new mgjson_private(Object, value_begin, size));
+    case '[':
+        return mgjson_private::make(new mgjson_private(Array, value_begin, size));
+    default:
+        // Scalar is cheaper to build than to keep as text.
+        return json_parser(value_begin, size, ParseDefault).parse(nullptr);
+    }
+}
+
+/* Fragment was checked by raw_json(); repeated names (not checked there)
+ * are resolved as DuplicateLastWins. Image nodes are filled from image,
+ * values of raw numbers are computed from their lexemes. Expanding is done
+ * once per node, so one mutex for all nodes is enough.
+ */
+void
+mgjson_private::_expand() const
+{
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!expand_pending_.load(std::memory_order_relaxed)) {
+        return;     // Expanded by other thread.
+    }
+    if (raw_number_) {
+        mgjson_private* self = const_cast<mgjson_private*>(this);
+        _raw_values(self->b_value_, self->i_value_, self->d_value_);
+        expand_pending_.store(false, std::memory_order_release);
+        return;
+    }
+    if (nullptr != image_) {
+        mgjson_image::expand(*const_cast<mgjson_private*>(this));
+        expand_pending_.store(false, std::memory_order_release);
+        return;
+    }
+
+    mgjson::parse_options options;
+    options.duplicates = mgjson::DuplicateLastWins;
+#ifdef QT_CORE_LIB
+    const char* text = str_value_.constData();
+#else
+    const char* text = str_value_.c_str();
+#endif
+    mgjson value = json_parser(text, static_cast<size_t>(str_value_.size()), options).parse(nullptr);
+    mgjson_private* parsed = get(value);
+    mgjson_private* self = const_cast<mgjson_private*>(this);
+    self->array_.swap(parsed->array_);
+    self->map_.swap(parsed->map_);
+    expand_pending_.store(false, std::memory_order_release);
+}
+
+void
+mgjson::parse_result::compute_position(const char* data)
+{
+    set_position(*this, data, data + offset);
+}
+
+mgjson_parser::mgjson_parser() :
+    buffers_(new mgjson_parser_buffers())
+{
+}
+
+mgjson_parser::mgjson_parser(const mgjson::parse_options& options) :
+    options_(options),
+    buffers_(new mgjson_parser_buffers())
+{
+}
+
+mgjson_parser::~mgjson_parser()
+{
+}
+
+mgjson
+mgjson_parser::parse(const char *data, size_t cb_data, mgjson::parse_result *result,
+                     mgjson::json_parse flags)
+{
+    if (nullptr == data) {
+        cb_data = 0;
+        data = "";
+    }
+    mgjson::parse_options options(options_);
+    options.flags = options.flags | flags;
+    return json_parser(data, cb_data, options, buffers_.get()).parse(result);
+}
+
+mgjson
+mgjson_parser::parse(const char *data, size_t cb_data, const mgjson_projection& projection,
+                     mgjson::parse_result *result, mgjson::json_parse flags)
+{
+    if (nullptr == data) {
+        cb_data = 0;
+        data = "";
+    }
+    mgjson::parse_options options(options_);
+    options.flags = options.flags | flags;
+    return json_parser(data, cb_data, options, buffers_.get()).parse(result, projection);
+}
+
+void
+mgjson_parser::shrink()
+{
+    buffers_.reset(new mgjson_parser_buffers());
+    std::string().swap(text_);
+}
+
+mgjson
+mgjson::from_json(const char *data, parse_result *result, json_parse flags)
+{
+    return from_json(data, (nullptr == data) ? 0 : strlen(data), result, flags);
+}
+
+std::vector<mgjson>
+mgjson::from_json_lines(const char *data, size_t cb_data, std::vector<parse_result> *results,
+                        unsigned threads, json_parse flags)
+{
+    std::vector<json_line> lines;
+    if (nullptr != data) {
+        json_line_splitter(data, cb_data).next(lines, std::numeric_limits<size_t>::max());
+    }
+
+    std::vector<mgjson> values(lines.size(), mgjson_private::make(nullptr));
+    std::vector<parse_result> local_results;
+    if (nullptr == results) {
+        results = &local_results;
+    }
+    results->resize(lines.size());
+    parse_json_lines(data, lines, values.data(), results->data(), threads, flags);
+    return values;
+}
+
+void
+mgjson::from_json_lines(const char *data, size_t cb_data, const json_lines_callback& callback,
+                        unsigned threads, json_parse flags)
+{
+    if (nullptr == data) {
+        return;
+    }
+    threads = mgjson_parallel::threads_count(threads);
+    const size_t window = 4096 * static_cast<size_t>(threads);
+
+    json_line_splitter splitter(data, cb_data);
+    std::vector<json_line> lines;
+    std::vector<mgjson> values;
+    std::vector<parse_result> results;
+    size_t index = 0;
+    while (splitter.next(lines, window)) {
+        values.assign(lines.size(), mgjson_private::make(nullptr));
+        results.resize(lines.size());
+        parse_json_lines(data, lines, values.data(), results.data(), threads, flags);
+        for (size_t i = 0; i < lines.size(); ++i, ++index) {
+            callback(index, values[i], results[i]);
+        }
+    }
+}
+
+mgjson
+mgjson::from_json_parallel(const char *data, size_t cb_data, parse_result *result, unsigned threads,
+                           json_parse flags)
+{
+    static const size_t min_parallel_size = 64 * 1024;
+
+    threads = mgjson_parallel::threads_count(threads);
+    if ((nullptr == data) || (1 >= threads) || (min_parallel_size > cb_data)) {
+        return from_json(data, cb_data, result, flags);
+    }
+
+    const char* end = data + cb_data;
+    const char* open = data;
+    while ((end != open) && ((' ' == *open) || ('\t' == *open) || ('\r' == *open) || ('\n' == *open))) {
+        ++open;
+    }
+    array_scanner scanner(data, cb_data);
+    if ((end == open) || ('[' != *open) || !scanner.scan(open)) {
+        return from_json(data, cb_data, result, flags);
+    }
+    // Data after the array (MoreData) is reported by sequential parser.
+    const char* tail = scanner.close_ + 1;
+    while ((end != tail) && ((' ' == *tail) || ('\t' == *tail) || ('\r' == *tail) || ('\n' == *tail))) {
+        ++tail;
+    }
+    if (end != tail) {
+        return from_json(data, cb_data, result, flags);
+    }
+
+    // Element i lays between separators i-1 and i.
+    std::vector<const char*>& bounds = scanner.separators_;
+    bounds.insert(bounds.begin(), open);
+    bounds.push_back(scanner.close_);
+
+    mgjson json(Array);
+    mgjson_private* array = mgjson_private::get(json);
+    size_t count = bounds.size() - 1;
+    if (1 == count) {
+        const char* p = open + 1;
+        while ((' ' == *p) || ('\t' == *p) || ('\r' == *p) || ('\n' == *p)) {
+            ++p;
+        }
+        if (scanner.close_ == p) {
+            count = 0;
+        }
+    }
+    array->array_.assign(count, mgjson_private::make(nullptr));
+
+    std::atomic<bool> failed(false);
+    size_t grain = std::max<size_t>(16, count / (static_cast<size_t>(threads) * 16));
+    mgjson_parallel::for_each_range(count, grain, threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; (i < end) && !failed.load(std::memory_order_relaxed); ++i) {
+            const char* element = bounds[i] + 1;
+            json_parser parser(element, static_cast<size_t>(bounds[i + 1] - element), flags);
+            parser.set_depth(1);
+            array->array_[i] = parser.parse(nullptr);
+            if (parse_result::NoError != parser.error()) {
+                failed = true;
+            }
+        }
+    });
+    if (failed) {
+        // Let sequential parser find and report the first error.
+        return from_json(data, cb_data, result, flags);
+    }
+
+    if (nullptr != result) {
+        result->error = parse_result::NoError;
+        set_end(*result, data, end);
+    }
+    return json;
+}
@@ -0,0 +1,722 @@
+#pragma once
+#ifndef _MGJSON_PRIVATE_H_INCLUDED_
+#define _MGJSON_PRIVATE_H_INCLUDED_
+
+#include "mgjson.h"
+#include "mgjson_number.h"
+#include "mgjson_dtoa.h"
+#include "mgjson_utf8.h"
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <map>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <limits>
+#include <utility>
+#include <stdexcept>
+#include <cstdio>
+#include <cassert>
+
+class mgjson_image;
+
+#ifndef QT_CORE_LIB
+char *qstrdup(const char *src);
+int qstricmp(const char *str1, const char *str2);
+#endif
+
+class mgjson_private : public _mgjson_shared_data
+{
+public:
+#ifdef QT_CORE_LIB
+    typedef QByteArray string_type;
+#else
+    typedef std::string string_type;
+#endif
+
+public:
+    ~mgjson_private()
+    {
+    }
+
+    mgjson_private(const mgjson_private& other) :
+        _mgjson_shared_data(other),
+        type_(other.type_),
+        raw_number_(other.raw_number_),
+        raw_json_(other.raw_json_),
+        expand_pending_(other.expand_pending_.load(std::memory_order_acquire)),
+        hash_(other.hash_.load(std::memory_order_relaxed)),
+        refs_given_(false),
+        hash_generation_(0),
+        image_(other.image_),
+        image_ref_(other.image_ref_),
+        b_value_(other.b_value_),
+        i_value_(other.i_value_),
+        d_value_(other.d_value_),
+        str_value_(other.str_value_),
+        array_(other.array_),
+        map_(other.map_)
+    {
+    }
+
+    mgjson_private(mgjson::json_type type) :
+        type_(type),
+        raw_number_(false),
+        raw_json_(false),
+        expand_pending_(false),
+        hash_(0),
+        refs_given_(false),
+        hash_generation_(0),
+        image_ref_(0),
+        b_value_(false),
+        i_value_(0),
+        d_value_(0.0),
+        str_value_(_type_text(type))
+    {
+    }
+
+    mgjson_private(bool value) :
+        type_(mgjson::Bool),
+        raw_number_(false),
+        raw_json_(false),
+        expand_pending_(false),
+        hash_(0),
+        refs_given_(false),
+        hash_generation_(0),
+        image_ref_(0),
+        b_value_(value),
+        i_value_(value ? 1 : 0),
+        d_value_(value ? 1.0 : 0.0),
+        str_value_(value ? "true" : "false")
+    {
+    }
+
+    mgjson_private(unsigned long long value) :
+        type_(mgjson::Integer),
+        raw_number_(false),
+        raw_json_(false),
+        expand_pending_(false),
+        hash_(0),
+        refs_given_(false),
+        hash_generation_(0),
+        image_ref_(0),
+        b_value_(!!value),
+        i_value_(value),
+        d_value_(static_cast<long double>(value)),
+#ifdef QT_CORE_LIB
+        str_value_(QByteArray::number(value))
+#else
+        str_value_(std::to_string(value))
+#endif
+    {
+    }
+
+    mgjson_private(long long value) :
+        type_(mgjson::Integer),
+        raw_number_(false),
+        raw_json_(false),
+        expand_pending_(false),
+        hash_(0),
+        refs_given_(false),
+        hash_generation_(0),
+        image_ref_(0),
+        b_value_(!!value),
+        i_value_(static_cast<unsigned long long>(value)),
+        d_value_(static_cast<long double>(value)),
+#ifdef QT_CORE_LIB
+        str_value_(QByteArray::number(value))
+#else
+        str_value_(std::to_string(value))
+#endif
+    {
+    }
+
+    mgjson_private(long double value) :
+        type_(mgjson::Double),
+        raw_number_(false),
+        raw_json_(false),
+        expand_pending_(false),
+        hash_(0),
+        refs_given_(false),
+        hash_generation_(0),
+        image_ref_(0),
+        b_value_(false),
+        i_value_(0),
+        d_value_(0.0)
+    {
+        _set_double(value);
+    }
+
+    mgjson_private(const char* value) :
+        type_(mgjson::String),
+        raw_number_(false),
+        raw_json_(false),
+        expand_pending_(false),
+        hash_(0),
+        refs_given_(false),
+        hash_generation_(0),
+        image_ref_(0),
+        b_value_(false),
+        i_value_(0),
+        d_value_(0.0),
+        str_value_(value)
+    {
+        _check_utf8();
+        _update_values_from_string();
+    }
+
+#ifdef QT_CORE_LIB
+    mgjson_private(const QByteArray& value) :
+#else
+    mgjson_private(const std::string& value) :
+#endif
+        type_(mgjson::String),
+        raw_number_(false),
+        raw_json_(false),
+        expand_pending_(false),
+        hash_(0),
+        refs_given_(false),
+        hash_generation_(0),
+        image_ref_(0),
+        b_value_(false),
+        i_value_(0),
+        d_value_(0.0),
+        str_value_(value)
+    {
+        _check_utf8();
+        _update_values_from_string();
+    }
+
+    mgjson_private(string_type&& value) :
+        type_(mgjson::String),
+        raw_number_(false),
+        raw_json_(false),
+        expand_pending_(false),
+        hash_(0),
+        refs_given_(false),
+        hash_generation_(0),
+        image_ref_(0),
+        b_value_(false),
+        i_value_(0),
+        d_value_(0.0),
+        str_value_(std::move(value))
+    {
+        _update_values_from_string();
+    }
+
+    /* Number scanned by JSON parser. Integers what fit into long long (or into
+     * unsigned long long, when positive) keep their exact lexeme, all other
+     * values became Double.
+     *
+     * With raw set any number keeps its lexeme (and so is written back as
+     * is); numeric values are computed from it on first access, see
+     * to_integer() and others.
+     */
+    mgjson_private(const mgjson_number::decimal& value, bool raw = false) :
+        type_(mgjson::Integer),
+        raw_number_(raw),
+        raw_json_(false),
+        expand_pending_(raw),
+        hash_(0),
+        refs_given_(false),
+        hash_generation_(0),
+        image_ref_(0),
+        b_value_(false),
+        i_value_(0),
+        d_value_(0.0)
+    {
+        if (raw) {
+            type_ = value.is_integer ? mgjson::Integer : mgjson::Double;
+            str_value_.append(value.begin, static_cast<int>(value.end - value.begin));
+        }
+        else if (_decimal_values(value, b_value_, i_value_, d_value_)) {
+            str_value_.append(value.begin, static_cast<int>(value.end - value.begin));
+        }
+        else {
+            _set_double(d_value_);
+        }
+    }
+
+    /* Object or array given as JSON text (see mgjson::raw_json()). Text is
+     * kept in str_value_ and written by to_json() as is until node is changed
+     * (see writable()); array_ or map_ are filled on first navigation, what
+     * has to call expand().
+     */
+    mgjson_private(mgjson::json_type type, const char* text, size_t size) :
+        type_(type),
+        raw_number_(false),
+        raw_json_(true),
+        expand_pending_(true),
+        hash_(0),
+        refs_given_(false),
+        hash_generation_(0),
+        image_ref_(0),
+        b_value_(false),
+        i_value_(0),
+        d_value_(0.0),
+        str_value_(text, static_cast<int>(size))
+    {
+    }
+
+    /* Object or array what is record ref of image (see mgjson_image.h);
+     * until expanded, it is read from image directly.
+     */
+    mgjson_private(mgjson::json_type type, const std::shared_ptr<const mgjson_image>& image,
+                   uint32_t ref) :
+        type_(type),
+        raw_number_(false),
+        raw_json_(false),
+        expand_pending_(true),
+        hash_(0),
+        refs_given_(false),
+        hash_generation_(0),
+        image_(image),
+        image_ref_(ref),
+        b_value_(false),
+        i_value_(0),
+        d_value_(0.0)
+    {
+    }
+
+    inline void expand() const
+    {
+        if (expand_pending_.load(std::memory_order_acquire)) {
+            _expand();
+        }
+    }
+
+    /* Node what count(), at() and other reading functions take from image
+     * instead of array_ and map_.
+     */
+    inline bool in_image() const
+    {
+        return expand_pending_.load(std::memory_order_acquire) && (nullptr != image_);
+    }
+
+    /* See mgjson::hash(). Hash of node what gave references to its children
+     * is valid while write_generation_ is the same.
+     */
+    inline unsigned long long hash() const
+    {
+        unsigned long long h = hash_.load(std::memory_order_relaxed);
+        if ((0 == h) || (refs_given_ && (hash_generation_.load(std::memory_order_relaxed)
+                                         != write_generation_.load(std::memory_order_relaxed)))) {
+            const unsigned long long generation = write_generation_.load(std::memory_order_relaxed);
+            h = _hash();
+            hash_generation_.store(generation, std::memory_order_relaxed);
+            hash_.store(h, std::memory_order_relaxed);
+        }
+        return h;
+    }
+
+    /* Value of number node, also of raw one. Returns true for integer (of
+     * long long range, or of unsigned long long when positive; sign is the
+     * sign of d_val), false for Double.
+     */
+    bool number_value(unsigned long long& i_val, long double& d_val) const
+    {
+        if (raw_number_) {
+#ifdef QT_CORE_LIB
+            const char* str = str_value_.constData();
+#else
+            const char* str = str_value_.c_str();
+#endif
+            bool b_val;
+            mgjson_number::decimal dec;
+            mgjson_number::scan(str, str + str_value_.size(), dec);
+            return _decimal_values(dec, b_val, i_val, d_val);
+        }
+        i_val = i_value_;
+        d_val = d_value_;
+        return (mgjson::Integer == type_);
+    }
+
+    /* Number as written in Canonical format: integers exactly, other values
+     * as shortest text of the nearest double (so 1.0 is written as 1).
+     * Returns length of text put into buf, 0 for nan and infinity.
+     */
+    static const size_t number_chars_size = 64;
+    size_t canonical_number(char* buf) const
+    {
+        unsigned long long i_val;
+        long double d_val;
+        const bool is_integer = number_value(i_val, d_val);
+        char* p = buf;
+        if (is_integer) {
+            if (0.0L > d_val) {
+                *p++ = '-';
+                i_val = 0ULL - i_val;
+            }
+            return static_cast<size_t>(mgjson_dtoa::write_uint(p, i_val) - buf);
+        }
+        if (!std::isfinite(d_val)) {
+            return 0;
+        }
+        const double value = static_cast<double>(d_val);
+        if (0.0 == value) {
+            *p = '0';
+            return 1;
+        }
+        if (std::isfinite(value)) {
+            return static_cast<size_t>(mgjson_dtoa::to_chars(p, value) - buf);
+        }
+        return _long_double_chars(buf, d_val);
+    }
+
+    inline bool to_bool() const
+    {
+        if (raw_number_) {
+            expand();
+        }
+        return b_value_;
+    }
+
+    inline unsigned long long to_integer() const
+    {
+        if (raw_number_) {
+            expand();
+        }
+        return i_value_;
+    }
+
+    inline long double to_double() const
+    {
+        if (raw_number_) {
+            expand();
+        }
+        return d_value_;
+    }
+
+    inline void check_key_is_empty(const char *key) const
+    {
+        if ((nullptr == key) || (0 == strlen(key))) {
+            throw std::out_of_range("mgjson::at(key) key can't be empty!");
+        }
+    }
+
+    inline bool switch_to_array()
+    {
+        switch(type_) {
+        case mgjson::Undefined:
+        case mgjson::Null:
+            type_ = mgjson::Array;
+        case mgjson::Array:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+public:
+    static inline mgjson make(mgjson_private* data)
+    {
+        return mgjson(data);
+    }
+
+    static inline mgjson_private* get(mgjson& json)
+    {
+        return json.d.data();
+    }
+
+    static inline const mgjson_private* get(const mgjson& json)
+    {
+        return json.d.constData();
+    }
+
+    /* Node to change. Raw JSON and image nodes are expanded before detach,
+     * so are never copied, and their text or image is dropped; cached hash
+     * is dropped too. Hash of node can be part of cached hashes of its
+     * parents, so write_generation_ is changed then.
+     */
+    static inline mgjson_private* writable(mgjson& json)
+    {
+        json.d.constData()->expand();
+        mgjson_private* data = json.d.data();
+        if (data->raw_json_) {
+            data->raw_json_ = false;
+            data->str_value_.clear();
+        }
+        if (nullptr != data->image_) {
+            data->image_.reset();
+        }
+        if (0 != data->hash_.load(std::memory_order_relaxed)) {
+            data->hash_.store(0, std::memory_order_relaxed);
+            write_generation_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return data;
+    }
+
+    /* Node to change and to return reference to its child from. Child can
+     * be changed through the reference later, without writable() of this
+     * node, so cached hash of this node is checked against
+     * write_generation_ (see hash()).
+     */
+    static inline mgjson_private* writable_parent(mgjson& json)
+    {
+        mgjson_private* data = writable(json);
+        data->refs_given_ = true;
+        return data;
+    }
+
+    /* Node of json is to be replaced by other one (mgjson::operator=()),
+     * what can be done through reference given by writable_parent(), so
+     * write_generation_ is changed as by writable().
+     */
+    static inline void replacing(const mgjson& json)
+    {
+        const mgjson_private* data = json.d.constData();
+        if ((nullptr != data) && (0 != data->hash_.load(std::memory_order_relaxed))) {
+            write_generation_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static inline void swap(mgjson& json1, mgjson& json2)
+    {
+        json1.d.swap(json2.d);
+    }
+
+private:
+    void _expand() const;     // See mgjson_parser.cpp.
+    unsigned long long _hash() const;   // See mgjson.cpp.
+    unsigned long long _hash_image() const;
+
+    void _set_double(long double value)
+    {
+        type_ = mgjson::Double;
+        b_value_ = (0.0L != value);
+        i_value_ = _clamp_to_integer(value);
+        d_value_ = value;
+
+        // Text is shortest form of the nearest double; only values out of
+        // double range keep long double digits.
+        const double d_val = static_cast<double>(value);
+        if (std::isfinite(d_val) && ((0.0 != d_val) || (0.0L == value))) {
+            char buf[32];
+            const char* end = mgjson_dtoa::to_chars(buf, d_val);
+            str_value_ = string_type(buf, static_cast<int>(end - buf));
+            return;
+        }
+
+        char buf[number_chars_size];
+        str_value_ = string_type(buf, static_cast<int>(_long_double_chars(buf, value)));
+    }
+
+    static size_t _long_double_chars(char* buf, long double value)
+    {
+#ifdef _MSC_VER
+        int len = sprintf_s(buf, number_chars_size, "%.*Lg",
+                  std::numeric_limits<long double>::digits10 + 2, value);
+#else
+        int len = sprintf(buf, "%.*Lg",
+                std::numeric_limits<long double>::digits10 + 2, value);
+#endif
+        return static_cast<size_t>(len);
+    }
+
+    /* With MGJSON_STRICT_UTF8 invalid UTF-8 in strings passed by user is
+     * replaced with U+FFFD.
+     */
+    void _check_utf8()
+    {
+#ifdef MGJSON_STRICT_UTF8
+#   ifdef QT_CORE_LIB
+        const char* str = str_value_.constData();
+#   else
+        const char* str = str_value_.c_str();
+#   endif
+        const char* str_end = str + str_value_.size();
+        const char* bad = mgjson_utf8::validate(str, str_end);
+        if (str_end != bad) {
+            mgjson_utf8::make_valid(str_value_, static_cast<size_t>(bad - str));
+        }
+#endif
+    }
+
+    /* Returns false if value is not integer of long long (or, when
+     * positive, unsigned long long) range, i.e. has to be Double.
+     */
+    static bool _decimal_values(const mgjson_number::decimal& value, bool& b_val,
+                                unsigned long long& i_val, long double& d_val)
+    {
+        if (mgjson_number::to_integer(value, i_val)
+            && (!value.negative || (i_val >= (1ULL << 63)) || (0 == i_val))) {
+            d_val = value.negative
+                    ? -static_cast<long double>(0ULL - i_val)
+                    : static_cast<long double>(i_val);
+            b_val = (0 != i_val);
+            return true;
+        }
+        d_val = mgjson_number::to_long_double(value);
+        i_val = _clamp_to_integer(d_val);
+        b_val = (0.0L != d_val);
+        return false;
+    }
+
+    /* Lexeme was checked by parser, so scan can't fail.
+     */
+    void _raw_values(bool& b_val, unsigned long long& i_val, long double& d_val) const
+    {
+#ifdef QT_CORE_LIB
+        const char* str = str_value_.constData();
+#else
+        const char* str = str_value_.c_str();
+#endif
+        mgjson_number::decimal dec;
+        mgjson_number::scan(str, str + str_value_.size(), dec);
+        _decimal_values(dec, b_val, i_val, d_val);
+    }
+
+    /* Text of scalar made by type only (zero or false value).
+     */
+    static const char* _type_text(mgjson::json_type type)
+    {
+        switch (type) {
+        case mgjson::Null:
+            return "null";
+        case mgjson::Bool:
+            return "false";
+        case mgjson::Integer:
+        case mgjson::Double:
+            return "0";
+        default:
+            return "";
+        }
+    }
+
+    static unsigned long long _clamp_to_integer(long double value)
+    {
+        if (0.0 > value) {
+            if (static_cast<long double>(std::numeric_limits<long long>::min()) > value) {
+                return static_cast<unsigned long long>(std::numeric_limits<long long>::min());
+            }
+            return static_cast<unsigned long long>(static_cast<long long>(value));
+        }
+        if (static_cast<long double>(std::numeric_limits<unsigned long long>::max()) < value) {
+            return std::numeric_limits<unsigned long long>::max();
+        }
+        return static_cast<unsigned long long>(value);
+    }
+
+    void _update_values_from_string()
+    {
+#ifdef MGJSON_AUTOCAST_STRING_VALUES
+#   ifdef QT_CORE_LIB
+        const char* str = str_value_.constData();
+#   else
+        const char* str = str_value_.c_str();
+#   endif
+        const char* str_end = str + str_value_.size();
+        if (strlen(str) != static_cast<size_t>(str_value_.size())) {
+            return;     // Never cast strings with zeros
+        }
+        if ((0 == qstricmp("0", str)) || (0 == qstricmp("off", str))
+            || (0 == qstricmp("false", str))) {
+            return;
+        }
+        if ((0 == qstricmp("on", str)) || (0 == qstricmp("true", str))) {
+            b_value_ = true;
+            i_value_ = 1;
+            d_value_ = 1.0;
+            return;
+        }
+
+        // Plain decimal numbers are handled by number engine, other forms
+        // (hexadecimal, octal, leading spaces etc.) by strtoull()/strtold().
+        mgjson_number::decimal dec;
+        if ((mgjson_number::Ok == mgjson_number::scan(str, str_end, dec, true))
+            && (str_end == dec.end)) {
+            unsigned long long i_val;
+            if (mgjson_number::to_integer(dec, i_val)) {
+                i_value_ = i_val;
+                d_value_ = dec.negative
+                        ? -static_cast<long double>(0ULL - i_val)
+                        : static_cast<long double>(i_val);
+            }
+            else {
+                d_value_ = mgjson_number::to_long_double(dec);
+                i_value_ = dec.is_integer
+                        ? std::numeric_limits<unsigned long long>::max()
+                        : _clamp_to_integer(d_value_);
+            }
+            b_value_ = (0 != i_value_);
+            return;
+        }
+
+        char* endptr;
+        bool i_value_set = false;
+        unsigned long long i_val = strtoull(str, &endptr, 0);
+        if (str_end == endptr) {
+            i_value_ = i_val;
+            i_value_set = true;
+        }
+        long double d_val = mgjson_number::strtold_c(str, &endptr);
+        if (str_end == endptr) {
+            d_value_ = d_val;
+            if (!i_value_set) {
+                i_value_ = _clamp_to_integer(d_val);
+            }
+        } else if (i_value_set) {
+            d_value_ = static_cast<long double>(i_value_);
+        }
+        b_value_ = (0 != i_value_);
+#endif
+    }
+
+public:
+    struct Key {
+        explicit Key(const char* key) :
+            d(qstrdup(key))
+        {
+            assert(nullptr != key);
+        }
+
+        explicit Key(const Key& other) :
+            d(qstrdup(other.d))
+        {
+            assert(nullptr != other.d);
+        }
+
+        explicit Key(Key&& other) :
+            d(other.d)
+        {
+            assert(nullptr != other.d);
+            other.d = nullptr;
+        }
+
+        ~Key()
+        {
+            delete[] d;
+        }
+
+        bool operator <(const Key& other) const
+        {
+            return (strcmp(d, other.d) < 0);
+        }
+        char *d;
+    };
+
+public:
+    mgjson::json_type type_;
+    bool raw_number_;           // Number with lexeme only, see decimal constructor.
+    bool raw_json_;             // str_value_ is JSON text of node.
+    mutable std::atomic<bool> expand_pending_;
+    mutable std::atomic<unsigned long long> hash_;  // 0 until computed.
+    bool refs_given_;           // See writable_parent().
+    mutable std::atomic<unsigned long long> hash_generation_;   // Of hash_, see hash().
+    std::shared_ptr<const mgjson_image> image_;     // Image node is read from, see in_image().
+    uint32_t image_ref_;        // Record of node in image_.
+    bool b_value_;
+    unsigned long long i_value_;
+    long double d_value_;
+    string_type str_value_;
+    std::vector<mgjson> array_;
+    std::map<Key,mgjson> map_;
+
+    static std::atomic<unsigned long long> write_generation_;   // Changes of hashed nodes.
+};
+
+#endif // _MGJSON_PRIVATE_H_INCLUDED_
@@ -0,0 +1,168 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+#include "mgjson_projection.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+
+typedef mgjson_projection::node node;
+
+void select_whole(node& n)
+{
+    n.whole = true;
+    n.fields.clear();
+    n.any.reset();
+}
+
+node& child(std::unique_ptr<node>& ptr)
+{
+    if (!ptr) {
+        ptr.reset(new node());
+    }
+    return *ptr;
+}
+
+void add_path(node& root, const char* path)
+{
+    if (nullptr == path) {
+        throw std::invalid_argument("mgjson_projection: path can't be null!");
+    }
+    node* n = &root;
+    if (0 == *path) {
+        select_whole(root);
+        return;
+    }
+    if ('/' != *path) {
+        throw std::invalid_argument("mgjson_projection: path must start with '/'!");
+    }
+
+    while ((0 != *path) && !n->whole) {
+        ++path;
+        std::string segment;
+        for (; (0 != *path) && ('/' != *path); ++path) {
+            if ('~' != *path) {
+                segment.push_back(*path);
+            }
+            else if ('0' == path[1]) {
+                segment.push_back('~');
+                ++path;
+            }
+            else if ('1' == path[1]) {
+                segment.push_back('/');
+                ++path;
+            }
+            else {
+                throw std::invalid_argument("mgjson_projection: invalid escape sequence in path!");
+            }
+        }
+        n = ("*" == segment) ? &child(n->any) : &child(n->fields[segment]);
+    }
+    if (!n->whole) {
+        select_whole(*n);
+    }
+}
+
+void merge(node& dst, const node& src)
+{
+    if (dst.whole) {
+        return;
+    }
+    if (src.whole) {
+        select_whole(dst);
+        return;
+    }
+    for (const auto& field : src.fields) {
+        merge(child(dst.fields[field.first]), *field.second);
+    }
+    if (src.any) {
+        merge(child(dst.any), *src.any);
+    }
+}
+
+/* Named children also get paths going through "*", so parser has to look
+ * only at one node per value.
+ */
+void propagate_any(node& n)
+{
+    if (n.any) {
+        for (auto& field : n.fields) {
+            merge(*field.second, *n.any);
+        }
+        propagate_any(*n.any);
+    }
+    for (auto& field : n.fields) {
+        propagate_any(*field.second);
+    }
+}
+
+/* Index of array what segment names: decimal number without leading zeros
+ * (as std::to_string() writes it).
+ */
+bool segment_index(const std::string& segment, size_t& index)
+{
+    if (segment.empty() || (('0' == segment[0]) && (1 != segment.size()))) {
+        return false;
+    }
+    index = 0;
+    for (char c : segment) {
+        if (('0' > c) || ('9' < c)) {
+            return false;
+        }
+        const size_t digit = static_cast<size_t>(c - '0');
+        if (index > (std::numeric_limits<size_t>::max() - digit) / 10) {
+            return false;
+        }
+        index = index * 10 + digit;
+    }
+    return true;
+}
+
+/* Fills names and indexes of nodes, see mgjson_projection::node.
+ */
+void index_fields(node& n)
+{
+    n.names.clear();
+    n.indexes.clear();
+    for (auto it = n.fields.cbegin(); n.fields.cend() != it; ++it) {
+        n.names.push_back(it);
+        size_t index;
+        if (segment_index(it->first, index)) {
+            n.indexes[index] = it->second.get();
+        }
+        index_fields(*it->second);
+    }
+    if (n.any) {
+        index_fields(*n.any);
+    }
+}
+
+}   // namespace
+
+mgjson_projection::mgjson_projection(std::initializer_list<const char*> paths)
+{
+    std::shared_ptr<node> root(new node());
+    for (const char* path : paths) {
+        add_path(*root, path);
+    }
+    propagate_any(*root);
+    index_fields(*root);
+    root_ = root;
+}
+
+mgjson_projection::mgjson_projection(const std::vector<std::string>& paths)
+{
+    std::shared_ptr<node> root(new node());
+    for (const std::string& path : paths) {
+        add_path(*root, path.c_str());
+    }
+    propagate_any(*root);
+    index_fields(*root);
+    root_ = root;
+}
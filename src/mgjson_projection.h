@@ -0,0 +1,60 @@
+#pragma once
+#ifndef _MGJSON_PROJECTION_H_INCLUDED_
+#define _MGJSON_PROJECTION_H_INCLUDED_
+
+#include "mgjson.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Paths of projection merged into a tree. Node with `whole` set selects its
+ * entire value; otherwise only children listed in `fields` (by name or
+ * array index) or matched by `any`.
+ *
+ * Parser looks children up by names and indexes of input, so find() makes
+ * no strings: `names` (filled with `indexes` by mgjson_projection, from
+ * `fields`) are searched by raw key bytes, `indexes` hold fields named by
+ * decimal numbers.
+ */
+struct mgjson_projection::node
+{
+    typedef std::map<std::string, std::unique_ptr<node>> field_map;
+
+    node() : whole(false) {}
+
+    const node* find(const char* name, size_t len) const
+    {
+        if (!names.empty()) {
+            auto it = std::lower_bound(names.begin(), names.end(), len,
+                                       [name](field_map::const_iterator field, size_t size) {
+                return 0 > field->first.compare(0, std::string::npos, name, size);
+            });
+            if ((names.end() != it) && (0 == (*it)->first.compare(0, std::string::npos, name, len))) {
+                return (*it)->second.get();
+            }
+        }
+        return any.get();
+    }
+
+    const node* find(size_t index) const
+    {
+        if (!indexes.empty()) {
+            auto it = indexes.find(index);
+            if (indexes.end() != it) {
+                return it->second;
+            }
+        }
+        return any.get();
+    }
+
+    bool whole;
+    field_map fields;
+    std::unique_ptr<node> any;
+    std::vector<field_map::const_iterator> names;   // Of fields, in the same order.
+    std::map<size_t, const node*> indexes;
+};
+
+#endif // _MGJSON_PROJECTION_H_INCLUDED_
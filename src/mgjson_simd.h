@@ -0,0 +1,256 @@
+#pragma once
+#ifndef _MGJSON_SIMD_H_INCLUDED_
+#define _MGJSON_SIMD_H_INCLUDED_
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#   define MGJSON_SIMD_SSE2
+#   include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#   include <intrin.h>
+#endif
+
+/* Byte scanning helpers. Input is processed in 64-byte blocks, each block
+ * is reduced to a bit mask (bit N set means byte N matches), so callers walk
+ * over matches with count_trailing_zeros() instead of checking every byte.
+ * Without SSE2 the masks are built by plain loop.
+ */
+namespace mgjson_simd
+{
+
+static const size_t block_size = 64;
+
+inline unsigned count_trailing_zeros(uint64_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+#   ifdef _M_X64
+    _BitScanForward64(&index, mask);
+    return static_cast<unsigned>(index);
+#   else
+    if (_BitScanForward(&index, static_cast<unsigned long>(mask))) {
+        return static_cast<unsigned>(index);
+    }
+    _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+    return static_cast<unsigned>(index) + 32;
+#   endif
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+inline unsigned count_leading_zeros(uint64_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+#   ifdef _M_X64
+    _BitScanReverse64(&index, mask);
+    return 63 - static_cast<unsigned>(index);
+#   else
+    if (_BitScanReverse(&index, static_cast<unsigned long>(mask >> 32))) {
+        return 31 - static_cast<unsigned>(index);
+    }
+    _BitScanReverse(&index, static_cast<unsigned long>(mask));
+    return 63 - static_cast<unsigned>(index);
+#   endif
+#else
+    return static_cast<unsigned>(__builtin_clzll(mask));
+#endif
+}
+
+inline unsigned count_ones(uint64_t mask)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<unsigned>(__popcnt64(mask));
+#elif defined(_MSC_VER)
+    return static_cast<unsigned>(__popcnt(static_cast<unsigned>(mask))
+                                 + __popcnt(static_cast<unsigned>(mask >> 32)));
+#else
+    return static_cast<unsigned>(__builtin_popcountll(mask));
+#endif
+}
+
+inline uint64_t clear_lowest_bit(uint64_t mask)
+{
+    return mask & (mask - 1);
+}
+
+/* Bit N of result is XOR of bits 0..N of x.
+ */
+inline uint64_t prefix_xor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/* 64 bytes loaded once and compared many times.
+ */
+class block
+{
+public:
+    explicit inline block(const char* p)
+#ifdef MGJSON_SIMD_SSE2
+    {
+        v_[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        v_[1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+        v_[2] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+        v_[3] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48));
+    }
+#else
+        : p_(p)
+    {
+    }
+#endif
+
+    inline uint64_t eq(char c) const
+    {
+#ifdef MGJSON_SIMD_SSE2
+        const __m128i v = _mm_set1_epi8(c);
+        return combine(_mm_cmpeq_epi8(v_[0], v), _mm_cmpeq_epi8(v_[1], v),
+                       _mm_cmpeq_epi8(v_[2], v), _mm_cmpeq_epi8(v_[3], v));
+#else
+        uint64_t mask = 0;
+        for (size_t i = 0; i < block_size; ++i) {
+            if (c == p_[i]) {
+                mask |= (1ULL << i);
+            }
+        }
+        return mask;
+#endif
+    }
+
+    /* Mask of bytes with high bit set, i.e. non-ASCII.
+     */
+    inline uint64_t non_ascii() const
+    {
+#ifdef MGJSON_SIMD_SSE2
+        return combine(v_[0], v_[1], v_[2], v_[3]);
+#else
+        uint64_t mask = 0;
+        for (size_t i = 0; i < block_size; ++i) {
+            if (0 != (0x80 & p_[i])) {
+                mask |= (1ULL << i);
+            }
+        }
+        return mask;
+#endif
+    }
+
+private:
+#ifdef MGJSON_SIMD_SSE2
+    static inline uint64_t combine(__m128i m0, __m128i m1, __m128i m2, __m128i m3)
+    {
+        return static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(m0)))
+            | (static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(m1))) << 16)
+            | (static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(m2))) << 32)
+            | (static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(m3))) << 48);
+    }
+
+    __m128i v_[4];
+#else
+    const char* p_;
+#endif
+};
+
+/* Mask of bytes equal to c in 64-byte block starting at p.
+ */
+inline uint64_t eq_mask(const char* p, char c)
+{
+    return block(p).eq(c);
+}
+
+/* Calls fn(const char* pos) for every occurrence of c in [p, end), in order.
+ */
+template <typename F>
+inline void for_each_byte(const char* p, const char* end, char c, F fn)
+{
+    for (; static_cast<size_t>(end - p) >= block_size; p += block_size) {
+        for (uint64_t mask = eq_mask(p, c); 0 != mask; mask = clear_lowest_bit(mask)) {
+            fn(p + count_trailing_zeros(mask));
+        }
+    }
+    for (; p < end; ++p) {
+        if (c == *p) {
+            fn(p);
+        }
+    }
+}
+
+/* Returns pointer to the first byte in [p, end) what ends plain run of JSON
+ * string: quote, backslash or control character (and any non-ASCII byte if
+ * stop_non_ascii is set), or end if there is no such byte. Same bytes have
+ * to be escaped when string is written, so the function serves both ways.
+ */
+inline const char* find_string_special(const char* p, const char* end, bool stop_non_ascii)
+{
+#ifdef MGJSON_SIMD_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    const int high_mask = stop_non_ascii ? 0xFFFF : 0;
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i special = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                    _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+        int mask = _mm_movemask_epi8(special) | (_mm_movemask_epi8(v) & high_mask);
+        if (0 != mask) {
+            return p + count_trailing_zeros(static_cast<uint64_t>(mask));
+        }
+    }
+#endif
+    for (; end != p; ++p) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (('"' == c) || ('\\' == c) || (0x20 > c) || (stop_non_ascii && (0x80 <= c))) {
+            return p;
+        }
+    }
+    return end;
+}
+
+/* Finds non-backslash characters escaped by backslash, i.e. preceded by
+ * odd-length run of backslashes. Runs crossing block boundary are carried
+ * in state.
+ */
+class escape_scanner
+{
+public:
+    inline escape_scanner() : prev_odd_(0) {}
+
+    inline uint64_t next(uint64_t backslash)
+    {
+        const uint64_t even_bits = 0x5555555555555555ULL;
+        const uint64_t odd_bits = ~even_bits;
+        if ((0 == backslash) && (0 == prev_odd_)) {
+            return 0;
+        }
+        uint64_t start_edges = backslash & ~(backslash << 1);
+        uint64_t even_start_mask = even_bits ^ prev_odd_;
+        uint64_t even_starts = start_edges & even_start_mask;
+        uint64_t odd_starts = start_edges & ~even_start_mask;
+        uint64_t even_carries = backslash + even_starts;
+        uint64_t odd_carries = backslash + odd_starts;
+        bool ends_odd = (odd_carries < backslash);
+        odd_carries |= prev_odd_;
+        prev_odd_ = ends_odd ? 1 : 0;
+        uint64_t even_carry_ends = even_carries & ~backslash;
+        uint64_t odd_carry_ends = odd_carries & ~backslash;
+        return (even_carry_ends & odd_bits) | (odd_carry_ends & even_bits);
+    }
+
+private:
+    uint64_t prev_odd_;
+};
+
+}   // namespace mgjson_simd
+
+#endif // _MGJSON_SIMD_H_INCLUDED_
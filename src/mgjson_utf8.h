@@ -0,0 +1,120 @@
+#pragma once
+#ifndef _MGJSON_UTF8_H_INCLUDED_
+#define _MGJSON_UTF8_H_INCLUDED_
+
+#include "mgjson_simd.h"
+
+#include <cstddef>
+
+/* UTF-8 validation. ASCII runs are skipped 64 bytes at a time; multibyte
+ * sequences are checked against table 3-7 of the Unicode standard, so
+ * overlong forms, surrogates and code points above U+10FFFF are rejected.
+ */
+namespace mgjson_utf8
+{
+
+/* Length of valid multibyte sequence starting at p (which must point to
+ * non-ASCII byte), or 0 if sequence is invalid or truncated.
+ */
+inline size_t sequence_length(const char* p, const char* end)
+{
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(p);
+    size_t avail = static_cast<size_t>(end - p);
+    unsigned char c = s[0];
+    unsigned char lo = 0x80, hi = 0xBF;
+    size_t len;
+    if ((0xC2 <= c) && (0xDF >= c)) {
+        len = 2;
+    }
+    else if ((0xE0 <= c) && (0xEF >= c)) {
+        len = 3;
+        if (0xE0 == c) {
+            lo = 0xA0;
+        }
+        else if (0xED == c) {
+            hi = 0x9F;
+        }
+    }
+    else if ((0xF0 <= c) && (0xF4 >= c)) {
+        len = 4;
+        if (0xF0 == c) {
+            lo = 0x90;
+        }
+        else if (0xF4 == c) {
+            hi = 0x8F;
+        }
+    }
+    else {
+        return 0;
+    }
+
+    if ((avail < 2) || (lo > s[1]) || (hi < s[1])) {
+        return 0;
+    }
+    for (size_t i = 2; i < len; ++i) {
+        if ((avail <= i) || (0x80 != (s[i] & 0xC0))) {
+            return 0;
+        }
+    }
+    return len;
+}
+
+/* Returns pointer to the first byte of the first invalid sequence in
+ * [p, end), or end if whole range is valid UTF-8.
+ */
+inline const char* validate(const char* p, const char* end)
+{
+    for (;;) {
+        while (static_cast<size_t>(end - p) >= mgjson_simd::block_size) {
+            uint64_t mask = mgjson_simd::block(p).non_ascii();
+            if (0 != mask) {
+                p += mgjson_simd::count_trailing_zeros(mask);
+                break;
+            }
+            p += mgjson_simd::block_size;
+        }
+        while ((end != p) && (0 == (0x80 & *p))) {
+            ++p;
+        }
+        if (end == p) {
+            return end;
+        }
+
+        // Multibyte text usually goes in runs, so stay in scalar loop until
+        // next ASCII character.
+        do {
+            size_t len = sequence_length(p, end);
+            if (0 == len) {
+                return p;
+            }
+            p += len;
+        } while ((end != p) && (0 != (0x80 & *p)));
+    }
+}
+
+/* Replaces every invalid byte with U+FFFD REPLACEMENT CHARACTER.
+ */
+template <typename String>
+void make_valid(String& str, size_t from)
+{
+    const char* data = str.data();
+    const char* end = data + str.size();
+    const char* p = data + from;
+    String result;
+    result.reserve(static_cast<int>(str.size()) + 8);
+    result.append(data, static_cast<int>(p - data));
+    while (end != p) {
+        const char* bad = validate(p, end);
+        result.append(p, static_cast<int>(bad - p));
+        if (end == bad) {
+            break;
+        }
+        result.append("\xEF\xBF\xBD", 3);
+        p = bad + 1;
+    }
+    str.swap(result);
+}
+
+}   // namespace mgjson_utf8
+
+#endif // _MGJSON_UTF8_H_INCLUDED_
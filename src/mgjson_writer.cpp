@@ -0,0 +1,886 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+#include "mgjson_private.h"
+#include "mgjson_image.h"
+#include "mgjson_simd.h"
+#include "mgjson_parallel.h"
+
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+
+/* Text goes to out; with sink it is used as buffer, passed to sink in
+ * chunks of about chunk_size bytes. With segments (see set_parallel())
+ * text is cut into pieces, what are to be joined in order. With pieces
+ * (see set_pieces()) long strings are not copied, but referenced.
+ */
+class json_writer
+{
+public:
+    json_writer(std::string& out, mgjson::json_format format,
+                const mgjson::json_sink* sink = nullptr, size_t chunk_size = 0) :
+        out_(out),
+        flags_(format),
+        format_(writer_format(format)),
+        indented_(0 != (format_ & mgjson::Indented)),
+        line_start_(static_cast<long long>(out.size())),
+        sink_(sink),
+        chunk_size_(chunk_size),
+        ok_(true),
+        segments_(nullptr),
+        threads_(1),
+        pieces_(nullptr),
+        piece_start_(out.size())
+    {
+    }
+
+    /* Part of output: text of out (when ref is nullptr) or referenced
+     * string.
+     */
+    struct piece
+    {
+        const char* ref;
+        size_t begin;
+        size_t size;
+    };
+
+    /* String values and raw JSON of at least reference_min bytes, what
+     * need no escaping, are added to pieces as references; other text
+     * is written into out and added as ranges of it.
+     */
+    void set_pieces(std::vector<piece>* pieces)
+    {
+        pieces_ = pieces;
+    }
+
+    /* Arrays and objects with many elements are written by threads, in
+     * chunks; every chunk becomes a segment.
+     */
+    void set_parallel(unsigned threads, std::vector<std::string>* segments)
+    {
+        threads_ = mgjson_parallel::threads_count(threads);
+        segments_ = segments;
+    }
+
+    /* Returns false if sink refused data.
+     */
+    bool write(const mgjson& value)
+    {
+        write_value(*mgjson_private::get(value), 0);
+        if (nullptr != sink_) {
+            flush();
+        }
+        if (nullptr != segments_) {
+            cut();
+        }
+        if ((nullptr != pieces_) && (out_.size() > piece_start_)) {
+            pieces_->push_back({nullptr, piece_start_, out_.size() - piece_start_});
+        }
+        return ok_;
+    }
+
+private:
+    struct field
+    {
+        const char* key;
+        size_t key_len;
+        const mgjson_private* value;
+    };
+
+    static const long long line_width = 80;
+    static const int indent_width = 4;
+    static const size_t parallel_grain = 512;
+    static const size_t reference_min = 256;
+
+    /* Called only where nothing written can be taken back.
+     */
+    inline void flush_chunk()
+    {
+        if ((nullptr != sink_) && (out_.size() >= chunk_size_)) {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        if (ok_ && !out_.empty()) {
+            ok_ = (*sink_)(out_.data(), out_.size());
+        }
+        line_start_ -= static_cast<long long>(out_.size());
+        out_.clear();
+    }
+
+    /* Text written so far becomes segment.
+     */
+    void cut()
+    {
+        line_start_ -= static_cast<long long>(out_.size());
+        segments_->push_back(std::move(out_));
+        out_.clear();
+    }
+
+    inline bool can_reference(size_t size) const
+    {
+        return (nullptr != pieces_) && (reference_min <= size);
+    }
+
+    /* Text is referenced; columns are counted as if it were written.
+     */
+    void reference(const char* p, size_t size)
+    {
+        if (out_.size() > piece_start_) {
+            pieces_->push_back({nullptr, piece_start_, out_.size() - piece_start_});
+        }
+        pieces_->push_back({p, 0, size});
+        piece_start_ = out_.size();
+        line_start_ -= static_cast<long long>(size);
+    }
+
+    inline bool in_parallel(size_t count) const
+    {
+        return (nullptr != segments_) && (1 < threads_) && (2 * parallel_grain <= count);
+    }
+
+    /* render(writer, begin, end) writes elements [begin, end) with writer;
+     * chunks are rendered by threads and added as segments in order.
+     */
+    template <typename F>
+    void write_in_parallel(size_t count, F render)
+    {
+        const size_t grain = std::max(parallel_grain, count / (8 * static_cast<size_t>(threads_)));
+        std::vector<std::string> chunks((count + grain - 1) / grain);
+        mgjson_parallel::for_each_range(count, grain, threads_, [&](size_t begin, size_t end) {
+            json_writer writer(chunks[begin / grain], flags_);
+            render(writer, begin, end);
+        });
+        cut();
+        for (std::string& chunk : chunks) {
+            segments_->push_back(std::move(chunk));
+        }
+    }
+
+public:
+    /* Canonical format is compact whatever other flags are.
+     */
+    static inline unsigned writer_format(mgjson::json_format format)
+    {
+        const unsigned flags = static_cast<unsigned>(format);
+        return (0 != (flags & mgjson::Canonical)) ? static_cast<unsigned>(mgjson::Canonical) : flags;
+    }
+
+private:
+    inline bool has(mgjson::json_format_flags flag) const
+    {
+        return (0 != (format_ & flag));
+    }
+
+    static inline bool is_compound(const mgjson_private& node)
+    {
+        return (mgjson::Array == node.type_) || (mgjson::Object == node.type_);
+    }
+
+    inline void append(const mgjson_private::string_type& str)
+    {
+#ifdef QT_CORE_LIB
+        out_.append(str.constData(), static_cast<size_t>(str.size()));
+#else
+        out_.append(str);
+#endif
+    }
+
+    /* Column counts tab as indent_width characters.
+     */
+    inline long long column() const
+    {
+        return static_cast<long long>(out_.size()) - line_start_;
+    }
+
+    void newline(int level)
+    {
+        out_.push_back('\n');
+        if (has(mgjson::UseSpaces)) {
+            out_.append(static_cast<size_t>(level * indent_width), ' ');
+        }
+        else {
+            out_.append(static_cast<size_t>(level), '\t');
+        }
+        line_start_ = static_cast<long long>(out_.size()) - level * indent_width;
+    }
+
+    void write_value(const mgjson_private& node, int level)
+    {
+        if (!ok_) {
+            return;
+        }
+        flush_chunk();
+        if (node.raw_json_) {
+            if (!has(mgjson::Canonical)) {
+                if (can_reference(static_cast<size_t>(node.str_value_.size()))) {
+                    reference(node.str_value_.data(), static_cast<size_t>(node.str_value_.size()));
+                }
+                else {
+                    append(node.str_value_);
+                }
+                return;
+            }
+        }
+        if (!node.in_image()) {
+            node.expand();
+        }
+        switch (node.type_) {
+        case mgjson::Array:
+            write_array(node, level);
+            break;
+        case mgjson::Object:
+            write_object(node, level);
+            break;
+        case mgjson::String:
+            if (indented_ && has(mgjson::SplitStrings)) {
+                write_split_string(node.str_value_.data(), static_cast<size_t>(node.str_value_.size()),
+                                   level);
+            }
+            else {
+                write_string_value(node.str_value_.data(), static_cast<size_t>(node.str_value_.size()));
+            }
+            break;
+        default:
+            write_scalar(node);
+            break;
+        }
+    }
+
+    void write_scalar(const mgjson_private& node)
+    {
+        switch (node.type_) {
+        case mgjson::Bool:
+            append(node.str_value_);
+            break;
+        case mgjson::Integer:
+        case mgjson::Double:
+            if (has(mgjson::Canonical)) {
+                write_canonical_number(node);
+            }
+            else if ((mgjson::Integer == node.type_) || node.raw_number_ || std::isfinite(node.d_value_)) {
+                append(node.str_value_);
+            }
+            else {
+                out_.append("null", 4);
+            }
+            break;
+        case mgjson::String:
+            write_string(node.str_value_.data(), static_cast<size_t>(node.str_value_.size()));
+            break;
+        default:
+            out_.append("null", 4);
+            break;
+        }
+    }
+
+    void write_canonical_number(const mgjson_private& node)
+    {
+        char buf[mgjson_private::number_chars_size];
+        const size_t len = node.canonical_number(buf);
+        if (0 != len) {
+            out_.append(buf, len);
+        }
+        else {
+            out_.append("null", 4);
+        }
+    }
+
+    void write_escape(char c)
+    {
+        static const char hex[] = "0123456789abcdef";
+        out_.push_back('\\');
+        switch (c) {
+        case '"':  out_.push_back('"'); break;
+        case '\\': out_.push_back('\\'); break;
+        case '\b': out_.push_back('b'); break;
+        case '\f': out_.push_back('f'); break;
+        case '\n': out_.push_back('n'); break;
+        case '\r': out_.push_back('r'); break;
+        case '\t': out_.push_back('t'); break;
+        default:
+            out_.append("u00", 3);
+            out_.push_back(hex[(c >> 4) & 0x0F]);
+            out_.push_back(hex[c & 0x0F]);
+            break;
+        }
+    }
+
+    /* Runs without characters to escape are copied at once.
+     */
+    void write_string(const char* p, size_t size)
+    {
+        const char* end = p + size;
+        out_.push_back('"');
+        for (;;) {
+            const char* special = mgjson_simd::find_string_special(p, end, false);
+            out_.append(p, static_cast<size_t>(special - p));
+            if (end == special) {
+                break;
+            }
+            write_escape(*special);
+            p = special + 1;
+        }
+        out_.push_back('"');
+    }
+
+    void write_string_value(const char* p, size_t size)
+    {
+        if (can_reference(size) && (p + size == mgjson_simd::find_string_special(p, p + size, false))) {
+            out_.push_back('"');
+            reference(p, size);
+            out_.push_back('"');
+        }
+        else {
+            write_string(p, size);
+        }
+    }
+
+    /* Multiline string is written as adjacent literals, one per line;
+     * parser joins them back with JoinStrings.
+     */
+    void write_split_string(const char* p, size_t size, int level)
+    {
+        const char* end = p + size;
+        for (;;) {
+            const char* eol = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            if ((nullptr == eol) || (end == eol + 1)) {
+                write_string_value(p, static_cast<size_t>(end - p));
+                return;
+            }
+            write_string(p, static_cast<size_t>(eol + 1 - p));
+            newline(level + 1);
+            p = eol + 1;
+        }
+    }
+
+    /* Image is read without expanding, see mgjson_image::items().
+     */
+    void write_array(const mgjson_private& array, int level)
+    {
+        std::unique_ptr<mgjson_private> copy;
+        const std::vector<mgjson>& items = mgjson_image::items(array, copy).array_;
+        if (items.empty()) {
+            out_.push_back('[');
+            if (indented_ && !has(mgjson::InlineEmptyArrays)) {
+                newline(level);
+            }
+            out_.push_back(']');
+            return;
+        }
+
+        if (indented_ && (has(mgjson::InlineSimpleArrays) || has(mgjson::SplitSimpleArrays))
+            && is_simple(items)) {
+            write_simple_array(items, level);
+            return;
+        }
+
+        out_.push_back('[');
+        if (in_parallel(items.size())) {
+            write_in_parallel(items.size(), [&](json_writer& writer, size_t begin, size_t end) {
+                writer.write_items(items, begin, end, level);
+            });
+        }
+        else {
+            write_items(items, 0, items.size(), level);
+        }
+        if (indented_) {
+            newline(level);
+        }
+        out_.push_back(']');
+    }
+
+    /* Elements [begin, end) of array, except of simple one in indented
+     * format.
+     */
+    void write_items(const std::vector<mgjson>& items, size_t begin, size_t end, int level)
+    {
+        for (size_t i = begin; i < end; ++i) {
+            if (0 != i) {
+                out_.push_back(',');
+            }
+            if (indented_) {
+                newline(level + 1);
+            }
+            write_value(*mgjson_private::get(items[i]), level + 1);
+        }
+    }
+
+    static bool is_simple(const std::vector<mgjson>& items)
+    {
+        for (const mgjson& item : items) {
+            if (is_compound(*mgjson_private::get(item))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* Array of scalars is written in one line (InlineSimpleArrays), or, if
+     * the line is too long or not allowed, wrapped at line_width
+     * (SplitSimpleArrays). One line attempt stops as soon as it's too long.
+     */
+    void write_simple_array(const std::vector<mgjson>& items, int level)
+    {
+        if (has(mgjson::InlineSimpleArrays)) {
+            const bool split = has(mgjson::SplitSimpleArrays);
+            size_t mark = out_.size();
+            out_.push_back('[');
+            size_t i = 0;
+            for (; (i < items.size()) && (!split || (line_width >= column())); ++i) {
+                if (0 != i) {
+                    out_.append(", ", 2);
+                }
+                write_scalar(*mgjson_private::get(items[i]));
+                if (!split) {
+                    flush_chunk();
+                }
+            }
+            if (items.size() == i) {
+                out_.push_back(']');
+                if (!split || (line_width >= column())) {
+                    return;
+                }
+            }
+            out_.resize(mark);
+        }
+
+        out_.push_back('[');
+        newline(level + 1);
+        long long first_column = column();
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (0 == i) {
+                write_scalar(*mgjson_private::get(items[i]));
+                continue;
+            }
+            out_.push_back(',');
+            size_t mark = out_.size();
+            out_.push_back(' ');
+            write_scalar(*mgjson_private::get(items[i]));
+            if ((line_width < column())
+                && (first_column < static_cast<long long>(mark) - line_start_)) {
+                // Space before item becomes line break, item is moved in place.
+                const bool spaces = has(mgjson::UseSpaces);
+                const size_t indent = static_cast<size_t>(spaces ? (level + 1) * indent_width : level + 1);
+                out_.replace(mark, 1, indent + 1, spaces ? ' ' : '\t');
+                out_[mark] = '\n';
+                line_start_ = static_cast<long long>(mark + 1 + indent) - (level + 1) * indent_width;
+            }
+            flush_chunk();
+        }
+        newline(level);
+        out_.push_back(']');
+    }
+
+    void write_object(const mgjson_private& object, int level)
+    {
+        std::unique_ptr<mgjson_private> copy;
+        const mgjson_private& node = mgjson_image::items(object, copy);
+        if (node.map_.empty()) {
+            out_.push_back('{');
+            if (indented_ && !has(mgjson::InlineEmptyObjects)) {
+                newline(level);
+            }
+            out_.push_back('}');
+            return;
+        }
+
+        out_.push_back('{');
+        if (in_parallel(node.map_.size())) {
+            write_fields_in_parallel(node, level);
+        }
+        else if (indented_ && (has(mgjson::AlignObjects) || has(mgjson::SimpleFieldsFirst))) {
+            write_fields_by_layout(node, level);
+        }
+        else {
+            bool first = true;
+            for (const auto& item : node.map_) {
+                const mgjson_private& child = *mgjson_private::get(item.second);
+                if (mgjson::Undefined != child.type_) {
+                    write_field(first, item.first.d, strlen(item.first.d), 0, child, level);
+                }
+            }
+        }
+        if (indented_) {
+            newline(level);
+        }
+        out_.push_back('}');
+    }
+
+    void write_field(bool& first, const char* key, size_t key_len, size_t key_width,
+                     const mgjson_private& value, int level)
+    {
+        if (!first) {
+            out_.push_back(',');
+        }
+        first = false;
+
+        if (indented_) {
+            newline(level + 1);
+        }
+        write_string(key, key_len);
+        out_.push_back(':');
+        if (indented_) {
+            if (key_width > key_len) {
+                out_.append(key_width - key_len, ' ');
+            }
+            out_.push_back(' ');
+        }
+        write_value(value, level + 1);
+    }
+
+    /* Layout of object depends only on its fields: one pass over map
+     * collects them (with key lengths and widest key), writing then goes
+     * over collected fields. So each node is visited once whatever flags
+     * are.
+     */
+    void write_fields_by_layout(const mgjson_private& node, int level)
+    {
+        if (fields_.size() <= static_cast<size_t>(level)) {
+            fields_.resize(static_cast<size_t>(level) + 1);
+        }
+        std::vector<field>& fields = fields_[static_cast<size_t>(level)];
+        const size_t key_width = collect_fields(node, fields);
+
+        // With SimpleFieldsFirst scalar fields are written at first pass,
+        // compound ones at second.
+        bool simple_first = has(mgjson::SimpleFieldsFirst);
+        bool first = true;
+        for (int pass = simple_first ? 0 : 1; pass < 2; ++pass) {
+            for (const field& f : fields) {
+                if (!simple_first || (is_compound(*f.value) == (1 == pass))) {
+                    write_field(first, f.key, f.key_len, key_width, *f.value, level);
+                }
+            }
+        }
+    }
+
+    void write_fields_in_parallel(const mgjson_private& node, int level)
+    {
+        std::vector<field> fields;
+        const size_t key_width = collect_fields(node, fields);
+        if (indented_ && has(mgjson::SimpleFieldsFirst)) {
+            std::vector<field> ordered;
+            ordered.reserve(fields.size());
+            for (int pass = 0; pass < 2; ++pass) {
+                for (const field& f : fields) {
+                    if (is_compound(*f.value) == (1 == pass)) {
+                        ordered.push_back(f);
+                    }
+                }
+            }
+            fields.swap(ordered);
+        }
+        write_in_parallel(fields.size(), [&](json_writer& writer, size_t begin, size_t end) {
+            bool first = (0 == begin);
+            for (size_t i = begin; i < end; ++i) {
+                const field& f = fields[i];
+                writer.write_field(first, f.key, f.key_len, key_width, *f.value, level);
+            }
+        });
+    }
+
+    /* Defined fields of object; returns width of keys to align to.
+     */
+    size_t collect_fields(const mgjson_private& node, std::vector<field>& fields) const
+    {
+        fields.clear();
+        size_t key_width = 0;
+        for (const auto& item : node.map_) {
+            const mgjson_private* child = mgjson_private::get(item.second);
+            if (mgjson::Undefined != child->type_) {
+                field f = {item.first.d, strlen(item.first.d), child};
+                key_width = std::max(key_width, f.key_len);
+                fields.push_back(f);
+            }
+        }
+        return (indented_ && has(mgjson::AlignObjects)) ? key_width : 0;
+    }
+
+private:
+    std::string& out_;
+    const mgjson::json_format flags_;
+    const unsigned format_;
+    const bool indented_;
+    long long line_start_;
+    const mgjson::json_sink* const sink_;
+    const size_t chunk_size_;
+    bool ok_;
+    std::vector<std::vector<field>> fields_;    // Fields of objects being written, per level.
+    std::vector<std::string>* segments_;
+    unsigned threads_;
+    std::vector<piece>* pieces_;
+    size_t piece_start_;        // Start of text not yet added to pieces.
+};
+
+// Passed by reference to std::max(), so have to be defined.
+const size_t json_writer::parallel_grain;
+
+/* Size of text json_writer writes, counted without writing it: strings by
+ * their escapes, numbers by their text. Layouts with wrapping (SplitStrings
+ * and SplitSimpleArrays, see fits()) depend on columns, so are not counted.
+ */
+class json_size_counter
+{
+public:
+    explicit json_size_counter(mgjson::json_format format) :
+        format_(json_writer::writer_format(format)),
+        indented_(0 != (format_ & mgjson::Indented))
+    {
+    }
+
+    inline bool fits() const
+    {
+        return !indented_ || !(has(mgjson::SplitStrings) || has(mgjson::SplitSimpleArrays));
+    }
+
+    size_t value_size(const mgjson_private& node, int level) const
+    {
+        if (node.raw_json_ && !has(mgjson::Canonical)) {
+            return static_cast<size_t>(node.str_value_.size());
+        }
+        if (!node.in_image()) {
+            node.expand();
+        }
+        switch (node.type_) {
+        case mgjson::Array:
+            return array_size(node, level);
+        case mgjson::Object:
+            return object_size(node, level);
+        default:
+            return scalar_size(node);
+        }
+    }
+
+private:
+    inline bool has(mgjson::json_format_flags flag) const
+    {
+        return (0 != (format_ & flag));
+    }
+
+    inline size_t newline_size(int level) const
+    {
+        return 1 + static_cast<size_t>(has(mgjson::UseSpaces) ? level * 4 : level);
+    }
+
+    size_t scalar_size(const mgjson_private& node) const
+    {
+        switch (node.type_) {
+        case mgjson::Bool:
+            return static_cast<size_t>(node.str_value_.size());
+        case mgjson::Integer:
+        case mgjson::Double:
+            if (has(mgjson::Canonical)) {
+                char buf[mgjson_private::number_chars_size];
+                const size_t len = node.canonical_number(buf);
+                return (0 != len) ? len : 4;
+            }
+            if ((mgjson::Integer == node.type_) || node.raw_number_ || std::isfinite(node.d_value_)) {
+                return static_cast<size_t>(node.str_value_.size());
+            }
+            return 4;
+        case mgjson::String:
+            return string_size(node.str_value_.data(), static_cast<size_t>(node.str_value_.size()));
+        default:
+            return 4;
+        }
+    }
+
+    /* Quotes and escapes: six characters for control characters without
+     * short escape, two for other ones.
+     */
+    static size_t string_size(const char* p, size_t size)
+    {
+        const char* end = p + size;
+        size_t result = size + 2;
+        for (;;) {
+            p = mgjson_simd::find_string_special(p, end, false);
+            if (end == p) {
+                return result;
+            }
+            switch (*p) {
+            case '"':
+            case '\\':
+            case '\b':
+            case '\f':
+            case '\n':
+            case '\r':
+            case '\t':
+                result += 1;
+                break;
+            default:
+                result += 5;
+                break;
+            }
+            ++p;
+        }
+    }
+
+    size_t array_size(const mgjson_private& array, int level) const
+    {
+        std::unique_ptr<mgjson_private> copy;
+        const std::vector<mgjson>& items = mgjson_image::items(array, copy).array_;
+        if (items.empty()) {
+            return 2 + ((indented_ && !has(mgjson::InlineEmptyArrays)) ? newline_size(level) : 0);
+        }
+
+        size_t size = 2 + (items.size() - 1);
+        if (indented_ && has(mgjson::InlineSimpleArrays) && is_simple(items)) {
+            for (const mgjson& item : items) {
+                size += scalar_size(*mgjson_private::get(item));
+            }
+            return size + (items.size() - 1);   // Spaces after commas.
+        }
+        for (const mgjson& item : items) {
+            if (indented_) {
+                size += newline_size(level + 1);
+            }
+            size += value_size(*mgjson_private::get(item), level + 1);
+        }
+        return size + (indented_ ? newline_size(level) : 0);
+    }
+
+    static bool is_simple(const std::vector<mgjson>& items)
+    {
+        for (const mgjson& item : items) {
+            const mgjson::json_type type = mgjson_private::get(item)->type_;
+            if ((mgjson::Array == type) || (mgjson::Object == type)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* Order of fields (SimpleFieldsFirst) doesn't change size.
+     */
+    size_t object_size(const mgjson_private& object, int level) const
+    {
+        std::unique_ptr<mgjson_private> copy;
+        const mgjson_private& node = mgjson_image::items(object, copy);
+        if (node.map_.empty()) {
+            return 2 + ((indented_ && !has(mgjson::InlineEmptyObjects)) ? newline_size(level) : 0);
+        }
+
+        size_t count = 0;
+        size_t key_width = 0;
+        size_t key_total = 0;
+        size_t size = 2;
+        for (const auto& item : node.map_) {
+            const mgjson_private& child = *mgjson_private::get(item.second);
+            if (mgjson::Undefined == child.type_) {
+                continue;
+            }
+            const size_t key_len = strlen(item.first.d);
+            key_width = std::max(key_width, key_len);
+            key_total += key_len;
+            size += ((0 != count) ? 1 : 0) + string_size(item.first.d, key_len) + 1
+                    + value_size(child, level + 1);
+            if (indented_) {
+                size += newline_size(level + 1) + 1;
+            }
+            ++count;
+        }
+        if (indented_) {
+            if (has(mgjson::AlignObjects)) {
+                size += count * key_width - key_total;  // Keys are padded to the widest one.
+            }
+            size += newline_size(level);
+        }
+        return size;
+    }
+
+private:
+    const unsigned format_;
+    const bool indented_;
+};
+
+}   // namespace
+
+std::string
+mgjson::to_json(json_format format) const
+{
+    std::string result;
+    json_writer(result, format).write(*this);
+    return result;
+}
+
+void
+mgjson::to_json(std::string& out, json_format format) const
+{
+    json_writer(out, format).write(*this);
+}
+
+bool
+mgjson::to_json(const json_sink& sink, json_format format, size_t chunk_size) const
+{
+    std::string buffer;
+    buffer.reserve(chunk_size + chunk_size / 4);
+    return json_writer(buffer, format, &sink, chunk_size).write(*this);
+}
+
+std::string
+mgjson::to_json_parallel(json_format format, unsigned threads) const
+{
+    std::vector<std::string> segments;
+    std::string buffer;
+    json_writer writer(buffer, format);
+    writer.set_parallel(threads, &segments);
+    writer.write(*this);
+    if (1 == segments.size()) {
+        return std::move(segments.front());
+    }
+
+    size_t size = 0;
+    for (const std::string& segment : segments) {
+        size += segment.size();
+    }
+    std::string result;
+    result.reserve(size);
+    for (const std::string& segment : segments) {
+        result.append(segment);
+    }
+    return result;
+}
+
+void
+mgjson::to_json_segments(std::vector<json_segment>& segments, std::string& storage,
+                         json_format format) const
+{
+    std::vector<json_writer::piece> pieces;
+    storage.clear();
+    json_writer writer(storage, format);
+    writer.set_pieces(&pieces);
+    writer.write(*this);
+
+    segments.clear();
+    segments.reserve(pieces.size());
+    for (const json_writer::piece& p : pieces) {
+        json_segment segment = {(nullptr == p.ref) ? storage.data() + p.begin : p.ref, p.size};
+        segments.push_back(segment);
+    }
+}
+
+size_t
+mgjson::to_json_size(json_format format) const
+{
+    const json_size_counter counter(format);
+    if (counter.fits()) {
+        return counter.value_size(*d, 0);
+    }
+
+    size_t size = 0;
+    to_json([&size](const char*, size_t cb_data) {
+        size += cb_data;
+        return true;
+    }, format, 4096);
+    return size;
+}
@@ -0,0 +1,186 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+static std::string bytes(std::initializer_list<int> list)
+{
+    std::string result;
+    for (int c : list) {
+        result.push_back(static_cast<char>(c));
+    }
+    return result;
+}
+
+// Examples of bsonspec.org.
+static const std::string hello_world = bytes({0x16, 0, 0, 0, 0x02, 'h', 'e', 'l', 'l', 'o', 0,
+                                              0x06, 0, 0, 0, 'w', 'o', 'r', 'l', 'd', 0, 0});
+static const std::string awesome = bytes({0x31, 0, 0, 0, 0x04, 'B', 'S', 'O', 'N', 0,
+                                          0x26, 0, 0, 0, 0x02, '0', 0, 0x08, 0, 0, 0,
+                                          'a', 'w', 'e', 's', 'o', 'm', 'e', 0,
+                                          0x01, '1', 0, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x14, 0x40,
+                                          0x10, '2', 0, 0xC2, 0x07, 0, 0, 0, 0});
+
+TEST(Bson, Encode)
+{
+    EXPECT_EQ(mgjson::from_json("{\"hello\":\"world\"}").to_bson(), hello_world);
+    EXPECT_EQ(mgjson::from_json("{\"BSON\":[\"awesome\",5.05,1986]}").to_bson(), awesome);
+    EXPECT_EQ(mgjson(mgjson::Object).to_bson(), bytes({5, 0, 0, 0, 0}));
+
+    mgjson json(mgjson::Object);
+    json["a"] = true;
+    json["b"] = mgjson(mgjson::Null);
+    json["c"] = 4294967296LL;
+    json["d"] = -1;
+    json["e"] = std::string("\xFF", 1);
+    json["f"] = mgjson(mgjson::Undefined);
+    json["g"] = 18446744073709551615ULL;
+    EXPECT_EQ(json.to_bson(), bytes({0x32, 0, 0, 0,
+                                     0x08, 'a', 0, 1,
+                                     0x0A, 'b', 0,
+                                     0x12, 'c', 0, 0, 0, 0, 0, 1, 0, 0, 0,
+                                     0x10, 'd', 0, 0xFF, 0xFF, 0xFF, 0xFF,
+                                     0x05, 'e', 0, 1, 0, 0, 0, 0, 0xFF,
+                                     0x01, 'g', 0, 0, 0, 0, 0, 0, 0, 0xF0, 0x43,
+                                     0}));
+
+    std::string out = "prefix";
+    json.to_bson(out);
+    EXPECT_EQ(out, "prefix" + json.to_bson());
+
+    EXPECT_THROW(mgjson(1).to_bson(), std::invalid_argument);
+    EXPECT_THROW(mgjson(mgjson::Array).to_bson(), std::invalid_argument);
+}
+
+TEST(Bson, Decode)
+{
+    mgjson::parse_result result;
+    EXPECT_EQ(mgjson::from_bson(hello_world, &result).to_json(mgjson::Compact), "{\"hello\":\"world\"}");
+    EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(result.offset, static_cast<int>(hello_world.size()));
+
+    const mgjson json = mgjson::from_bson(awesome, &result);
+    EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json["BSON"].count(), 3u);
+    EXPECT_EQ(json["BSON"][static_cast<size_t>(0)].to_string(), "awesome");
+    EXPECT_EQ(json["BSON"][1].to_double(), 5.05);
+    EXPECT_EQ(json["BSON"][2].to_int(), 1986);
+
+    // ObjectId, date-time, timestamp, symbol and undefined.
+    const std::string other = bytes({0x36, 0, 0, 0,
+                                     0x07, 'i', 0, 0x50, 0x7F, 0x1F, 0x77, 0xBC, 0xF8, 0x6C, 0xD7,
+                                     0x99, 0x43, 0x90, 0x11,
+                                     0x09, 't', 0, 0x00, 0x10, 0x5E, 0x5F, 0, 0, 0, 0,
+                                     0x11, 's', 0, 1, 0, 0, 0, 2, 0, 0, 0,
+                                     0x0E, 'y', 0, 2, 0, 0, 0, 'x', 0,
+                                     0x06, 'u', 0,
+                                     0});
+    const mgjson values = mgjson::from_bson(other, &result);
+    EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(values["i"].to_string(), "507f1f77bcf86cd799439011");
+    EXPECT_EQ(values["t"].to_longlong(), 1600000000LL);
+    EXPECT_EQ(values["s"].to_ulonglong(), 0x200000001ULL);
+    EXPECT_EQ(values["y"].to_string(), "x");
+    EXPECT_EQ(values["u"].type(), mgjson::Undefined);
+
+    // Sequence of documents.
+    const std::string sequence = hello_world + awesome;
+    EXPECT_EQ(mgjson::from_bson(sequence, &result).to_json(mgjson::Compact), "{\"hello\":\"world\"}");
+    EXPECT_EQ(result.error, mgjson::parse_result::MoreData);
+    EXPECT_EQ(result.offset, static_cast<int>(hello_world.size()));
+    EXPECT_EQ(mgjson::from_bson(sequence.data() + result.offset, sequence.size() - result.offset).count(), 1u);
+}
+
+TEST(Bson, RoundTrip)
+{
+    const char* text = "{\"array\":[1,-2,3.25,\"text\",null,true,false,[],{}],"
+                       "\"big\":9223372036854775807,\"min\":-9223372036854775808,"
+                       "\"nested\":{\"a\":{\"b\":{\"c\":[[[\"deep\"]]]}}},\"utf8\":\"\xE2\x82\xAC\"}";
+    const mgjson json = mgjson::from_json(text);
+    const std::string bson = json.to_bson();
+    mgjson::parse_result result;
+    const mgjson loaded = mgjson::from_bson(bson, &result);
+    EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(loaded.to_json(), json.to_json());
+    EXPECT_EQ(loaded.to_bson(), bson);
+
+    mgjson raw(mgjson::Object);
+    raw["raw"] = mgjson::raw_json("[1, {\"a\": 2}]");
+    EXPECT_EQ(mgjson::from_bson(raw.to_bson()).to_json(mgjson::Compact), "{\"raw\":[1,{\"a\":2}]}");
+}
+
+TEST(Bson, Errors)
+{
+    mgjson::parse_result result;
+    EXPECT_TRUE(mgjson::from_bson(nullptr, 0, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+
+    EXPECT_TRUE(mgjson::from_bson(hello_world.substr(0, hello_world.size() - 1), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+    EXPECT_EQ(result.offset, 0);
+
+    std::string broken = hello_world;
+    broken[broken.size() - 1] = 1;
+    EXPECT_TRUE(mgjson::from_bson(broken, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(result.offset, 21);
+
+    // String longer than its document.
+    broken = hello_world;
+    broken[11] = 0x07;
+    EXPECT_TRUE(mgjson::from_bson(broken, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(result.offset, 11);
+
+    // Embedded document longer than its parent.
+    broken = awesome;
+    broken[10] = 0x27;
+    EXPECT_TRUE(mgjson::from_bson(broken, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(result.offset, 10);
+
+    // Unsupported type (regular expression).
+    broken = hello_world;
+    broken[4] = 0x0B;
+    EXPECT_TRUE(mgjson::from_bson(broken, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(result.offset, 4);
+
+    EXPECT_TRUE(mgjson::from_bson(bytes({7, 0, 0, 0, 0x0A, 0, 0}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidName);
+    EXPECT_EQ(result.offset, 5);
+
+    const std::string twice = bytes({0x0F, 0, 0, 0, 0x0A, 'a', 0, 0x10, 'a', 0, 1, 0, 0, 0, 0});
+    EXPECT_TRUE(mgjson::from_bson(twice, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::DuplicateName);
+    EXPECT_EQ(result.offset, 8);
+    mgjson::parse_options options;
+    options.duplicates = mgjson::DuplicateLastWins;
+    EXPECT_EQ(mgjson::from_bson(twice, options, &result).to_json(mgjson::Compact), "{\"a\":1}");
+
+    options = mgjson::parse_options();
+    options.max_depth = 1;
+    EXPECT_TRUE(mgjson::from_bson(awesome, options, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::DepthLimitExceeded);
+
+    // Documents nested deeper than default limit: {"a": {"a": ... {}}}.
+    std::string deep = bytes({5, 0, 0, 0, 0});
+    for (int i = 0; i < 1000; ++i) {
+        const uint32_t size = static_cast<uint32_t>(deep.size() + 8);
+        deep = bytes({static_cast<int>(size & 0xFF), static_cast<int>((size >> 8) & 0xFF),
+                      static_cast<int>(size >> 16), 0, 0x03, 'a', 0}) + deep + bytes({0});
+    }
+    EXPECT_TRUE(mgjson::from_bson(deep, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::DepthLimitExceeded);
+    options = mgjson::parse_options();
+    options.max_string_length = 4;
+    EXPECT_TRUE(mgjson::from_bson(hello_world, options, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::StringLimitExceeded);
+    EXPECT_EQ(result.offset, 4);
+}
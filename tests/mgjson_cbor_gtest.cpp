@@ -0,0 +1,199 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+
+#include <cmath>
+#include <limits>
+#include <string>
+
+#include <gtest/gtest.h>
+
+static std::string bytes(std::initializer_list<int> list)
+{
+    std::string result;
+    for (int c : list) {
+        result.push_back(static_cast<char>(c));
+    }
+    return result;
+}
+
+// Examples of RFC 8949, Appendix A.
+TEST(Cbor, Encode)
+{
+    EXPECT_EQ(mgjson(0).to_cbor(), bytes({0x00}));
+    EXPECT_EQ(mgjson(23).to_cbor(), bytes({0x17}));
+    EXPECT_EQ(mgjson(24).to_cbor(), bytes({0x18, 0x18}));
+    EXPECT_EQ(mgjson(1000).to_cbor(), bytes({0x19, 0x03, 0xE8}));
+    EXPECT_EQ(mgjson(1000000).to_cbor(), bytes({0x1A, 0x00, 0x0F, 0x42, 0x40}));
+    EXPECT_EQ(mgjson(18446744073709551615ULL).to_cbor(),
+              bytes({0x1B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}));
+    EXPECT_EQ(mgjson(-1).to_cbor(), bytes({0x20}));
+    EXPECT_EQ(mgjson(-100).to_cbor(), bytes({0x38, 0x63}));
+    EXPECT_EQ(mgjson(-1000).to_cbor(), bytes({0x39, 0x03, 0xE7}));
+    EXPECT_EQ(mgjson(-9223372036854775807LL - 1).to_cbor(),
+              bytes({0x3B, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}));
+
+    EXPECT_EQ(mgjson(0.0).to_cbor(), bytes({0xF9, 0x00, 0x00}));
+    EXPECT_EQ(mgjson(-0.0).to_cbor(), bytes({0xF9, 0x80, 0x00}));
+    EXPECT_EQ(mgjson(1.5).to_cbor(), bytes({0xF9, 0x3E, 0x00}));
+    EXPECT_EQ(mgjson(65504.0).to_cbor(), bytes({0xF9, 0x7B, 0xFF}));
+    EXPECT_EQ(mgjson(5.960464477539063e-8).to_cbor(), bytes({0xF9, 0x00, 0x01}));
+    EXPECT_EQ(mgjson(-4.0).to_cbor(), bytes({0xF9, 0xC4, 0x00}));
+    EXPECT_EQ(mgjson(100000.0).to_cbor(), bytes({0xFA, 0x47, 0xC3, 0x50, 0x00}));
+    EXPECT_EQ(mgjson(3.4028234663852886e+38).to_cbor(), bytes({0xFA, 0x7F, 0x7F, 0xFF, 0xFF}));
+    EXPECT_EQ(mgjson(1.1).to_cbor(), bytes({0xFB, 0x3F, 0xF1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A}));
+    EXPECT_EQ(mgjson(std::numeric_limits<double>::infinity()).to_cbor(), bytes({0xF9, 0x7C, 0x00}));
+    EXPECT_EQ(mgjson(std::numeric_limits<double>::quiet_NaN()).to_cbor(), bytes({0xF9, 0x7E, 0x00}));
+
+    EXPECT_EQ(mgjson(false).to_cbor(), bytes({0xF4}));
+    EXPECT_EQ(mgjson(true).to_cbor(), bytes({0xF5}));
+    EXPECT_EQ(mgjson().to_cbor(), bytes({0xF6}));
+    EXPECT_EQ(mgjson(mgjson::Undefined).to_cbor(), bytes({0xF7}));
+
+    EXPECT_EQ(mgjson("").to_cbor(), bytes({0x60}));
+    EXPECT_EQ(mgjson("IETF").to_cbor(), bytes({0x64, 0x49, 0x45, 0x54, 0x46}));
+    EXPECT_EQ(mgjson("\xC3\xBC").to_cbor(), bytes({0x62, 0xC3, 0xBC}));
+    EXPECT_EQ(mgjson(std::string("\xFF\x01", 2)).to_cbor(), bytes({0x42, 0xFF, 0x01}));
+
+    EXPECT_EQ(mgjson::from_json("[1,[2,3],[4,5]]").to_cbor(),
+              bytes({0x83, 0x01, 0x82, 0x02, 0x03, 0x82, 0x04, 0x05}));
+    EXPECT_EQ(mgjson::from_json("{\"a\":1,\"b\":[2,3],\"c\":null}").to_cbor(),
+              bytes({0xA3, 0x61, 0x61, 0x01, 0x61, 0x62, 0x82, 0x02, 0x03, 0x61, 0x63, 0xF6}));
+
+    mgjson json;
+    json["defined"] = 1;
+    json["undefined"] = mgjson(mgjson::Undefined);
+    EXPECT_EQ(json.to_cbor(), bytes({0xA1, 0x67, 'd', 'e', 'f', 'i', 'n', 'e', 'd', 0x01}));
+}
+
+TEST(Cbor, Decode)
+{
+    EXPECT_EQ(mgjson::from_cbor(bytes({0x1B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF})).to_json(),
+              "18446744073709551615");
+    EXPECT_EQ(mgjson::from_cbor(bytes({0x39, 0x03, 0xE7})).to_json(), "-1000");
+    EXPECT_EQ(mgjson::from_cbor(bytes({0x3B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF})).to_double(),
+              -18446744073709551616.0);
+    EXPECT_EQ(mgjson::from_cbor(bytes({0xF9, 0x3C, 0x00})).to_json(), "1");
+    EXPECT_EQ(mgjson::from_cbor(bytes({0xF9, 0x00, 0x01})).to_double(), 5.960464477539063e-8);
+    EXPECT_EQ(mgjson::from_cbor(bytes({0xF9, 0xC4, 0x00})).to_double(), -4.0);
+    EXPECT_TRUE(std::isinf(mgjson::from_cbor(bytes({0xF9, 0xFC, 0x00})).to_double()));
+    EXPECT_TRUE(std::isnan(mgjson::from_cbor(bytes({0xF9, 0x7E, 0x00})).to_double()));
+    EXPECT_EQ(mgjson::from_cbor(bytes({0xFA, 0x47, 0xC3, 0x50, 0x00})).to_json(), "100000");
+    EXPECT_EQ(mgjson::from_cbor(bytes({0xFB, 0x3F, 0xF1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A})).to_json(),
+              "1.1");
+    EXPECT_EQ(mgjson::from_cbor(bytes({0xF7})).type(), mgjson::Undefined);
+
+    // Tags are skipped.
+    EXPECT_EQ(mgjson::from_cbor(bytes({0xC1, 0x1A, 0x51, 0x4B, 0x67, 0xB0})).to_json(), "1363896240");
+    EXPECT_EQ(mgjson::from_cbor(bytes({0xD8, 0x20, 0x63, 'u', 'r', 'l'})).to_json(), "\"url\"");
+
+    // Indefinite lengths.
+    EXPECT_EQ(mgjson::from_cbor(bytes({0x5F, 0x42, 0x01, 0x02, 0x43, 0x03, 0x04, 0x05, 0xFF})).to_string(),
+              std::string("\x01\x02\x03\x04\x05"));
+    EXPECT_EQ(mgjson::from_cbor(bytes({0x7F, 0x65, 's', 't', 'r', 'e', 'a', 0x64, 'm', 'i', 'n', 'g', 0xFF}))
+              .to_string(), "streaming");
+    EXPECT_EQ(mgjson::from_cbor(bytes({0x9F, 0x01, 0x82, 0x02, 0x03, 0x9F, 0x04, 0x05, 0xFF, 0xFF}))
+              .to_json(mgjson::Compact), "[1,[2,3],[4,5]]");
+    EXPECT_EQ(mgjson::from_cbor(bytes({0x9F, 0xFF})).to_json(mgjson::Compact), "[]");
+    EXPECT_EQ(mgjson::from_cbor(bytes({0xBF, 0x63, 'F', 'u', 'n', 0xF5, 0x7F, 0x61, 'A', 0x62, 'm', 't',
+                                       0xFF, 0x21, 0xFF})).to_json(mgjson::Compact),
+              "{\"Amt\":-2,\"Fun\":true}");
+}
+
+TEST(Cbor, RoundTrip)
+{
+    const char* text = "{\"array\":[1,-2,3.25,0.1,1e300,\"text\",null,true,false,[],{}],"
+                       "\"big\":18446744073709551615,\"min\":-9223372036854775808,"
+                       "\"nested\":{\"a\":{\"b\":{\"c\":[[[\"deep\"]]]}}},\"utf8\":\"\xE2\x82\xAC\"}";
+    mgjson json = mgjson::from_json(text);
+    for (int i = 0; i < 30; ++i) {
+        json["list"].push_back(i * 100000);
+        json["fields"][("field" + std::to_string(i)).c_str()] = std::string(static_cast<size_t>(i) * 10, 'v');
+    }
+
+    const std::string encoded = json.to_cbor();
+    std::string out = "prefix";
+    json.to_cbor(out);
+    EXPECT_EQ(out, "prefix" + encoded);
+
+    mgjson::parse_result result;
+    mgjson decoded = mgjson::from_cbor(encoded, &result);
+    EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(decoded.to_json(mgjson::Compact), json.to_json(mgjson::Compact));
+    EXPECT_EQ(decoded.hash(), json.hash());
+    EXPECT_EQ(decoded.to_cbor(), encoded);
+    EXPECT_EQ(mgjson::from_cbor(mgjson::msgunpack(json.msgpack()).to_cbor()).to_json(), json.to_json());
+}
+
+TEST(Cbor, Errors)
+{
+    mgjson::parse_result result;
+
+    EXPECT_TRUE(mgjson::from_cbor("", 0, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+
+    EXPECT_TRUE(mgjson::from_cbor(bytes({0x19, 0x03}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+
+    EXPECT_TRUE(mgjson::from_cbor(bytes({0x9B, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}),
+                                  &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+
+    EXPECT_TRUE(mgjson::from_cbor(bytes({0x9F, 0x01}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+
+    // Sequence of items.
+    const std::string sequence = bytes({0x01, 0x82, 0x02, 0x03});
+    EXPECT_EQ(mgjson::from_cbor(sequence, &result).to_int(), 1);
+    EXPECT_EQ(result.error, mgjson::parse_result::MoreData);
+    EXPECT_EQ(result.offset, 1);
+    EXPECT_EQ(mgjson::from_cbor(sequence.data() + result.offset, sequence.size() - 1)
+              .to_json(mgjson::Compact), "[2,3]");
+
+    EXPECT_TRUE(mgjson::from_cbor(bytes({0x82, 0x01, 0xFF}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(result.offset, 2);
+
+    EXPECT_TRUE(mgjson::from_cbor(bytes({0x1F}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidCharacter);
+
+    EXPECT_TRUE(mgjson::from_cbor(bytes({0x1C}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidCharacter);
+
+    EXPECT_TRUE(mgjson::from_cbor(bytes({0xF8, 0x20}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidCharacter);
+
+    EXPECT_TRUE(mgjson::from_cbor(bytes({0x5F, 0x61, 'a', 0xFF}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(result.offset, 1);
+
+    EXPECT_TRUE(mgjson::from_cbor(bytes({0xA1, 0x01, 0x02}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidName);
+
+    const std::string duplicates = bytes({0xA2, 0x61, 'k', 0x01, 0x61, 'k', 0x02});
+    EXPECT_TRUE(mgjson::from_cbor(duplicates, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::DuplicateName);
+    EXPECT_EQ(result.offset, 4);
+
+    mgjson::parse_options options;
+    options.duplicates = mgjson::DuplicateLastWins;
+    EXPECT_EQ(mgjson::from_cbor(duplicates, options)["k"].to_int(), 2);
+
+    options = mgjson::parse_options();
+    options.max_depth = 1;
+    EXPECT_TRUE(mgjson::from_cbor(bytes({0x81, 0x9F, 0xFF}), options, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::DepthLimitExceeded);
+
+    std::string deep(300000, static_cast<char>(0x81));
+    deep.push_back(static_cast<char>(0xF6));
+    EXPECT_TRUE(mgjson::from_cbor(deep, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::DepthLimitExceeded);
+
+    options = mgjson::parse_options();
+    options.max_string_length = 4;
+    EXPECT_TRUE(mgjson::from_cbor(bytes({0x7F, 0x63, 'a', 'b', 'c', 0x62, 'd', 'e', 0xFF}),
+                                  options, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::StringLimitExceeded);
+}
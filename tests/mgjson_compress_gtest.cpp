@@ -0,0 +1,111 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+static const mgjson::json_compression compressions[] = {mgjson::CompressLz4, mgjson::CompressZstd};
+
+static mgjson records(int count)
+{
+    mgjson json(mgjson::Array);
+    for (int i = 0; i < count; ++i) {
+        mgjson record(mgjson::Object);
+        record["id"] = i;
+        record["name"] = "record " + std::to_string(i);
+        record["tags"] = mgjson::from_json("[\"cache\",\"document\",\"compressed\"]");
+        json.push_back(record);
+    }
+    return json;
+}
+
+TEST(Compress, Formats)
+{
+    mgjson::parse_result result;
+    for (mgjson::json_compression compression : compressions) {
+        if (!mgjson::compression_supported(compression)) {
+            EXPECT_THROW(mgjson(1).to_compressed(compression), std::invalid_argument);
+        }
+    }
+
+    EXPECT_TRUE(mgjson::from_compressed("{\"a\":1}", &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::CompressionError);
+    EXPECT_EQ(result.offset, 0);
+
+    EXPECT_TRUE(mgjson::from_compressed(nullptr, 0, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+}
+
+TEST(Compress, RoundTrip)
+{
+    const mgjson json = records(2000);
+    const std::string text = json.to_json(mgjson::Compact);
+    for (mgjson::json_compression compression : compressions) {
+        if (!mgjson::compression_supported(compression)) {
+            continue;
+        }
+        const std::string data = json.to_compressed(compression);
+        EXPECT_LT(data.size() * 3, text.size());
+
+        mgjson::parse_result result;
+        EXPECT_EQ(mgjson::from_compressed(data, &result).to_json(mgjson::Compact), text);
+        EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+        EXPECT_EQ(mgjson::from_compressed(json.to_compressed(compression, mgjson::MaxReadable, 9)).to_json(),
+                  json.to_json());
+
+        std::string out = "prefix";
+        json.to_compressed(out, compression);
+        EXPECT_EQ(out, "prefix" + data);
+
+        mgjson_parser parser;
+        for (int i = 0; i < 2; ++i) {
+            EXPECT_EQ(parser.parse_compressed(data, &result).count(), 2000u);
+            EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+        }
+        const std::string small = mgjson::from_json("{\"a\":[1,2]}").to_compressed(compression);
+        EXPECT_EQ(parser.parse_compressed(small, &result).to_json(mgjson::Compact), "{\"a\":[1,2]}");
+        EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+    }
+}
+
+TEST(Compress, Errors)
+{
+    const mgjson json = records(100);
+    for (mgjson::json_compression compression : compressions) {
+        if (!mgjson::compression_supported(compression)) {
+            continue;
+        }
+        const std::string data = json.to_compressed(compression);
+        mgjson::parse_result result;
+
+        // Sequence of frames.
+        const std::string sequence = data + mgjson(mgjson::Object).to_compressed(compression);
+        EXPECT_EQ(mgjson::from_compressed(sequence, &result).count(), 100u);
+        EXPECT_EQ(result.error, mgjson::parse_result::MoreData);
+        EXPECT_EQ(result.offset, static_cast<int>(data.size()));
+        EXPECT_EQ(mgjson::from_compressed(sequence.data() + result.offset,
+                                          sequence.size() - result.offset, &result).to_json(), "{}");
+        EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+
+        EXPECT_TRUE(mgjson::from_compressed(data.substr(0, data.size() - 1), &result).is_undefined());
+        EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+
+        mgjson::parse_options options;
+        options.max_size = 1000;
+        EXPECT_TRUE(mgjson::from_compressed(data, options, &result).is_undefined());
+        EXPECT_EQ(result.error, mgjson::parse_result::SizeLimitExceeded);
+
+        // Errors of text are reported as by from_json().
+        options = mgjson::parse_options();
+        options.max_depth = 2;
+        const mgjson nested = mgjson::from_json("[[[1]]]");
+        EXPECT_TRUE(mgjson::from_compressed(nested.to_compressed(compression), options, &result).is_undefined());
+        EXPECT_EQ(result.error, mgjson::parse_result::DepthLimitExceeded);
+        EXPECT_EQ(result.offset, 2);
+    }
+}
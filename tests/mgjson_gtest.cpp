@@ -255,7 +255,14 @@ INSTANTIATE_TEST_CASE_P(, StringValueCastTest, ::testing::Values(
     _test(".123456789012345678901234567890E100", true, std::numeric_limits<unsigned long long>::max(), .123456789012345678901234567890E100L),
     _test(".123456789012345678901234567890E-100", false, 0, .123456789012345678901234567890E-100L),
     _test("12345678901234.5678901234567890", true, 12345678901234, 12345678901234.5678901234567890L),
-    _test("-12345678901234.5678901234567890", true, -12345678901234, -12345678901234.5678901234567890L)
+    _test("-12345678901234.5678901234567890", true, -12345678901234, -12345678901234.5678901234567890L),
+    _test("1.5", true, 1, 1.5L),
+    _test("-0.25", false, 0, -0.25L),
+    _test("2.5e-5", false, 0, 2.5e-5L),
+    _test("18446744073709551615", true, std::numeric_limits<unsigned long long>::max(), 18446744073709551615.0L),
+    _test("123456789012345678901", true, std::numeric_limits<unsigned long long>::max(), 123456789012345678901.0L),
+    _test("010", true, 8, 10),
+    _test(" 5", true, 5, 5)
 ));
 #undef _test
 
@@ -0,0 +1,196 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+#include "../src/mgjson_private.h"
+
+#include <cstdio>
+#include <string>
+
+#include <gtest/gtest.h>
+
+static std::string bytes(std::initializer_list<int> list)
+{
+    std::string result;
+    for (int c : list) {
+        result.push_back(static_cast<char>(c));
+    }
+    return result;
+}
+
+static const std::string image_header = bytes({'M', 'G', 'J', 'I', 0, 0, 0, 1});
+static const std::string image_shared = bytes({0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 3});
+
+TEST(Image, Format)
+{
+    EXPECT_EQ(mgjson(true).to_image(), image_header + bytes({0, 0, 0, 32, 0, 0, 0, 24}) + image_shared);
+
+    // Name "a" is stored once.
+    mgjson json = mgjson::from_json("{\"a\":[-1,{\"a\":\"b\"}]}");
+    // Items are written before their containers.
+    EXPECT_EQ(json.to_image(), image_header + bytes({0, 0, 0, 116, 0, 0, 0, 100}) + image_shared
+              + bytes({0, 0, 0, 7, 0, 0, 0, 1, 'a', 0, 0, 0,
+                       0, 0, 0, 5, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                       0, 0, 0, 7, 0, 0, 0, 1, 'b', 0, 0, 0,
+                       0, 0, 0, 11, 0, 0, 0, 1, 0, 0, 0, 32, 0, 0, 0, 56,
+                       0, 0, 0, 10, 0, 0, 0, 2, 0, 0, 0, 44, 0, 0, 0, 68,
+                       0, 0, 0, 11, 0, 0, 0, 1, 0, 0, 0, 32, 0, 0, 0, 84}));
+
+    std::string out = "prefix";
+    json.to_image(out);
+    EXPECT_EQ(out, "prefix" + json.to_image());
+}
+
+TEST(Image, RoundTrip)
+{
+    const char* text = "{\"array\":[1,-2,3.25,\"text\",null,true,false,[],{}],"
+                       "\"big\":18446744073709551615,\"min\":-9223372036854775808,"
+                       "\"nested\":{\"a\":{\"b\":{\"c\":[[[\"deep\"]]]}}},\"utf8\":\"\xE2\x82\xAC\"}";
+    mgjson json = mgjson::from_json(text);
+    for (int i = 0; i < 50; ++i) {
+        json["fields"][("field" + std::to_string(i)).c_str()] = i;
+    }
+    json["raw"] = mgjson::raw_json("[1, 2]");
+    json["preserved"] = mgjson::from_json("[12345678901234567890123, 0.10]", nullptr, mgjson::PreserveNumbers);
+    json["undefined"] = mgjson(mgjson::Undefined);
+
+    const std::string image = json.to_image();
+    mgjson::parse_result result;
+    const mgjson loaded = mgjson::from_image(image.data(), image.size(), &result);
+    EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(result.offset, static_cast<int>(image.size()));
+
+    EXPECT_EQ(loaded.count(), json.count());
+    EXPECT_EQ(loaded.keys(), json.keys());
+    EXPECT_EQ(loaded["fields"].count(), 50u);
+    EXPECT_EQ(loaded["fields"]["field42"].to_int(), 42);
+    EXPECT_TRUE(loaded["fields"].has_key("field7"));
+    EXPECT_FALSE(loaded["fields"].has_key("field"));
+    EXPECT_TRUE(loaded["fields"]["missing"].is_null());
+    EXPECT_EQ(loaded["array"][2].to_double(), 3.25);
+    EXPECT_TRUE(loaded["array"][9].is_null());
+    EXPECT_EQ(loaded["big"].to_ulonglong(), 18446744073709551615ULL);
+    EXPECT_EQ(loaded["nested"]["a"]["b"]["c"].to_json(mgjson::Compact), "[[[\"deep\"]]]");
+    EXPECT_EQ(loaded["preserved"].to_json(mgjson::Compact), "[12345678901234567890123,0.10]");
+    EXPECT_EQ(loaded["undefined"].type(), mgjson::Undefined);
+
+    EXPECT_EQ(loaded.to_json(), json.to_json());
+    EXPECT_EQ(loaded.hash(), json.hash());
+    EXPECT_EQ(loaded.to_image(), image);
+
+    // Hashed and written without expanding.
+    const mgjson fresh = mgjson::from_image(image.data(), image.size());
+    EXPECT_EQ(fresh.hash(), json.hash());
+    // Raw JSON is rewritten by image.
+    const mgjson tree = mgjson::from_json(json.to_json(mgjson::Compact), nullptr, mgjson::PreserveNumbers);
+    for (mgjson::json_format format : {mgjson::json_format(mgjson::Compact), mgjson::json_format(mgjson::MaxReadable),
+                                       mgjson::json_format(mgjson::Canonical)}) {
+        EXPECT_EQ(fresh.to_json(format), tree.to_json(format));
+        EXPECT_EQ(fresh.to_json_size(format), tree.to_json_size(format));
+    }
+    EXPECT_EQ(fresh.to_json_parallel(mgjson::Compact, 4), tree.to_json(mgjson::Compact));
+    EXPECT_EQ(fresh.to_image(), image);
+    EXPECT_TRUE(mgjson_private::get(fresh)->in_image());
+    EXPECT_TRUE(mgjson_private::get(fresh["nested"])->in_image());
+}
+
+TEST(Image, Change)
+{
+    const std::string image = mgjson::from_json("{\"a\":{\"b\":[1,2,3]},\"c\":\"d\"}").to_image();
+    const mgjson loaded = mgjson::from_image(image.data(), image.size());
+
+    mgjson copy = loaded;
+    copy["a"]["b"].push_back(4);
+    copy.remove("c");
+    EXPECT_EQ(copy.to_json(mgjson::Compact), "{\"a\":{\"b\":[1,2,3,4]}}");
+    EXPECT_EQ(loaded.to_json(mgjson::Compact), "{\"a\":{\"b\":[1,2,3]},\"c\":\"d\"}");
+
+    mgjson child = loaded["a"];
+    child["x"] = true;
+    EXPECT_EQ(child.to_json(mgjson::Compact), "{\"b\":[1,2,3],\"x\":true}");
+    EXPECT_FALSE(loaded["a"].has_key("x"));
+}
+
+TEST(Image, File)
+{
+    const char* path = "mgjson_image_gtest.bin";
+    mgjson json = mgjson::from_json("{\"list\":[1,2,3],\"name\":\"image\"}");
+    const std::string image = json.to_image();
+    FILE* f = fopen(path, "wb");
+    ASSERT_NE(f, nullptr);
+    EXPECT_EQ(fwrite(image.data(), 1, image.size(), f), image.size());
+    fclose(f);
+
+    mgjson::parse_result result;
+    mgjson list;
+    {
+        mgjson loaded = mgjson::from_image_file(path, &result);
+        EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+        EXPECT_EQ(loaded.to_json(), json.to_json());
+        list = loaded["list"];
+    }
+    EXPECT_EQ(list[2].to_int(), 3);
+    remove(path);
+
+    EXPECT_TRUE(mgjson::from_image_file(path, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::FileError);
+}
+
+TEST(Image, Errors)
+{
+    mgjson::parse_result result;
+    const std::string image = mgjson::from_json("[\"text\",{\"a\":1}]").to_image();
+
+    EXPECT_TRUE(mgjson::from_image(nullptr, 0, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+
+    EXPECT_TRUE(mgjson::from_image(image.data(), image.size() - 1, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+
+    std::string broken = image;
+    broken[0] = 'X';
+    EXPECT_TRUE(mgjson::from_image(broken.data(), broken.size(), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(result.offset, 0);
+
+    broken = image;
+    broken[7] = 2;
+    EXPECT_TRUE(mgjson::from_image(broken.data(), broken.size(), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(result.offset, 4);
+
+    broken = image + "tail";
+    EXPECT_EQ(mgjson::from_image(broken.data(), broken.size(), &result).count(), 2u);
+    EXPECT_EQ(result.error, mgjson::parse_result::MoreData);
+    EXPECT_EQ(result.offset, static_cast<int>(image.size()));
+
+    // References out of image are read as undefined values.
+    broken = image;
+    broken[99] = 0x7C;
+    const mgjson loaded = mgjson::from_image(broken.data(), broken.size(), &result);
+    EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(loaded.count(), 2u);
+    EXPECT_EQ(loaded[static_cast<size_t>(0)].type(), mgjson::Undefined);
+    EXPECT_EQ(loaded[1]["a"].to_int(), 1);
+    EXPECT_EQ(loaded.to_json(mgjson::Compact), "[null,{\"a\":1}]");
+
+    // Containers referenced from records before them are undefined too, so
+    // cycles cannot be made.
+    broken = image;
+    broken[103] = 88;
+    const mgjson self = mgjson::from_image(broken.data(), broken.size(), &result);
+    EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(self[1].type(), mgjson::Undefined);
+    EXPECT_EQ(self.to_json(mgjson::Compact), "[\"text\",null]");
+
+    const std::string cycle = image_header + bytes({0, 0, 0, 44, 0, 0, 0, 32}) + image_shared
+            + bytes({0, 0, 0, 10, 0, 0, 0, 1, 0, 0, 0, 32});
+    const mgjson array = mgjson::from_image(cycle.data(), cycle.size(), &result);
+    EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(array.count(), 1u);
+    EXPECT_EQ(array[static_cast<size_t>(0)].type(), mgjson::Undefined);
+    EXPECT_EQ(array.to_json(mgjson::Compact), "[null]");
+    EXPECT_EQ(array.to_image(), image_header + bytes({0, 0, 0, 44, 0, 0, 0, 32}) + image_shared
+              + bytes({0, 0, 0, 10, 0, 0, 0, 1, 0, 0, 0, 28}));
+}
@@ -0,0 +1,145 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+static std::string bytes(std::initializer_list<int> list)
+{
+    std::string result;
+    for (int c : list) {
+        result.push_back(static_cast<char>(c));
+    }
+    return result;
+}
+
+TEST(MsgPack, Scalars)
+{
+    EXPECT_EQ(mgjson().msgpack(), bytes({0xC0}));
+    EXPECT_EQ(mgjson(mgjson::Undefined).msgpack(), bytes({0xC0}));
+    EXPECT_EQ(mgjson(true).msgpack(), bytes({0xC3}));
+    EXPECT_EQ(mgjson(false).msgpack(), bytes({0xC2}));
+    EXPECT_EQ(mgjson(0).msgpack(), bytes({0x00}));
+    EXPECT_EQ(mgjson(127).msgpack(), bytes({0x7F}));
+    EXPECT_EQ(mgjson(128).msgpack(), bytes({0xCC, 0x80}));
+    EXPECT_EQ(mgjson(65535).msgpack(), bytes({0xCD, 0xFF, 0xFF}));
+    EXPECT_EQ(mgjson(65536).msgpack(), bytes({0xCE, 0x00, 0x01, 0x00, 0x00}));
+    EXPECT_EQ(mgjson(18446744073709551615ULL).msgpack(),
+              bytes({0xCF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}));
+    EXPECT_EQ(mgjson(-1).msgpack(), bytes({0xFF}));
+    EXPECT_EQ(mgjson(-32).msgpack(), bytes({0xE0}));
+    EXPECT_EQ(mgjson(-33).msgpack(), bytes({0xD0, 0xDF}));
+    EXPECT_EQ(mgjson(-129).msgpack(), bytes({0xD1, 0xFF, 0x7F}));
+    EXPECT_EQ(mgjson(-9223372036854775807LL - 1).msgpack(),
+              bytes({0xD3, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}));
+    EXPECT_EQ(mgjson(1.5).msgpack(), bytes({0xCB, 0x3F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}));
+    EXPECT_EQ(mgjson("abc").msgpack(), bytes({0xA3, 'a', 'b', 'c'}));
+    EXPECT_EQ(mgjson(std::string(32, 'x')).msgpack(), bytes({0xD9, 0x20}) + std::string(32, 'x'));
+    EXPECT_EQ(mgjson(std::string(300, 'x')).msgpack(), bytes({0xDA, 0x01, 0x2C}) + std::string(300, 'x'));
+
+    mgjson json = mgjson::from_json("[12345678901234567890, -5, 2.5]", nullptr, mgjson::PreserveNumbers);
+    EXPECT_EQ(json.msgpack(), bytes({0x93, 0xCF, 0xAB, 0x54, 0xA9, 0x8C, 0xEB, 0x1F, 0x0A, 0xD2, 0xFB,
+                                     0xCB, 0x40, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}));
+}
+
+TEST(MsgPack, RoundTrip)
+{
+    const char* text = "{\"array\":[1,-2,3.25,\"text\",null,true,false,[],{}],"
+                       "\"big\":18446744073709551615,\"min\":-9223372036854775808,"
+                       "\"nested\":{\"a\":{\"b\":{\"c\":[[[\"deep\"]]]}}},\"utf8\":\"\xE2\x82\xAC\"}";
+    mgjson json = mgjson::from_json(text);
+    for (int i = 0; i < 20; ++i) {
+        json["list"].push_back(i * 1000);
+        json["fields"][("field" + std::to_string(i)).c_str()] = std::string(static_cast<size_t>(i) * 20, 'v');
+    }
+    json["undefined"] = mgjson(mgjson::Undefined);
+
+    const std::string packed = json.msgpack();
+    EXPECT_EQ(json.msgpack_size(), packed.size());
+    std::string out = "prefix";
+    json.msgpack(out);
+    EXPECT_EQ(out, "prefix" + packed);
+
+    mgjson::parse_result result;
+    mgjson unpacked = mgjson::msgunpack(packed, &result);
+    EXPECT_EQ(result.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(result.offset, static_cast<int>(packed.size()));
+    EXPECT_EQ(unpacked.to_json(mgjson::Compact), json.to_json(mgjson::Compact));
+    EXPECT_EQ(unpacked.hash(), json.hash());
+    EXPECT_EQ(unpacked.msgpack(), packed);
+
+    mgjson raw;
+    raw["raw"] = mgjson::raw_json("{\"b\" : [1, 2], \"a\" : null}");
+    EXPECT_EQ(mgjson::msgunpack(raw.msgpack()).to_json(mgjson::Compact),
+              "{\"raw\":{\"a\":null,\"b\":[1,2]}}");
+
+    // Other forms, what the encoder doesn't produce.
+    EXPECT_EQ(mgjson::msgunpack(bytes({0xCA, 0x3F, 0xC0, 0x00, 0x00})).to_double(), 1.5);
+    EXPECT_EQ(mgjson::msgunpack(bytes({0xD0, 0x05})).to_int(), 5);
+    EXPECT_EQ(mgjson::msgunpack(bytes({0xC4, 0x02, 'h', 'i'})).to_string(), "hi");
+    EXPECT_EQ(mgjson::msgunpack(bytes({0xDC, 0x00, 0x01, 0xC0})).to_json(mgjson::Compact), "[null]");
+    EXPECT_EQ(mgjson::msgunpack(bytes({0xDE, 0x00, 0x01, 0xA1, 'k', 0x01})).to_json(mgjson::Compact),
+              "{\"k\":1}");
+}
+
+TEST(MsgPack, Errors)
+{
+    mgjson::parse_result result;
+
+    EXPECT_TRUE(mgjson::msgunpack("", 0, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+
+    EXPECT_TRUE(mgjson::msgunpack(bytes({0x92, 0x01}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+
+    EXPECT_TRUE(mgjson::msgunpack(bytes({0xDD, 0xFF, 0xFF, 0xFF, 0xFF}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+
+    EXPECT_TRUE(mgjson::msgunpack(bytes({0xA5, 'a', 'b'}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::EndOfData);
+
+    EXPECT_EQ(mgjson::msgunpack(bytes({0x01, 0x02}), &result).to_int(), 1);
+    EXPECT_EQ(result.error, mgjson::parse_result::MoreData);
+    EXPECT_EQ(result.offset, 1);
+
+    EXPECT_TRUE(mgjson::msgunpack(bytes({0x91, 0xD4, 0x01, 0x00}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(result.offset, 1);
+
+    EXPECT_TRUE(mgjson::msgunpack(bytes({0x81, 0x01, 0x01}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidName);
+
+    EXPECT_TRUE(mgjson::msgunpack(bytes({0x81, 0xA0, 0x01}), &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::InvalidName);
+
+    const std::string duplicates = bytes({0x82, 0xA1, 'k', 0x01, 0xA1, 'k', 0x02});
+    EXPECT_TRUE(mgjson::msgunpack(duplicates, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::DuplicateName);
+    EXPECT_EQ(result.offset, 4);
+
+    mgjson::parse_options options;
+    options.duplicates = mgjson::DuplicateLastWins;
+    EXPECT_EQ(mgjson::msgunpack(duplicates, options)["k"].to_int(), 2);
+    options.duplicates = mgjson::DuplicateKeepAll;
+    EXPECT_EQ(mgjson::msgunpack(duplicates, options).to_json(mgjson::Compact), "{\"k\":[1,2]}");
+
+    options = mgjson::parse_options();
+    options.max_depth = 2;
+    EXPECT_FALSE(mgjson::msgunpack(bytes({0x91, 0x90}), options).is_undefined());
+    EXPECT_TRUE(mgjson::msgunpack(bytes({0x91, 0x91, 0x90}), options, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::DepthLimitExceeded);
+
+    std::string deep(300000, static_cast<char>(0x91));
+    deep.push_back(static_cast<char>(0xC0));
+    EXPECT_TRUE(mgjson::msgunpack(deep, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::DepthLimitExceeded);
+
+    options = mgjson::parse_options();
+    options.max_string_length = 2;
+    EXPECT_TRUE(mgjson::msgunpack(bytes({0xA3, 'a', 'b', 'c'}), options, &result).is_undefined());
+    EXPECT_EQ(result.error, mgjson::parse_result::StringLimitExceeded);
+}
@@ -0,0 +1,857 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+#include "../src/mgjson_private.h"
+
+#include <limits>
+
+#include <gtest/gtest.h>
+
+TEST(FromJson, Literals)
+{
+    mgjson::parse_result res;
+
+    mgjson json = mgjson::from_json("null", &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_TRUE(json.is_null());
+
+    json = mgjson::from_json(" true ", &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_TRUE(json.is_bool());
+    EXPECT_TRUE(json.to_bool());
+
+    json = mgjson::from_json("false", &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_TRUE(json.is_bool());
+    EXPECT_FALSE(json.to_bool());
+}
+
+struct NumberParam
+{
+    const char* json;
+    mgjson::json_type type;
+    unsigned long long i_value;
+    long double d_value;
+    const char* str_value;
+};
+
+::std::ostream& operator<<(::std::ostream& os, const NumberParam& p)
+{
+    os << p.json;
+    return os;
+}
+
+class FromJsonNumber : public ::testing::TestWithParam<NumberParam>
+{
+};
+
+TEST_P(FromJsonNumber, Parse)
+{
+    const NumberParam& p = GetParam();
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json(p.json, &res);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.type(), p.type);
+    EXPECT_EQ(json.to_ulonglong(), p.i_value);
+    EXPECT_EQ(json.to_longdouble(), p.d_value);
+    if (nullptr != p.str_value) {
+        EXPECT_STREQ(json.to_str(), p.str_value);
+    }
+}
+
+#define _int(s,i) NumberParam{s, mgjson::Integer, static_cast<unsigned long long>(i), \
+                              static_cast<long double>(i), s}
+#define _dbl(s,d,i) NumberParam{s, mgjson::Double, \
+                                static_cast<unsigned long long>(i), d, nullptr}
+
+INSTANTIATE_TEST_CASE_P(, FromJsonNumber, ::testing::Values(
+    _int("0", 0),
+    _int("7", 7),
+    _int("-7", -7LL),
+    _int("1234567890123456789", 1234567890123456789ULL),
+    _int("18446744073709551615", 18446744073709551615ULL),
+    _int("-9223372036854775808", std::numeric_limits<long long>::min()),
+    _dbl("0.5", 0.5L, 0),
+    _dbl("0.1", 0.1L, 0),
+    _dbl("-2.25", -2.25L, -2LL),
+    _dbl("1e10", 1e10L, 10000000000ULL),
+    _dbl("1.5E+3", 1.5E+3L, 1500),
+    _dbl("12345e-4", 12345e-4L, 1),
+    _dbl("0.000001234", 0.000001234L, 0),
+    _dbl("3.141592653589793238", 3.141592653589793238L, 3),
+    _dbl("123456789012345678901234567890", 123456789012345678901234567890.0L, std::numeric_limits<unsigned long long>::max()),
+    _dbl("1e300", 1e300L, std::numeric_limits<unsigned long long>::max()),
+    _dbl("2.2250738585072014e-308", 2.2250738585072014e-308L, 0),
+    _dbl("18446744073709551616", 18446744073709551616.0L, std::numeric_limits<unsigned long long>::max()),
+    _dbl("-9223372036854775809", -9223372036854775809.0L, std::numeric_limits<long long>::min())
+));
+#undef _int
+#undef _dbl
+
+TEST(FromJson, Strings)
+{
+    mgjson::parse_result res;
+
+    mgjson json = mgjson::from_json("\"Simple string\"", &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_TRUE(json.is_string());
+    EXPECT_EQ(json.to_string(), "Simple string");
+
+    json = mgjson::from_json("\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"", &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.to_string(), "\"\\/\b\f\n\r\t");
+
+    json = mgjson::from_json("\"\\u0041\\u00e9\\u20AC\\ud83d\\ude00\"", &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.to_string(), "A\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80");
+
+    json = mgjson::from_json("\"a\\u0000b\"", &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.to_string(), std::string("a\0b", 3));
+}
+
+TEST(FromJson, AdjacentStrings)
+{
+    mgjson::parse_result res;
+
+    for (mgjson::json_parse flags : {mgjson::json_parse(mgjson::ParseDefault), mgjson::json_parse(mgjson::BuildTape)}) {
+        EXPECT_TRUE(mgjson::from_json("[\"a\" \"b\"]", &res, flags).is_undefined());
+        EXPECT_EQ(res.error, mgjson::parse_result::SquareBracketExpected);
+        EXPECT_EQ(res.offset, 5);
+        EXPECT_TRUE(mgjson::from_json("{\"k\":\"a\" \"b\"}", &res, flags).is_undefined());
+        EXPECT_EQ(res.error, mgjson::parse_result::CurlyBracketExpected);
+        EXPECT_EQ(res.offset, 9);
+
+        flags |= mgjson::JoinStrings;
+        EXPECT_EQ(mgjson::from_json("[\"a\" \"b\"]", &res, flags).to_json(mgjson::Compact), "[\"ab\"]");
+        EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+        EXPECT_EQ(mgjson::from_json("{\"k\":\"a\"\n  \"b\"}", &res, flags)["k"].to_string(), "ab");
+        EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    }
+
+    // Skipped and checked values.
+    EXPECT_TRUE(mgjson::from_json("{\"k\":\"a\" \"b\"}", mgjson_projection{"/x"}, &res).is_undefined());
+    EXPECT_EQ(res.error, mgjson::parse_result::CurlyBracketExpected);
+    EXPECT_EQ(mgjson::from_json("{\"k\":\"a\" \"b\", \"x\": 1}", mgjson_projection{"/x"}, &res,
+                                mgjson::JoinStrings).to_json(mgjson::Compact), "{\"x\":1}");
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_TRUE(mgjson::raw_json("{\"k\":\"a\" \"b\"}", &res).is_undefined());
+    EXPECT_EQ(res.error, mgjson::parse_result::CurlyBracketExpected);
+
+    // Top-level string is complete without the next one.
+    EXPECT_EQ(mgjson::from_json("\"a\" \"b\"", &res).to_string(), "a");
+    EXPECT_EQ(res.error, mgjson::parse_result::MoreData);
+}
+
+TEST(FromJson, StringAutocast)
+{
+    mgjson json = mgjson::from_json("[\"12\", \"-1.5\", \"on\"]");
+    ASSERT_TRUE(json.is_array());
+    EXPECT_TRUE(json[size_t(0)].is_string());
+    EXPECT_EQ(json[size_t(0)].to_int(), 12);
+    EXPECT_EQ(json[1].to_double(), -1.5);
+    EXPECT_TRUE(json[2].to_bool());
+}
+
+TEST(FromJson, Compound)
+{
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json(
+        "{\n"
+        "  \"name\": \"value\",\n"
+        "  \"array\": [1, 2.5, \"three\", [], {}],\n"
+        "  \"object\": {\"inner\": null}\n"
+        "}", &res);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    ASSERT_TRUE(json.is_object());
+    EXPECT_EQ(json.count(), 3U);
+    EXPECT_EQ(json["name"].to_string(), "value");
+
+    mgjson array = json["array"];
+    ASSERT_TRUE(array.is_array());
+    ASSERT_EQ(array.count(), 5U);
+    EXPECT_EQ(array[size_t(0)].to_int(), 1);
+    EXPECT_EQ(array[1].to_double(), 2.5);
+    EXPECT_EQ(array[2].to_string(), "three");
+    EXPECT_TRUE(array[3].is_array());
+    EXPECT_EQ(array[3].count(), 0U);
+    EXPECT_TRUE(array[4].is_object());
+    EXPECT_EQ(array[4].count(), 0U);
+
+    EXPECT_TRUE(json["object"].is_object());
+    EXPECT_TRUE(json["object"].has_key("inner"));
+    EXPECT_TRUE(json["object"]["inner"].is_null());
+}
+
+TEST(FromJson, WithLength)
+{
+    static const char data[] = "[1,2][3]";
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json(data, 5, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(res.offset, 5);
+    EXPECT_EQ(json.count(), 2U);
+
+    json = mgjson::from_json(std::string(data), &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::MoreData);
+    EXPECT_TRUE(res.isOk());
+    EXPECT_EQ(res.offset, 5);
+    EXPECT_EQ(json.count(), 2U);
+}
+
+struct ErrorParam
+{
+    const char* json;
+    mgjson::parse_result::parse_error error;
+    int offset, row, col;
+};
+
+::std::ostream& operator<<(::std::ostream& os, const ErrorParam& p)
+{
+    os << p.json;
+    return os;
+}
+
+class FromJsonError : public ::testing::TestWithParam<ErrorParam>
+{
+};
+
+TEST_P(FromJsonError, Error)
+{
+    const ErrorParam& p = GetParam();
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json(p.json, &res);
+    EXPECT_EQ(res.error, p.error);
+    EXPECT_EQ(res.offset, p.offset);
+    EXPECT_EQ(res.row, p.row);
+    EXPECT_EQ(res.col, p.col);
+    EXPECT_FALSE(res.isOk());
+    EXPECT_TRUE(json.is_undefined());
+}
+
+#define _err(s,e,o,r,c) ErrorParam{s, mgjson::parse_result::e, o, r, c}
+
+INSTANTIATE_TEST_CASE_P(, FromJsonError, ::testing::Values(
+    _err("", EndOfData, 0, 1, 1),
+    _err("  \n ", EndOfData, 4, 2, 2),
+    _err("nul", EndOfData, 3, 1, 4),
+    _err("nulL", InvalidCharacter, 3, 1, 4),
+    _err("-", EndOfData, 1, 1, 2),
+    _err("-a", IntExpected, 1, 1, 2),
+    _err("1.e5", IntExpected, 2, 1, 3),
+    _err("1e+", EndOfData, 3, 1, 4),
+    _err("012", InvalidNumber, 1, 1, 2),
+    _err("[1,\n 2 3]", SquareBracketExpected, 7, 2, 4),
+    _err("[1,]", InvalidCharacter, 3, 1, 4),
+    _err("{\"a\" 1}", ColonExpected, 5, 1, 6),
+    _err("{\"a\":1 \"b\":2}", CurlyBracketExpected, 7, 1, 8),
+    _err("{1:2}", InvalidName, 1, 1, 2),
+    _err("{\"\":2}", InvalidName, 1, 1, 2),
+    _err("{\"a\\u0000\":2}", InvalidName, 1, 1, 2),
+    _err("{\"a\":1,\n\"a\":2}", DuplicateName, 8, 2, 1),
+    _err("{\"a\":1,\n\"a\"\n:\n2}", DuplicateName, 8, 2, 1),
+    _err("[\n1,\n2,\n3,\n4,\n5,\n6,\n7,\n8,\n9,\n10,\n11,\n12,\n13,\n14,\n15,\n16,\n17,\n18,\n19,\n20,"
+         "\n21,\n  22 23]", SquareBracketExpected, 82, 23, 6),
+    _err("\"abc", EndOfData, 4, 1, 5),
+    _err("\"a\tb\"", InvalidCharacter, 2, 1, 3),
+    _err("\"\\x\"", InvalidCharacter, 2, 1, 3),
+    _err("\"\\u12G4\"", InvalidCharacter, 5, 1, 6),
+    _err("\"\\ud83d\"", InvalidCharacter, 1, 1, 2),
+    _err("\"\\ude00\"", InvalidCharacter, 1, 1, 2),
+    _err("{\"a\":[1,{\"b\":}]}", InvalidCharacter, 13, 1, 14)
+));
+#undef _err
+
+TEST(FromJsonLines, Simple)
+{
+    static const char data[] =
+        "{\"id\": 1}\n"
+        "\n"
+        "[1, 2, 3]\r\n"
+        "\"text\"\n"
+        "{\"id\": }\n"
+        "42";
+    std::vector<mgjson::parse_result> results;
+    std::vector<mgjson> values = mgjson::from_json_lines(data, sizeof(data) - 1, &results);
+    ASSERT_EQ(values.size(), 5U);
+    ASSERT_EQ(results.size(), 5U);
+
+    EXPECT_EQ(results[0].error, mgjson::parse_result::NoError);
+    EXPECT_EQ(values[0]["id"].to_int(), 1);
+    EXPECT_EQ(results[1].error, mgjson::parse_result::NoError);
+    EXPECT_EQ(values[1].count(), 3U);
+    EXPECT_EQ(results[2].error, mgjson::parse_result::NoError);
+    EXPECT_EQ(values[2].to_string(), "text");
+
+    EXPECT_EQ(results[3].error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(results[3].offset, 36);
+    EXPECT_EQ(results[3].row, 5);
+    EXPECT_EQ(results[3].col, 8);
+    EXPECT_TRUE(values[3].is_undefined());
+
+    EXPECT_EQ(results[4].error, mgjson::parse_result::NoError);
+    EXPECT_EQ(values[4].to_int(), 42);
+}
+
+TEST(FromJsonLines, Parallel)
+{
+    std::string data;
+    for (int i = 0; i < 20000; ++i) {
+        data += "{\"index\": " + std::to_string(i) + ", \"name\": \"record\"}\n";
+    }
+
+    std::vector<mgjson> values = mgjson::from_json_lines(data, nullptr, 4);
+    ASSERT_EQ(values.size(), 20000U);
+    for (size_t i = 0; i < values.size(); ++i) {
+        ASSERT_EQ(values[i]["index"].to_ulonglong(), i);
+    }
+
+    size_t expected = 0;
+    mgjson::from_json_lines(data, [&](size_t index, const mgjson& value,
+                                      const mgjson::parse_result& result) {
+        ASSERT_EQ(index, expected);
+        ASSERT_EQ(result.error, mgjson::parse_result::NoError);
+        ASSERT_EQ(result.row, static_cast<int>(index) + 1);
+        ASSERT_EQ(value["index"].to_ulonglong(), index);
+        ++expected;
+    }, 3);
+    EXPECT_EQ(expected, 20000U);
+}
+
+TEST(FromJsonParallel, SameAsSequential)
+{
+    std::string data = "\n[\n";
+    for (int i = 0; i < 5000; ++i) {
+        if (0 != i) {
+            data += ",\n";
+        }
+        data += "  {\"id\": " + std::to_string(i)
+                + ", \"text\": \"quote \\\" backslash \\\\\", \"list\": [1, [2], {\"a\": \"]}\"}]}";
+    }
+    data += "\n]\n";
+
+    mgjson::parse_result res_seq, res_par;
+    mgjson seq = mgjson::from_json(data, &res_seq);
+    mgjson par = mgjson::from_json_parallel(data, &res_par, 4);
+    ASSERT_EQ(res_seq.error, mgjson::parse_result::NoError);
+    ASSERT_EQ(res_par.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(res_par.offset, res_seq.offset);
+    EXPECT_EQ(res_par.row, res_seq.row);
+    EXPECT_EQ(res_par.col, res_seq.col);
+
+    // Rows are not counted on success, only on request.
+    EXPECT_EQ(res_seq.offset, static_cast<int>(data.size()));
+    EXPECT_EQ(res_seq.row, 0);
+    EXPECT_EQ(res_seq.col, 0);
+    res_par.compute_position(data);
+    EXPECT_EQ(res_par.row, 5004);
+    EXPECT_EQ(res_par.col, 1);
+
+    ASSERT_TRUE(par.is_array());
+    ASSERT_EQ(par.count(), 5000U);
+    for (size_t i = 0; i < par.count(); ++i) {
+        mgjson item = par.at(i);
+        ASSERT_EQ(item["id"].to_ulonglong(), i);
+        ASSERT_EQ(item["text"].to_string(), "quote \" backslash \\");
+        ASSERT_EQ(item["list"].at(2)["a"].to_string(), "]}");
+    }
+}
+
+TEST(FromJsonParallel, Errors)
+{
+    std::string data = "[";
+    for (int i = 0; i < 5000; ++i) {
+        data += "{\"id\": " + std::to_string(i) + "},\n";
+    }
+    std::string broken = data + "{\"id\": }]";
+    data += "{}]";
+
+    mgjson::parse_result res_seq, res_par;
+    mgjson::from_json(broken, &res_seq);
+    mgjson json = mgjson::from_json_parallel(broken, &res_par, 4);
+    EXPECT_TRUE(json.is_undefined());
+    EXPECT_EQ(res_par.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(res_par.error, res_seq.error);
+    EXPECT_EQ(res_par.offset, res_seq.offset);
+    EXPECT_EQ(res_par.row, res_seq.row);
+    EXPECT_EQ(res_par.col, res_seq.col);
+
+    json = mgjson::from_json_parallel(data + " [1]", &res_par, 4);
+    EXPECT_EQ(res_par.error, mgjson::parse_result::MoreData);
+    EXPECT_EQ(json.count(), 5001U);
+
+    json = mgjson::from_json_parallel(data + "]", &res_par, 4);
+    EXPECT_EQ(res_par.error, mgjson::parse_result::MoreData);
+    EXPECT_EQ(json.count(), 5001U);
+
+    // Trailing data without brackets.
+    for (const char* tail : {" garbage", "\n5", "x "}) {
+        json = mgjson::from_json_parallel(data + tail, &res_par, 4);
+        mgjson::from_json(data + tail, &res_seq);
+        EXPECT_EQ(res_par.error, mgjson::parse_result::MoreData);
+        EXPECT_EQ(res_par.error, res_seq.error);
+        EXPECT_EQ(res_par.offset, res_seq.offset);
+        EXPECT_EQ(json.count(), 5001U);
+    }
+}
+
+TEST(FromJsonParallel, DepthLimit)
+{
+    // Elements nested up to the default limit, counting top-level array.
+    const std::string limit = std::string(mgjson::parse_options::DefaultMaxDepth - 1, '[')
+            + std::string(mgjson::parse_options::DefaultMaxDepth - 1, ']');
+    std::string data = "[";
+    for (int i = 0; i < 100; ++i) {
+        data += limit + ",";
+    }
+    const std::string deeper = data + "[" + limit + "]]";
+    data += limit + "]";
+
+    mgjson::parse_result res_seq, res_par;
+    EXPECT_EQ(mgjson::from_json_parallel(data, &res_par, 4).count(), 101U);
+    EXPECT_EQ(res_par.error, mgjson::parse_result::NoError);
+
+    EXPECT_TRUE(mgjson::from_json_parallel(deeper, &res_par, 4).is_undefined());
+    mgjson::from_json(deeper, &res_seq);
+    EXPECT_EQ(res_par.error, mgjson::parse_result::DepthLimitExceeded);
+    EXPECT_EQ(res_par.error, res_seq.error);
+    EXPECT_EQ(res_par.offset, res_seq.offset);
+}
+
+TEST(FromJsonFile, File)
+{
+    static const char file_name[] = "mgjson_from_json_file_test.json";
+    static const char data[] = "{\"a\": [1, 2, 3],\n \"b\": \"text\"}\n";
+    FILE* f = fopen(file_name, "wb");
+    ASSERT_NE(f, nullptr);
+    fwrite(data, 1, sizeof(data) - 1, f);
+    fclose(f);
+
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json_file(file_name, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(res.offset, static_cast<int>(sizeof(data) - 1));
+    EXPECT_EQ(json["a"].count(), 3U);
+    EXPECT_EQ(json["b"].to_string(), "text");
+
+    json = mgjson::from_json_file(std::string(file_name), &res, 0);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json["a"].count(), 3U);
+
+    static const char lines_data[] = "{\"id\": 1}\n{\"id\": 2}\n{\"id\": 3}\n";
+    f = fopen(file_name, "wb");
+    ASSERT_NE(f, nullptr);
+    fwrite(lines_data, 1, sizeof(lines_data) - 1, f);
+    fclose(f);
+
+    int sum = 0;
+    mgjson::from_json_lines_file(file_name, [&](size_t, const mgjson& value,
+                                                const mgjson::parse_result& line_res) {
+        EXPECT_EQ(line_res.error, mgjson::parse_result::NoError);
+        sum += value["id"].to_int();
+    }, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(sum, 6);
+
+#if defined(__unix__) || defined(__APPLE__)
+    // Offsets past INT_MAX would not fit parse_result (file is sparse here).
+    f = fopen(file_name, "wb");
+    ASSERT_NE(f, nullptr);
+    fputc('[', f);
+    ASSERT_EQ(fseek(f, std::numeric_limits<int>::max(), SEEK_SET), 0);
+    fputc(']', f);
+    fclose(f);
+    json = mgjson::from_json_file(file_name, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::SizeLimitExceeded);
+    EXPECT_TRUE(json.is_undefined());
+    mgjson::from_json_lines_file(file_name, [&](size_t, const mgjson&, const mgjson::parse_result&) {
+        ADD_FAILURE();
+    }, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::SizeLimitExceeded);
+#endif
+
+    remove(file_name);
+
+    json = mgjson::from_json_file(file_name, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::FileError);
+    EXPECT_TRUE(json.is_undefined());
+}
+
+TEST(FromJson, ValidateUtf8)
+{
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json("[\"\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82\", "
+                                    "\"\xE2\x82\xAC\", \"\xF0\x9F\x98\x80\"]", &res, mgjson::ValidateUtf8);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.count(), 3U);
+    EXPECT_EQ(json[2].to_string(), "\xF0\x9F\x98\x80");
+
+    static const char invalid[] = "{\n  \"a\": \"ok\",\n  \"b\": \"x\xC0\xAFy\"\n}";
+    json = mgjson::from_json(invalid, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    json = mgjson::from_json(invalid, &res, mgjson::ValidateUtf8);
+    EXPECT_EQ(res.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(res.offset, 24);
+    EXPECT_EQ(res.row, 3);
+    EXPECT_EQ(res.col, 10);
+    EXPECT_TRUE(json.is_undefined());
+
+    json = mgjson::from_json("\"\xE2\x82\"", &res, mgjson::ValidateUtf8);
+    EXPECT_EQ(res.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(res.offset, 1);
+}
+
+TEST(ValidateUtf8, Sequences)
+{
+    size_t offset = 0;
+    EXPECT_TRUE(mgjson::validate_utf8(std::string()));
+    EXPECT_TRUE(mgjson::validate_utf8("\x7F\xC2\x80\xDF\xBF\xE0\xA0\x80\xED\x9F\xBF\xEE\x80\x80"
+                                      "\xF0\x90\x80\x80\xF4\x8F\xBF\xBF"));
+    EXPECT_FALSE(mgjson::validate_utf8("\xC1\xBF", &offset));                 // Overlong
+    EXPECT_EQ(offset, 0U);
+    EXPECT_FALSE(mgjson::validate_utf8("a\xE0\x9F\xBF", &offset));            // Overlong
+    EXPECT_EQ(offset, 1U);
+    EXPECT_FALSE(mgjson::validate_utf8("ab\xED\xA0\x80", &offset));           // Surrogate
+    EXPECT_EQ(offset, 2U);
+    EXPECT_FALSE(mgjson::validate_utf8("\xF4\x90\x80\x80", &offset));         // Above U+10FFFF
+    EXPECT_EQ(offset, 0U);
+    EXPECT_FALSE(mgjson::validate_utf8("\xC2\x80\x80", &offset));             // Lone continuation
+    EXPECT_EQ(offset, 2U);
+    EXPECT_FALSE(mgjson::validate_utf8("\xF0\x9F\x98", &offset));             // Truncated
+    EXPECT_EQ(offset, 0U);
+
+    std::string text(1000, 'a');
+    text.replace(200, 3, "\xE2\x82\xAC");
+    EXPECT_TRUE(mgjson::validate_utf8(text));
+    text[700] = '\xFF';
+    EXPECT_FALSE(mgjson::validate_utf8(text, &offset));
+    EXPECT_EQ(offset, 700U);
+}
+
+TEST(FromJsonProjection, Select)
+{
+    static const char data[] =
+        "{\"user\": {\"id\": 7, \"name\": \"x\", \"tags\": [\"a\", \"]\", {\"b\": \"}\\\"\"}]},\n"
+        " \"items\": [{\"price\": 1.5, \"qty\": 2}, {\"qty\": 3}, 4, {\"price\": 2, \"skip\": [[[]]]}],\n"
+        " \"other\": {\"deep\": [1, 2, {\"x\": null}]}, \"text\": \"a\" \"b\"}";
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json(data, sizeof(data) - 1,
+                                    mgjson_projection{"/user/id", "/items/*/price", "/items/1"},
+                                    &res, mgjson::JoinStrings);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(res.offset, static_cast<int>(sizeof(data) - 1));
+    EXPECT_EQ(res.row, 0);
+    res.compute_position(data);
+    EXPECT_EQ(res.row, 3);
+    EXPECT_EQ(json.to_json(mgjson::Compact),
+              "{\"items\":[{\"price\":1.5},{\"qty\":3},null,{\"price\":2}],\"user\":{\"id\":7}}");
+    EXPECT_TRUE(json["items"][2].is_undefined());
+
+    json = mgjson::from_json(data, sizeof(data) - 1, mgjson_projection{"/*/tags", "/text"}, &res,
+                             mgjson::JoinStrings);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.to_json(mgjson::Compact),
+              "{\"items\":[null,null,null,null],\"other\":{},"
+              "\"text\":\"ab\",\"user\":{\"tags\":[\"a\",\"]\",{\"b\":\"}\\\"\"}]}}");
+
+    json = mgjson::from_json(std::string(data), mgjson_projection{""}, &res, mgjson::JoinStrings);
+    EXPECT_EQ(json.to_json(mgjson::Compact),
+              mgjson::from_json(data, nullptr, mgjson::JoinStrings).to_json(mgjson::Compact));
+
+    json = mgjson::from_json("[1, 2]", mgjson_projection{"/a/b"}, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.count(), 2U);
+
+    json = mgjson::from_json("7", mgjson_projection{"/a"}, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_TRUE(json.is_undefined());
+
+    mgjson_projection escaped{"/a~1b/c~0d"};
+    json = mgjson::from_json("{\"a/b\": {\"c~d\": 1, \"e\": 2}}", escaped, &res);
+    EXPECT_EQ(json.to_json(mgjson::Compact), "{\"a/b\":{\"c~d\":1}}");
+
+    // Segments are indexes of arrays only when written as std::to_string() does.
+    mgjson_projection numbers{"/01", "/2", "/ab", "/a", "/99999999999999999999999"};
+    json = mgjson::from_json("[0, 1, 2, 3]", numbers, &res);
+    EXPECT_EQ(json.to_json(mgjson::Compact), "[null,null,2,null]");
+    json = mgjson::from_json("{\"01\": 1, \"1\": 2, \"2\": 3, \"a\": 4, \"abc\": 5}", numbers, &res);
+    EXPECT_EQ(json.to_json(mgjson::Compact), "{\"01\":1,\"2\":3,\"a\":4}");
+
+    EXPECT_THROW(mgjson_projection{"a"}, std::invalid_argument);
+    EXPECT_THROW(mgjson_projection{"/a~2"}, std::invalid_argument);
+}
+
+TEST(FromJsonProjection, Errors)
+{
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json("{\"a\": [1, {\"b\": 2}", mgjson_projection{"/x"}, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::EndOfData);
+    EXPECT_EQ(res.offset, 18);
+    EXPECT_TRUE(json.is_undefined());
+
+    json = mgjson::from_json("{\"a\": \"abc", mgjson_projection{"/x"}, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::EndOfData);
+
+    json = mgjson::from_json("{\"a\": 1, \"x\": tru}", mgjson_projection{"/x"}, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(res.offset, 17);
+
+    json = mgjson::from_json("{\"a\": 1 \"x\": 2}", mgjson_projection{"/x"}, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::CurlyBracketExpected);
+    EXPECT_EQ(res.offset, 8);
+
+    json = mgjson::from_json("{\"x\": 1, \"x\": 2}", mgjson_projection{"/x"}, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::DuplicateName);
+}
+
+TEST(FromJsonFiltered, Records)
+{
+    static const char data[] =
+        "[{\"level\": \"INFO\", \"msg\": \"started\", \"ctx\": {\"a\": [1, 2]}},\n"
+        " {\"level\": \"ERROR\", \"msg\": \"failed\", \"ctx\": {\"code\": 5}},\n"
+        " {\"msg\": \"no level\"},\n"
+        " 17,\n"
+        " {\"level\": \"ERROR\", \"msg\": \"again\"}]";
+    mgjson::parse_result res;
+    size_t calls = 0;
+    mgjson json = mgjson::from_json_filtered(data, sizeof(data) - 1, mgjson_projection{"/level"},
+                                             [&](const mgjson& record) {
+        ++calls;
+        EXPECT_FALSE(record.has_key("msg"));
+        return record["level"].to_string() == "ERROR";
+    }, &res);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(calls, 5U);
+    EXPECT_EQ(json.to_json(mgjson::Compact),
+              "[{\"ctx\":{\"code\":5},\"level\":\"ERROR\",\"msg\":\"failed\"},"
+              "{\"level\":\"ERROR\",\"msg\":\"again\"}]");
+
+    json = mgjson::from_json_filtered(std::string("{\"level\": \"ERROR\"}"), mgjson_projection{"/level"},
+                                      [](const mgjson&) { return false; }, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json["level"].to_string(), "ERROR");
+
+    json = mgjson::from_json_filtered(std::string("[{\"level\": \"ERROR\", \"x\": tru}]"),
+                                      mgjson_projection{"/level"},
+                                      [](const mgjson&) { return true; }, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::InvalidCharacter);
+    EXPECT_EQ(res.offset, 28);
+    EXPECT_TRUE(json.is_undefined());
+}
+
+TEST(Parser, Reuse)
+{
+    mgjson_parser parser;
+    mgjson::parse_result res;
+    for (int i = 0; i < 3; ++i) {
+        mgjson json = parser.parse("{\"a\": [1, [2, [3, \"x\\ty\"]], []], \"b\": \"text\"}", &res);
+        ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+        EXPECT_EQ(json.to_json(mgjson::Compact), "{\"a\":[1,[2,[3,\"x\\ty\"]],[]],\"b\":\"text\"}");
+
+        json = parser.parse(std::string("[1, [2, 3"), &res);
+        EXPECT_EQ(res.error, mgjson::parse_result::EndOfData);
+        EXPECT_TRUE(json.is_undefined());
+
+        json = parser.parse(std::string("{\"a\": 1, \"b\": [2]}"), mgjson_projection{"/b"}, &res);
+        EXPECT_EQ(json.to_json(mgjson::Compact), "{\"b\":[2]}");
+    }
+    parser.shrink();
+    EXPECT_EQ(parser.parse(std::string("[[], [[]]]")).to_json(mgjson::Compact), "[[],[[]]]");
+}
+
+TEST(FromJsonOptions, Limits)
+{
+    mgjson::parse_options options;
+    options.max_depth = 2;
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json(std::string("[1, {\"a\": [2]}]"), options, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::DepthLimitExceeded);
+    EXPECT_EQ(res.offset, 10);
+    EXPECT_TRUE(json.is_undefined());
+    json = mgjson::from_json(std::string("[1, {\"a\": 2}, [], {}]"), options, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    json = mgjson::from_json(std::string("{\"a\": 1, \"b\": {\"c\": [3]}}"), mgjson_projection{"/b"},
+                             &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    options.max_depth = 0;
+
+    options.max_size = 8;
+    mgjson::from_json(std::string("[1, 2, 3]"), options, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::SizeLimitExceeded);
+    EXPECT_EQ(res.offset, 8);
+    mgjson::from_json(std::string("[1, 2]"), options, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    options.max_size = 0;
+
+    options.max_string_length = 3;
+    mgjson::from_json(std::string("[\"abc\", \"a\\u0062cd\"]"), options, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::StringLimitExceeded);
+    EXPECT_EQ(res.offset, 8);
+    mgjson::from_json(std::string("{\"long\": 1}"), options, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::StringLimitExceeded);
+    EXPECT_EQ(res.offset, 1);
+    json = mgjson::from_json(std::string("{\"abc\": \"\\u00e9\"}"), options, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+
+    mgjson_parser parser(options);
+    parser.parse(std::string("[\"abcd\"]"), &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::StringLimitExceeded);
+    parser.parse(std::string("[\"abc\"]"), &res, mgjson::ValidateUtf8);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+}
+
+TEST(FromJsonOptions, DefaultDepth)
+{
+    const size_t deep = 200000;
+    mgjson::parse_result res;
+    EXPECT_TRUE(mgjson::from_json(std::string(deep, '[') + std::string(deep, ']'), &res).is_undefined());
+    EXPECT_EQ(res.error, mgjson::parse_result::DepthLimitExceeded);
+    EXPECT_EQ(res.offset, static_cast<int>(mgjson::parse_options::DefaultMaxDepth));
+
+    const size_t depth = mgjson::parse_options::DefaultMaxDepth;
+    mgjson json = mgjson::from_json(std::string(depth, '[') + std::string(depth, ']'), &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_FALSE(json.is_undefined());
+    mgjson::from_json(std::string(deep, '[') + std::string(deep, ']'), nullptr, mgjson::BuildTape);
+    mgjson::from_json_parallel(std::string(deep, '[') + std::string(deep, ']'), &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::DepthLimitExceeded);
+}
+
+TEST(FromJsonOptions, Duplicates)
+{
+    static const char data[] = "{\"b\": 1, \"a\": [2], \"b\": {\"x\": 3}, \"a\": 4, \"b\": 5}";
+    mgjson::parse_options options;
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json(std::string(data), options, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::DuplicateName);
+    EXPECT_EQ(res.offset, 19);
+
+    options.duplicates = mgjson::DuplicateFirstWins;
+    json = mgjson::from_json(std::string(data), options, &res);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.to_json(mgjson::Compact), "{\"a\":[2],\"b\":1}");
+
+    options.duplicates = mgjson::DuplicateLastWins;
+    json = mgjson::from_json(std::string(data), options, &res);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.to_json(mgjson::Compact), "{\"a\":4,\"b\":5}");
+
+    options.duplicates = mgjson::DuplicateKeepAll;
+    json = mgjson::from_json(std::string(data), options, &res);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.to_json(mgjson::Compact), "{\"a\":[[2],4],\"b\":[1,{\"x\":3},5]}");
+
+    json = mgjson::from_json(std::string("{\"a\": 1, \"b\": 2, \"c\": {\"d\": 3, \"e\": 4}}"), options, &res);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.to_json(mgjson::Compact), "{\"a\":1,\"b\":2,\"c\":{\"d\":3,\"e\":4}}");
+}
+
+TEST(FromJson, PreserveNumbers)
+{
+    static const char data[] =
+        "[123456789012345678901234567890,-42,0.10000000000000000000001,1E400,2.50,-0,1e2]";
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json(data, &res, mgjson::PreserveNumbers);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.to_json(mgjson::Compact), data);
+
+    EXPECT_EQ(json.at(static_cast<size_t>(0)).type(), mgjson::Integer);
+    EXPECT_EQ(json.at(static_cast<size_t>(0)).to_string(), "123456789012345678901234567890");
+    EXPECT_EQ(json.at(static_cast<size_t>(0)).to_ulonglong(), std::numeric_limits<unsigned long long>::max());
+    EXPECT_TRUE(json.at(static_cast<size_t>(0)).to_bool());
+    EXPECT_EQ(json.at(1).type(), mgjson::Integer);
+    EXPECT_EQ(json.at(1).to_int(), -42);
+    EXPECT_EQ(json.at(1).to_double(), -42.0);
+    EXPECT_EQ(json.at(2).type(), mgjson::Double);
+    EXPECT_DOUBLE_EQ(json.at(2).to_double(), 0.1);
+    EXPECT_EQ(json.at(4).type(), mgjson::Double);
+    EXPECT_EQ(json.at(4).to_double(), 2.5);
+    EXPECT_EQ(json.at(4).to_int(), 2);
+    EXPECT_FALSE(json.at(5).to_bool());
+    EXPECT_EQ(json.at(6).type(), mgjson::Double);
+    EXPECT_EQ(json.at(6).to_int(), 100);
+
+    // Lexeme is converted once, on first read.
+    const mgjson number = mgjson::from_json("2.50", nullptr, mgjson::PreserveNumbers);
+    EXPECT_TRUE(mgjson_private::get(number)->expand_pending_);
+    EXPECT_EQ(number.to_double(), 2.5);
+    EXPECT_FALSE(mgjson_private::get(number)->expand_pending_);
+    EXPECT_EQ(number.to_int(), 2);
+    EXPECT_EQ(number.to_json(), "2.50");
+
+    json = mgjson::from_json(data, &res);
+    EXPECT_EQ(json.at(static_cast<size_t>(0)).type(), mgjson::Double);
+    EXPECT_NE(json.to_json(mgjson::Compact), data);
+}
+
+TEST(FromJson, BuildTape)
+{
+    static const char data[] = "{\"name\": \"tape\", \"list\": [1, -2, 2.5, true, false, null, [], {}],"
+                               " \"nested\": {\"z\": [\"a\\tb\", \"c\" \"d\"], \"a\": {\"b\": 18446744073709551615}}}";
+    mgjson::parse_result res;
+    const mgjson tape = mgjson::from_json(data, &res, mgjson::BuildTape | mgjson::JoinStrings);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    const mgjson tree = mgjson::from_json(data, nullptr, mgjson::JoinStrings);
+    EXPECT_EQ(tape.to_json(), tree.to_json());
+    EXPECT_EQ(tape.hash(), tree.hash());
+    EXPECT_EQ(tape.keys(), tree.keys());
+    EXPECT_EQ(tape["list"].count(), 8U);
+    EXPECT_EQ(tape["list"][1].to_int(), -2);
+    EXPECT_EQ(tape["nested"]["z"][1].to_string(), "cd");
+    EXPECT_EQ(tape["nested"]["a"]["b"].to_ulonglong(), 18446744073709551615ULL);
+
+    // Serializers read tape in place.
+    EXPECT_EQ(tape.msgpack(), tree.msgpack());
+    EXPECT_EQ(tape.msgpack_size(), tree.msgpack_size());
+    EXPECT_EQ(tape.to_cbor(), tree.to_cbor());
+    EXPECT_EQ(tape.to_bson(), tree.to_bson());
+    EXPECT_EQ(tape.to_json(mgjson::MaxReadable), tree.to_json(mgjson::MaxReadable));
+    EXPECT_TRUE(mgjson_private::get(tape)->in_image());
+    EXPECT_TRUE(mgjson_private::get(tape["nested"])->in_image());
+
+    mgjson copy = tape;
+    copy["nested"]["a"]["c"] = 3;
+    copy["list"].remove(static_cast<size_t>(0));
+    EXPECT_EQ(copy["nested"]["a"].to_json(mgjson::Compact), "{\"b\":18446744073709551615,\"c\":3}");
+    EXPECT_EQ(copy["list"].count(), 7U);
+    EXPECT_EQ(tape.to_json(), tree.to_json());
+
+    static const char numbers[] = "[123456789012345678901234567890,0.10,1E400]";
+    EXPECT_EQ(mgjson::from_json(numbers, &res, mgjson::BuildTape | mgjson::PreserveNumbers)
+              .to_json(mgjson::Compact), numbers);
+
+    static const char duplicates[] = "{\"b\": 1, \"a\": [2], \"b\": {\"x\": 3}, \"a\": 4, \"b\": 5}";
+    mgjson::parse_options options;
+    options.flags = mgjson::BuildTape;
+    EXPECT_TRUE(mgjson::from_json(std::string(duplicates), options, &res).is_undefined());
+    EXPECT_EQ(res.error, mgjson::parse_result::DuplicateName);
+    EXPECT_EQ(res.offset, 19);
+    // The first repeat in document, as with tree.
+    for (const char* nested : {"{\"a\":1,\"a\":{\"b\":1,\"b\":2}}", "{\"a\":{\"b\":1,\"b\":2},\"a\":1}"}) {
+        mgjson::parse_result res_tree;
+        EXPECT_TRUE(mgjson::from_json(nested, &res, mgjson::BuildTape).is_undefined());
+        EXPECT_TRUE(mgjson::from_json(nested, &res_tree).is_undefined());
+        EXPECT_EQ(res.error, mgjson::parse_result::DuplicateName);
+        EXPECT_EQ(res.error, res_tree.error);
+        EXPECT_EQ(res.offset, res_tree.offset);
+    }
+    EXPECT_EQ(res.offset, 12);
+    options.duplicates = mgjson::DuplicateFirstWins;
+    EXPECT_EQ(mgjson::from_json(std::string(duplicates), options).to_json(mgjson::Compact),
+              "{\"a\":[2],\"b\":1}");
+    options.duplicates = mgjson::DuplicateLastWins;
+    EXPECT_EQ(mgjson::from_json(std::string(duplicates), options).to_json(mgjson::Compact),
+              "{\"a\":4,\"b\":5}");
+    options.duplicates = mgjson::DuplicateKeepAll;
+    EXPECT_EQ(mgjson::from_json(std::string(duplicates), options).to_json(mgjson::Compact),
+              "{\"a\":[[2],4],\"b\":[1,{\"x\":3},5]}");
+
+    EXPECT_TRUE(mgjson::from_json("[1, {\"a\": 2]", &res, mgjson::BuildTape).is_undefined());
+    EXPECT_EQ(res.error, mgjson::parse_result::CurlyBracketExpected);
+    EXPECT_EQ(res.offset, 11);
+    EXPECT_EQ(mgjson::from_json("[1] 2", &res, mgjson::BuildTape).count(), 1U);
+    EXPECT_EQ(res.error, mgjson::parse_result::MoreData);
+    EXPECT_EQ(mgjson::from_json("\"text\"", &res, mgjson::BuildTape).to_string(), "text");
+}
@@ -0,0 +1,471 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "mgjson.h"
+#include "../src/mgjson_private.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <gtest/gtest.h>
+
+static mgjson sample()
+{
+    mgjson json;
+    json["name"] = "test";
+    json["id"] = 42;
+    json["flag"] = true;
+    json["none"] = mgjson();
+    json["list"].push_back(1);
+    json["list"].push_back(2);
+    json["list"].push_back(3);
+    json["empty_list"] = mgjson(mgjson::Array);
+    json["empty_object"] = mgjson(mgjson::Object);
+    json["child"]["a"] = "b";
+    return json;
+}
+
+TEST(ToJson, Compact)
+{
+    EXPECT_EQ(mgjson().to_json(mgjson::Compact), "null");
+    EXPECT_EQ(mgjson(-15).to_json(mgjson::Compact), "-15");
+    EXPECT_EQ(mgjson(false).to_json(mgjson::Compact), "false");
+    EXPECT_EQ(mgjson(1.5).to_json(mgjson::Compact), "1.5");
+    EXPECT_EQ(mgjson(mgjson::Undefined).to_json(mgjson::Compact), "null");
+    EXPECT_EQ(sample().to_json(mgjson::Compact),
+              "{\"child\":{\"a\":\"b\"},\"empty_list\":[],\"empty_object\":{},\"flag\":true,"
+              "\"id\":42,\"list\":[1,2,3],\"name\":\"test\",\"none\":null}");
+
+    mgjson json;
+    json["defined"] = 1;
+    json["undefined"] = mgjson(mgjson::Undefined);
+    EXPECT_EQ(json.to_json(mgjson::Compact), "{\"defined\":1}");
+
+    // Scalars made by type only.
+    mgjson typed(mgjson::Array);
+    typed.push_back(mgjson(mgjson::Integer));
+    typed.push_back(mgjson(mgjson::Bool));
+    typed.push_back(mgjson(mgjson::Double));
+    typed.push_back(mgjson(mgjson::String));
+    EXPECT_EQ(typed.to_json(mgjson::Compact), "[0,false,0,\"\"]");
+    EXPECT_EQ(typed.to_json(mgjson::Canonical), "[0,false,0,\"\"]");
+    EXPECT_EQ(mgjson::from_json(typed.to_json()).to_json(mgjson::Compact), "[0,false,0,\"\"]");
+}
+
+TEST(ToJson, Escaping)
+{
+    EXPECT_EQ(mgjson("plain text").to_json(mgjson::Compact), "\"plain text\"");
+    EXPECT_EQ(mgjson("q\"b\\s/").to_json(mgjson::Compact), "\"q\\\"b\\\\s/\"");
+    EXPECT_EQ(mgjson("\b\f\n\r\t\x01\x1F").to_json(mgjson::Compact),
+              "\"\\b\\f\\n\\r\\t\\u0001\\u001f\"");
+    EXPECT_EQ(mgjson("\xE2\x82\xAC").to_json(mgjson::Compact), "\"\xE2\x82\xAC\"");
+
+    std::string text(1000, 'x');
+    text[500] = '"';
+    text[999] = '\n';
+    std::string expected = "\"" + text.substr(0, 500) + "\\\"" + text.substr(501, 498) + "\\n\"";
+    EXPECT_EQ(mgjson(text).to_json(mgjson::Compact), expected);
+
+    mgjson json;
+    json["k\"ey"] = 1;
+    EXPECT_EQ(json.to_json(mgjson::Compact), "{\"k\\\"ey\":1}");
+}
+
+TEST(ToJson, Indented)
+{
+    EXPECT_EQ(sample().to_json(mgjson::Indented | mgjson::UseSpaces),
+              "{\n"
+              "    \"child\": {\n"
+              "        \"a\": \"b\"\n"
+              "    },\n"
+              "    \"empty_list\": [\n"
+              "    ],\n"
+              "    \"empty_object\": {\n"
+              "    },\n"
+              "    \"flag\": true,\n"
+              "    \"id\": 42,\n"
+              "    \"list\": [\n"
+              "        1,\n"
+              "        2,\n"
+              "        3\n"
+              "    ],\n"
+              "    \"name\": \"test\",\n"
+              "    \"none\": null\n"
+              "}");
+
+    mgjson json;
+    json["a"].push_back(1);
+    EXPECT_EQ(json.to_json(mgjson::Indented), "{\n\t\"a\": [\n\t\t1\n\t]\n}");
+}
+
+TEST(ToJson, MaxReadable)
+{
+    EXPECT_EQ(sample().to_json(mgjson::MaxReadable | mgjson::UseSpaces),
+              "{\n"
+              "    \"flag\":         true,\n"
+              "    \"id\":           42,\n"
+              "    \"name\":         \"test\",\n"
+              "    \"none\":         null,\n"
+              "    \"child\":        {\n"
+              "        \"a\": \"b\"\n"
+              "    },\n"
+              "    \"empty_list\":   [],\n"
+              "    \"empty_object\": {},\n"
+              "    \"list\":         [1, 2, 3]\n"
+              "}");
+}
+
+TEST(ToJson, SplitStrings)
+{
+    mgjson json;
+    json["text"] = "first line\nsecond line\nlast line\n";
+    std::string str = json.to_json(mgjson::Indented | mgjson::UseSpaces | mgjson::SplitStrings);
+    EXPECT_EQ(str,
+              "{\n"
+              "    \"text\": \"first line\\n\"\n"
+              "        \"second line\\n\"\n"
+              "        \"last line\\n\"\n"
+              "}");
+
+    mgjson::parse_result res;
+    mgjson parsed = mgjson::from_json(str, &res, mgjson::JoinStrings);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(parsed["text"].to_string(), json["text"].to_string());
+}
+
+TEST(ToJson, SplitSimpleArrays)
+{
+    mgjson json;
+    for (int i = 0; i < 30; ++i) {
+        json["values"].push_back(1000 + i);
+    }
+    std::string str = json.to_json(mgjson::MaxReadable | mgjson::UseSpaces);
+    EXPECT_EQ(str,
+              "{\n"
+              "    \"values\": [\n"
+              "        1000, 1001, 1002, 1003, 1004, 1005, 1006, 1007, 1008, 1009, 1010, 1011,\n"
+              "        1012, 1013, 1014, 1015, 1016, 1017, 1018, 1019, 1020, 1021, 1022, 1023,\n"
+              "        1024, 1025, 1026, 1027, 1028, 1029\n"
+              "    ]\n"
+              "}");
+
+    mgjson::parse_result res;
+    mgjson parsed = mgjson::from_json(str, &res);
+    EXPECT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(parsed.to_json(mgjson::Compact), json.to_json(mgjson::Compact));
+
+    json = mgjson();
+    for (int i = 0; i < 20; ++i) {
+        json["a"]["values"].push_back(100000 + i);
+    }
+    json["a"]["x"] = 1;
+    EXPECT_EQ(json.to_json(mgjson::MaxReadable),
+              "{\n"
+              "\t\"a\": {\n"
+              "\t\t\"x\":      1,\n"
+              "\t\t\"values\": [\n"
+              "\t\t\t100000, 100001, 100002, 100003, 100004, 100005, 100006, 100007,\n"
+              "\t\t\t100008, 100009, 100010, 100011, 100012, 100013, 100014, 100015,\n"
+              "\t\t\t100016, 100017, 100018, 100019\n"
+              "\t\t]\n"
+              "\t}\n"
+              "}");
+}
+
+TEST(ToJson, RoundTrip)
+{
+    static const char data[] =
+        "{\"array\":[{\"x\":1.25,\"y\":-3},[],[\"a\\u0000b\",\"\\u00e9\\ud83d\\ude00\"]],"
+        "\"object\":{\"nested\":{\"deep\":[true,false,null]}},\"str\":\"line\\nbreak\\ttab\"}";
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json(data, &res);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.to_json(mgjson::Compact),
+              "{\"array\":[{\"x\":1.25,\"y\":-3},[],[\"a\\u0000b\",\"\xC3\xA9\xF0\x9F\x98\x80\"]],"
+              "\"object\":{\"nested\":{\"deep\":[true,false,null]}},\"str\":\"line\\nbreak\\ttab\"}");
+
+    for (unsigned format : {0x0000U, 0x0001U, 0x0003U, 0x01FFU, 0x01FBU}) {
+        std::string str = json.to_json(static_cast<mgjson::json_format>(format));
+        mgjson parsed = mgjson::from_json(str, &res, mgjson::JoinStrings);
+        EXPECT_EQ(res.error, mgjson::parse_result::NoError) << str;
+        EXPECT_EQ(parsed.to_json(mgjson::Compact), json.to_json(mgjson::Compact)) << str;
+    }
+}
+
+TEST(ToJson, RawJson)
+{
+    mgjson::parse_result res;
+    mgjson fragment = mgjson::raw_json(std::string(" {\"b\" : [1,  2], \"a\":\"x\"}\n"), &res);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_TRUE(fragment.is_object());
+
+    mgjson json;
+    json["cached"] = fragment;
+    json["id"] = 1;
+    EXPECT_EQ(json.to_json(mgjson::Compact), "{\"cached\":{\"b\" : [1,  2], \"a\":\"x\"},\"id\":1}");
+
+    const mgjson copy = fragment;
+    EXPECT_EQ(copy.count(), 2U);
+    EXPECT_EQ(copy["b"][1].to_int(), 2);
+    EXPECT_EQ(copy.to_json(mgjson::Compact), "{\"b\" : [1,  2], \"a\":\"x\"}");
+    fragment["c"] = true;
+    EXPECT_EQ(fragment.to_json(mgjson::Compact), "{\"a\":\"x\",\"b\":[1,2],\"c\":true}");
+    EXPECT_EQ(copy.to_json(mgjson::Compact), "{\"b\" : [1,  2], \"a\":\"x\"}");
+
+    mgjson array = mgjson::raw_json(std::string("[{\"a\": 1, \"a\": 2}]"));
+    array.push_back(3);
+    EXPECT_EQ(array.to_json(mgjson::Compact), "[{\"a\":2},3]");
+
+    EXPECT_EQ(mgjson::raw_json(std::string(" 12 ")).to_int(), 12);
+    EXPECT_TRUE(mgjson::raw_json(std::string("[1, 2] 3"), &res).is_undefined());
+    EXPECT_EQ(res.error, mgjson::parse_result::MoreData);
+    EXPECT_TRUE(mgjson::raw_json(std::string("{\"a\": \"\\q\"}"), &res).is_undefined());
+    EXPECT_EQ(res.error, mgjson::parse_result::InvalidCharacter);
+}
+
+TEST(ToJson, Size)
+{
+    mgjson json = sample();
+    json["escapes"] = std::string("q\"b\\n\nt\tc\x01\x1F\x7F\xE2\x82\xAC", 16);
+    json["long key of object"] = mgjson::from_json("{\"x\": [], \"y\": {}, \"z\": [1, [2]]}");
+    json["undefined"] = mgjson(mgjson::Undefined);
+    json["hidden"]["only"] = mgjson(mgjson::Undefined);
+    json["numbers"] = mgjson::from_json("[1.50, -0, 1e2, 18446744073709551615]", nullptr,
+                                        mgjson::PreserveNumbers);
+    json["numbers"].push_back(std::numeric_limits<double>::infinity());
+    json["numbers"].push_back(0.1);
+    json["raw"] = mgjson::raw_json(std::string("{\"b\":   [1,   2], \"a\": \"\\u0041\"}"));
+    json["lines"] = "first\nsecond\n";
+
+    // All layouts; counted ones and written ones (with Split* flags) agree.
+    for (unsigned format = 0; format < 0x0400U; ++format) {
+        const mgjson::json_format f = static_cast<mgjson::json_format>(format);
+        EXPECT_EQ(json.to_json_size(f), json.to_json(f).size()) << format;
+    }
+    EXPECT_EQ(mgjson(mgjson::Undefined).to_json_size(), 4u);
+    EXPECT_EQ(mgjson("\x02").to_json_size(), 8u);
+}
+
+TEST(ToJson, Sinks)
+{
+    mgjson json = sample();
+    for (int i = 0; i < 50; ++i) {
+        json["values"].push_back(1000 * i);
+        json["records"].push_back(sample());
+    }
+    json["raw"] = mgjson::raw_json(std::string("[1,   2]"));
+
+    for (unsigned format : {0x0000U, 0x0001U, 0x00C3U, 0x0043U, 0x01FFU}) {
+        const mgjson::json_format f = static_cast<mgjson::json_format>(format);
+        const std::string expected = json.to_json(f);
+        EXPECT_EQ(json.to_json_size(f), expected.size());
+
+        std::string out = "prefix";
+        json.to_json(out, f);
+        EXPECT_EQ(out, "prefix" + expected);
+
+        for (size_t chunk_size : {1U, 7U, 100U, 65536U}) {
+            std::string chunks;
+            size_t max_chunk = 0;
+            EXPECT_TRUE(json.to_json([&](const char* data, size_t cb_data) {
+                chunks.append(data, cb_data);
+                max_chunk = std::max(max_chunk, cb_data);
+                return true;
+            }, f, chunk_size));
+            EXPECT_EQ(chunks, expected) << chunk_size;
+            EXPECT_LT(max_chunk, chunk_size + 200);
+        }
+    }
+
+    size_t calls = 0;
+    EXPECT_FALSE(json.to_json([&](const char*, size_t) { return (2 > ++calls); },
+                              mgjson::Compact, 16));
+    EXPECT_EQ(calls, 2U);
+
+    FILE* file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    EXPECT_TRUE(json.to_json(file, mgjson::Compact));
+    std::string text(static_cast<size_t>(ftell(file)), ' ');
+    rewind(file);
+    EXPECT_EQ(fread(&text[0], 1, text.size(), file), text.size());
+    fclose(file);
+    EXPECT_EQ(text, json.to_json(mgjson::Compact));
+}
+
+TEST(ToJson, Doubles)
+{
+    EXPECT_EQ(mgjson(0.1).to_string(), "0.1");
+    EXPECT_EQ(mgjson(-2.5).to_string(), "-2.5");
+    EXPECT_EQ(mgjson(100.0).to_string(), "100");
+    EXPECT_EQ(mgjson(-0.0).to_string(), "-0");
+    EXPECT_EQ(mgjson(1e21).to_string(), "1e+21");
+    EXPECT_EQ(mgjson(1e-7).to_string(), "1e-7");
+    EXPECT_EQ(mgjson(0.000001).to_string(), "0.000001");
+    EXPECT_EQ(mgjson(5e-324).to_string(), "5e-324");
+    EXPECT_EQ(mgjson(1.7976931348623157e308).to_string(), "1.7976931348623157e+308");
+    EXPECT_EQ(mgjson(1.0 / 3).to_string(), "0.3333333333333333");
+    EXPECT_EQ(mgjson(123456789012345680000.0).to_string(), "123456789012345680000");
+
+    mgjson::parse_result res;
+    mgjson json = mgjson::from_json(std::string("[0.1, 1e300, 3.141592653589793238, 2.50]"), &res);
+    ASSERT_EQ(res.error, mgjson::parse_result::NoError);
+    EXPECT_EQ(json.to_json(mgjson::Compact), "[0.1,1e+300,3.141592653589793,2.5]");
+
+    for (double value : {0.1, 1.5e-300, 123.456, 9007199254740993.0, 4.35, 1e23}) {
+        mgjson parsed = mgjson::from_json(mgjson(value).to_json(mgjson::Compact));
+        EXPECT_EQ(parsed.to_double(), value);
+    }
+}
+
+TEST(ToJson, Parallel)
+{
+    mgjson json;
+    for (int i = 0; i < 3000; ++i) {
+        json["records"].push_back(sample());
+        json["values"].push_back(i);
+        json["fields"]["field" + std::to_string(i)] = (0 == i % 3) ? sample() : mgjson(i);
+    }
+    json["fields"]["undefined"] = mgjson(mgjson::Undefined);
+
+    for (unsigned format : {0x0000U, 0x0001U, 0x00C3U, 0x01FFU}) {
+        const mgjson::json_format f = static_cast<mgjson::json_format>(format);
+        const std::string expected = json.to_json(f);
+        EXPECT_EQ(json.to_json_parallel(f, 4), expected);
+        EXPECT_EQ(json.to_json_parallel(f, 1), expected);
+        EXPECT_EQ(json["records"].to_json_parallel(f), json["records"].to_json(f));
+    }
+    EXPECT_EQ(mgjson(1).to_json_parallel(mgjson::Compact, 4), "1");
+}
+
+TEST(ToJson, Segments)
+{
+    const std::string blob(1000, 'b');
+    mgjson json = sample();
+    json["blob"] = blob;
+    json["escaped"] = std::string(300, '\n');
+    json["short"] = "short";
+    json["raw"] = mgjson::raw_json("[\"" + blob + "\"]");
+    json["list"].push_back(blob);
+
+    std::vector<mgjson::json_segment> segments;
+    std::string storage = "old content";
+    for (unsigned format : {0x0000U, 0x01FFU, 0x00C9U}) {
+        const mgjson::json_format f = static_cast<mgjson::json_format>(format);
+        json.to_json_segments(segments, storage, f);
+        std::string text;
+        size_t referenced = 0;
+        for (const mgjson::json_segment& segment : segments) {
+            text.append(segment.data, segment.size);
+            if ((segment.data < storage.data()) || (segment.data >= storage.data() + storage.size())) {
+                referenced += segment.size;
+            }
+        }
+        EXPECT_EQ(text, json.to_json(f));
+        // Strings in simple arrays are copied when output is formatted.
+        EXPECT_EQ(referenced, ((0 == format) ? 3 : 2) * blob.size() + 4) << format;
+        EXPECT_EQ(storage.size() + referenced, text.size());
+    }
+
+    mgjson::json_segment expected = {"42", 2};
+    mgjson(42).to_json_segments(segments, storage, mgjson::Compact);
+    ASSERT_EQ(segments.size(), 1U);
+    EXPECT_EQ(std::string(segments[0].data, segments[0].size), std::string(expected.data, expected.size));
+}
+
+TEST(ToJson, Canonical)
+{
+    EXPECT_EQ(sample().to_json(mgjson::Canonical), sample().to_json(mgjson::Compact));
+    EXPECT_EQ(sample().to_json(mgjson::MaxReadable | mgjson::Canonical), sample().to_json(mgjson::Compact));
+
+    mgjson json = mgjson::from_json("{ \"b\" : [1.0, 1.50, -0, 1E2, 12345678901234567890123],"
+                                    "  \"a\" : { \"y\" : 2, \"x\" : \"\\u0041\\u00e9\\n\" } }",
+                                    nullptr, mgjson::PreserveNumbers);
+    const std::string expected = "{\"a\":{\"x\":\"A\xC3\xA9\\n\",\"y\":2},"
+                                 "\"b\":[1,1.5,0,100,1.2345678901234568e+22]}";
+    EXPECT_EQ(json.to_json(mgjson::Canonical), expected);
+    EXPECT_EQ(mgjson::from_json(json.to_json(mgjson::Compact)).to_json(mgjson::Canonical), expected);
+
+    mgjson raw;
+    raw["a"] = mgjson::raw_json("{ \"y\" : 2, \"x\" : \"A\xC3\xA9\\n\" }");
+    raw["b"] = mgjson::raw_json("[1.0, 1.5, 0, 100, 1.2345678901234568E22]");
+    EXPECT_EQ(raw.to_json(mgjson::Canonical), expected);
+
+    EXPECT_EQ(mgjson(18446744073709551615ULL).to_json(mgjson::Canonical), "18446744073709551615");
+    EXPECT_EQ(mgjson(-9223372036854775807LL - 1).to_json(mgjson::Canonical), "-9223372036854775808");
+    EXPECT_EQ(mgjson(1e21).to_json(mgjson::Canonical), "1e+21");
+    EXPECT_EQ(mgjson(-1e-7).to_json(mgjson::Canonical), "-1e-7");
+    EXPECT_EQ(mgjson(std::numeric_limits<double>::quiet_NaN()).to_json(mgjson::Canonical), "null");
+}
+
+TEST(Hash, Structure)
+{
+    mgjson json = mgjson::from_json("{\"b\": [1.0, \"x\", null], \"a\": {\"c\": true}}");
+    const unsigned long long hash = json.hash();
+    EXPECT_EQ(json.hash(), hash);
+    EXPECT_EQ(mgjson::from_json(json.to_json(mgjson::MaxReadable)).hash(), hash);
+    EXPECT_EQ(mgjson::from_json("{\"a\":{\"c\":true},\"b\":[1,\"x\",null]}", nullptr,
+                                mgjson::PreserveNumbers).hash(), hash);
+    EXPECT_EQ(mgjson::raw_json("{\"b\": [1e0, \"x\", null], \"a\": {\"c\": true}}").hash(), hash);
+
+    EXPECT_NE(mgjson::from_json("{\"b\": [1, \"x\"], \"a\": {\"c\": true}}").hash(), hash);
+    EXPECT_NE(mgjson::from_json("{\"b\": [1, \"x\", null], \"a\": {\"c\": false}}").hash(), hash);
+    EXPECT_NE(mgjson::from_json("{\"b\": [1, \"x\", null], \"a\": {\"d\": true}}").hash(), hash);
+    EXPECT_NE(mgjson::from_json("{\"b\": [\"x\", 1, null], \"a\": {\"c\": true}}").hash(), hash);
+    EXPECT_NE(mgjson(1).hash(), mgjson("1").hash());
+    EXPECT_NE(mgjson(mgjson::Array).hash(), mgjson(mgjson::Object).hash());
+    EXPECT_NE(mgjson(std::string(9, 'a')).hash(), mgjson(std::string(9, 'a') + '\0').hash());
+    EXPECT_EQ(mgjson(mgjson::Undefined).hash(), mgjson().hash());
+
+    // Cached hash is dropped on change, also of children changed by reference.
+    mgjson copy = json;
+    copy["a"]["c"] = false;
+    EXPECT_NE(copy.hash(), hash);
+    EXPECT_EQ(json.hash(), hash);
+
+    mgjson& list = copy["b"];
+    EXPECT_NE(copy.hash(), hash);
+    list.push_back(5);
+    const unsigned long long changed = copy.hash();
+    list.remove(3);
+    copy["a"]["c"] = true;
+    EXPECT_NE(copy.hash(), changed);
+    EXPECT_EQ(copy.hash(), hash);
+}
+
+TEST(Hash, Cache)
+{
+    // Tree built through references of at() and push_back().
+    mgjson json;
+    mgjson* last = nullptr;
+    for (int i = 0; i < 10; ++i) {
+        last = &json["list"].push_back(mgjson(mgjson::Object));
+        (*last)["id"] = i;
+        (*last)["tags"].push_back("x");
+    }
+    const unsigned long long hash = json.hash();
+    EXPECT_EQ(mgjson::from_json(json.to_json()).hash(), hash);
+
+    // Hashed again from cache: changed cached value is returned as is.
+    const mgjson_private* data = mgjson_private::get(static_cast<const mgjson&>(json));
+    data->hash_.store(hash + 1);
+    EXPECT_EQ(json.hash(), hash + 1);
+    data->hash_.store(hash);
+
+    // Change through reference given before hashing is seen.
+    (*last)["id"] = 100;
+    const unsigned long long changed = json.hash();
+    EXPECT_NE(changed, hash);
+    EXPECT_EQ(mgjson::from_json(json.to_json()).hash(), changed);
+    (*last)["id"] = 9;
+    EXPECT_EQ(json.hash(), hash);
+
+    // Value replaced through reference given before hashing.
+    mgjson p;
+    mgjson& r = p["a"];
+    r = mgjson(1);
+    const unsigned long long h1 = p.hash();
+    r = mgjson(2);
+    EXPECT_NE(p.hash(), h1);
+    EXPECT_EQ(p.hash(), mgjson::from_json("{\"a\":2}").hash());
+}